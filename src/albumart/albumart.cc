@@ -24,6 +24,8 @@
 #include <libaudgui/libaudgui.h>
 #include <libaudgui/libaudgui-gtk.h>
 
+#include "../ui-common/art-gtk.h"
+
 class AlbumArtPlugin : public GeneralPlugin
 {
 public:
@@ -42,26 +44,61 @@ public:
 
 EXPORT AlbumArtPlugin aud_plugin_instance;
 
-static void album_update (void *, GtkWidget * widget)
+/* art is decoded in steps of this size, so that it is not decoded again
+ * on every small change to the size of the widget */
+#define ART_STEP 256
+
+static int loaded_size;
+
+static int art_size (GtkWidget * widget)
 {
-    AudguiPixbuf pixbuf = audgui_pixbuf_request_current ();
+    GtkAllocation alloc;
+    gtk_widget_get_allocation (widget, & alloc);
 
-    if (! pixbuf)
-        pixbuf = audgui_pixbuf_fallback ();
+    int size = aud::max (alloc.width, alloc.height);
+    return aud::max (1, (size + ART_STEP - 1) / ART_STEP) * ART_STEP;
+}
+
+static void album_art_ready (ArtImage * image, void * widget)
+{
+    if (image)
+        audgui_scaled_image_set ((GtkWidget *) widget, image->pixbuf.get ());
+    else
+    {
+        AudguiPixbuf pixbuf = audgui_pixbuf_fallback ();
+        audgui_scaled_image_set ((GtkWidget *) widget, pixbuf.get ());
+    }
+}
 
-    audgui_scaled_image_set (widget, pixbuf.get ());
+static void album_update (void *, GtkWidget * widget)
+{
+    loaded_size = art_size (widget);
+    art_request_current (loaded_size, album_art_ready, widget);
+    art_prefetch_next (loaded_size);
 }
 
 static void album_clear (void *, GtkWidget * widget)
 {
+    art_cancel (widget);
+    loaded_size = 0;
+
     audgui_scaled_image_set (widget, nullptr);
 }
 
+static void album_resize (GtkWidget * widget)
+{
+    if (loaded_size && art_size (widget) > loaded_size)
+        album_update (nullptr, widget);
+}
+
 static void album_cleanup (GtkWidget * widget)
 {
     hook_dissociate ("playback ready", (HookFunction) album_update, widget);
     hook_dissociate ("playback stop", (HookFunction) album_clear, widget);
 
+    art_cleanup ();
+    loaded_size = 0;
+
     audgui_cleanup ();
 }
 
@@ -72,6 +109,7 @@ void * AlbumArtPlugin::get_gtk_widget ()
     GtkWidget * widget = audgui_scaled_image_new (nullptr);
 
     g_signal_connect (widget, "destroy", (GCallback) album_cleanup, nullptr);
+    g_signal_connect (widget, "size-allocate", (GCallback) album_resize, nullptr);
 
     hook_associate ("playback ready", (HookFunction) album_update, widget);
     hook_associate ("playback stop", (HookFunction) album_clear, widget);
@@ -0,0 +1,2 @@
+#include "../ui-common/art.cc"
+#include "../ui-common/art-gtk.cc"
@@ -25,7 +25,11 @@
 #include <libaudcore/inifile.h>
 #include <libaudcore/plugin.h>
 
-static const char * const audpl_exts[] = {"audpl"};
+#include "binary.h"
+
+/* audpl is the interchange format; audplb is a compact binary form of the
+ * same data, which loads much faster for large playlists */
+static const char * const audpl_exts[] = {"audpl", "audplb"};
 
 class AudPlaylistLoader : public PlaylistPlugin
 {
@@ -126,6 +130,16 @@ private:
 bool AudPlaylistLoader::load (const char * path, VFSFile & file, String & title,
  Index<PlaylistAddItem> & items)
 {
+    /* the format is told by its content, not by the file name */
+    char magic[AUDPLB_MAGIC_LEN];
+
+    if (file.fread (magic, 1, sizeof magic) == sizeof magic &&
+     ! memcmp (magic, AUDPLB_MAGIC, sizeof magic))
+        return binary_load (file, title, items);
+
+    if (file.fseek (0, VFS_SEEK_SET) < 0)
+        return false;
+
     AudPlaylistParser (title, items).parse (file);
     return true;
 }
@@ -133,6 +147,9 @@ bool AudPlaylistLoader::load (const char * path, VFSFile & file, String & title,
 bool AudPlaylistLoader::save (const char * path, VFSFile & file,
  const char * title, const Index<PlaylistAddItem> & items)
 {
+    if (str_has_suffix_nocase (path, ".audplb"))
+        return binary_save (file, title, items);
+
     if (! inifile_write_entry (file, "title", str_encode_percent (title)))
         return false;
 
@@ -0,0 +1,363 @@
+/*
+ * Binary Audacious Playlists (audplb)
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include <libaudcore/audstrings.h>
+#include <libaudcore/multihash.h>
+#include <libaudcore/runtime.h>
+
+#include "binary.h"
+
+/*
+ * Layout (all integers are 32-bit little endian unless noted):
+ *
+ *   magic        "AUDPLBIN"
+ *   header       version, n_fields, n_strings, n_items, title, strings_pos
+ *   fields       n_fields x {name, type}
+ *   offsets      (n_strings + 1) x offset into the string data
+ *   items        n_items x {uri, state (16 bits), n_values (16 bits),
+ *                           n_values x {field, value}}
+ *   string data  at strings_pos, without terminators
+ *
+ * Names, URIs, the title and string values are indexes into the string
+ * table, in which every distinct string is stored once.  Fields are
+ * recorded by name, so that a file stays readable if the numbering of
+ * tuple fields changes.  Integer values are stored directly.
+ */
+
+#define AUDPLB_VERSION 1
+#define AUDPLB_NONE 0xffffffff
+
+enum {
+    STATE_INITIAL,
+    STATE_VALID,
+    STATE_FAILED
+};
+
+static void put16 (Index<char> & buf, unsigned val)
+{
+    buf.append ((char) (val & 0xff));
+    buf.append ((char) ((val >> 8) & 0xff));
+}
+
+static void put32 (Index<char> & buf, uint32_t val)
+{
+    put16 (buf, val & 0xffff);
+    put16 (buf, val >> 16);
+}
+
+static void set32 (Index<char> & buf, int pos, uint32_t val)
+{
+    for (int i = 0; i < 4; i ++)
+        buf[pos + i] = (val >> (8 * i)) & 0xff;
+}
+
+static unsigned get16 (const unsigned char * p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t get32 (const unsigned char * p)
+{
+    return get16 (p) | ((uint32_t) get16 (p + 2) << 16);
+}
+
+class StringTable
+{
+public:
+    uint32_t add (const String & str)
+    {
+        uint32_t * id = m_ids.lookup (str);
+        if (id)
+            return * id;
+
+        uint32_t new_id = m_strings.len ();
+        m_ids.add (str, uint32_t (new_id));
+        m_strings.append (str);
+        return new_id;
+    }
+
+    const Index<String> & strings () const
+        { return m_strings; }
+
+private:
+    SimpleHash<String, uint32_t> m_ids;
+    Index<String> m_strings;
+};
+
+static bool skip_field (Tuple::Field f)
+{
+    return f == Tuple::Path || f == Tuple::Basename ||
+     f == Tuple::Suffix || f == Tuple::FormattedTitle;
+}
+
+bool binary_save (VFSFile & file, const char * title, const Index<PlaylistAddItem> & items)
+{
+    StringTable table;
+    Index<char> buf;
+
+    buf.insert (AUDPLB_MAGIC, 0, AUDPLB_MAGIC_LEN);
+
+    int header = buf.len ();
+    buf.insert (-1, 6 * 4);
+
+    /* the fields are listed in Tuple order, whether used or not */
+    Index<Tuple::Field> fields;
+
+    for (auto f : Tuple::all_fields ())
+    {
+        if (skip_field (f))
+            continue;
+
+        fields.append (f);
+        put32 (buf, table.add (String (Tuple::field_get_name (f))));
+        put32 (buf, Tuple::field_get_type (f));
+    }
+
+    uint32_t title_id = title ? table.add (String (title)) : AUDPLB_NONE;
+
+    /* string ids must be known before the offsets are written, so the
+     * items go into a separate buffer first */
+    Index<char> item_buf;
+
+    for (auto & item : items)
+    {
+        const Tuple & tuple = item.tuple;
+
+        put32 (item_buf, table.add (item.filename));
+
+        int state = STATE_INITIAL;
+        if (tuple.state () == Tuple::Valid)
+            state = STATE_VALID;
+        else if (tuple.state () == Tuple::Failed)
+            state = STATE_FAILED;
+
+        put16 (item_buf, state);
+
+        int count_pos = item_buf.len ();
+        int count = 0;
+        put16 (item_buf, 0);
+
+        if (state == STATE_VALID)
+        {
+            for (int i = 0; i < fields.len (); i ++)
+            {
+                switch (tuple.get_value_type (fields[i]))
+                {
+                case Tuple::String:
+                    put32 (item_buf, i);
+                    put32 (item_buf, table.add (tuple.get_str (fields[i])));
+                    count ++;
+                    break;
+
+                case Tuple::Int:
+                    put32 (item_buf, i);
+                    put32 (item_buf, tuple.get_int (fields[i]));
+                    count ++;
+                    break;
+
+                default:
+                    break;
+                }
+            }
+        }
+
+        item_buf[count_pos] = count & 0xff;
+        item_buf[count_pos + 1] = count >> 8;
+    }
+
+    const Index<String> & strings = table.strings ();
+    uint32_t offset = 0;
+
+    for (const String & str : strings)
+    {
+        put32 (buf, offset);
+        offset += strlen (str);
+    }
+
+    put32 (buf, offset);
+
+    buf.insert (item_buf.begin (), -1, item_buf.len ());
+
+    set32 (buf, header, AUDPLB_VERSION);
+    set32 (buf, header + 4, fields.len ());
+    set32 (buf, header + 8, strings.len ());
+    set32 (buf, header + 12, items.len ());
+    set32 (buf, header + 16, title_id);
+    set32 (buf, header + 20, buf.len ());
+
+    for (const String & str : strings)
+        buf.insert (str, -1, strlen (str));
+
+    return file.fwrite (buf.begin (), 1, buf.len ()) == buf.len ();
+}
+
+/* Strings are only created from the string data when first used; an
+ * interned value such as an album name is then shared by all items. */
+class StringReader
+{
+public:
+    StringReader (const unsigned char * offsets, const char * data, uint32_t count, uint32_t size) :
+        m_offsets (offsets),
+        m_data (data),
+        m_size (size)
+    {
+        m_strings.insert (0, count);
+    }
+
+    bool get (uint32_t id, String & str)
+    {
+        if (id >= (uint32_t) m_strings.len ())
+            return false;
+
+        if (! m_strings[id])
+        {
+            uint32_t start = get32 (m_offsets + 4 * id);
+            uint32_t end = get32 (m_offsets + 4 * (id + 1));
+
+            if (start > end || end > m_size)
+                return false;
+
+            m_strings[id] = String (str_copy (m_data + start, end - start));
+        }
+
+        str = m_strings[id];
+        return true;
+    }
+
+private:
+    const unsigned char * m_offsets;
+    const char * m_data;
+    uint32_t m_size;
+    Index<String> m_strings;
+};
+
+bool binary_load (VFSFile & file, String & title, Index<PlaylistAddItem> & items)
+{
+    Index<char> buf = file.read_all ();
+    const unsigned char * data = (const unsigned char *) buf.begin ();
+    int64_t len = buf.len ();
+
+    /* positions below are relative to the end of the magic */
+    auto fits = [len] (int64_t pos, int64_t size)
+        { return pos >= 0 && size >= 0 && pos + size <= len; };
+
+    if (! fits (0, 6 * 4))
+        return false;
+
+    uint32_t version = get32 (data);
+    uint32_t n_fields = get32 (data + 4);
+    uint32_t n_strings = get32 (data + 8);
+    uint32_t n_items = get32 (data + 12);
+    uint32_t title_id = get32 (data + 16);
+    int64_t strings_pos = (int64_t) get32 (data + 20) - AUDPLB_MAGIC_LEN;
+
+    if (version != AUDPLB_VERSION)
+    {
+        AUDERR ("Unsupported binary playlist version %u\n", (unsigned) version);
+        return false;
+    }
+
+    int64_t fields_pos = 6 * 4;
+    int64_t offsets_pos = fields_pos + 8 * (int64_t) n_fields;
+    int64_t items_pos = offsets_pos + 4 * ((int64_t) n_strings + 1);
+
+    if (! fits (fields_pos, 8 * (int64_t) n_fields) ||
+     ! fits (offsets_pos, 4 * ((int64_t) n_strings + 1)) ||
+     strings_pos < items_pos || ! fits (strings_pos, 0))
+        return false;
+
+    StringReader strings (data + offsets_pos, (const char *) data + strings_pos,
+     n_strings, len - strings_pos);
+
+    /* map the recorded fields to the current ones */
+    Index<Tuple::Field> fields;
+
+    for (uint32_t i = 0; i < n_fields; i ++)
+    {
+        String name;
+        if (! strings.get (get32 (data + fields_pos + 8 * i), name))
+            return false;
+
+        Tuple::Field field = Tuple::field_by_name (name);
+        Tuple::ValueType type = (Tuple::ValueType) get32 (data + fields_pos + 8 * i + 4);
+
+        if (field != Tuple::Invalid && Tuple::field_get_type (field) != type)
+            field = Tuple::Invalid;
+
+        fields.append (field);
+    }
+
+    if (title_id != AUDPLB_NONE && ! strings.get (title_id, title))
+        return false;
+
+    int64_t pos = items_pos;
+
+    for (uint32_t i = 0; i < n_items; i ++)
+    {
+        if (! fits (pos, 8) || pos + 8 > strings_pos)
+            return false;
+
+        String uri;
+        if (! strings.get (get32 (data + pos), uri))
+            return false;
+
+        unsigned state = get16 (data + pos + 4);
+        unsigned n_values = get16 (data + pos + 6);
+        pos += 8;
+
+        if (pos + 8 * (int64_t) n_values > strings_pos)
+            return false;
+
+        Tuple tuple;
+
+        for (unsigned v = 0; v < n_values; v ++, pos += 8)
+        {
+            uint32_t f = get32 (data + pos);
+            uint32_t value = get32 (data + pos + 4);
+
+            if (f >= n_fields || fields[f] == Tuple::Invalid)
+                continue;
+
+            if (Tuple::field_get_type (fields[f]) == Tuple::String)
+            {
+                String str;
+                if (! strings.get (value, str))
+                    return false;
+
+                tuple.set_str (fields[f], str);
+            }
+            else
+                tuple.set_int (fields[f], (int32_t) value);
+        }
+
+        if (state == STATE_VALID)
+        {
+            tuple.set_state (Tuple::Valid);
+            tuple.set_filename (uri);
+        }
+        else if (state == STATE_FAILED)
+            tuple.set_state (Tuple::Failed);
+
+        items.append (std::move (uri), std::move (tuple));
+    }
+
+    return true;
+}
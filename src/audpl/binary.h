@@ -0,0 +1,31 @@
+/*
+ * Binary Audacious Playlists (audplb)
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#ifndef AUDPL_BINARY_H
+#define AUDPL_BINARY_H
+
+#include <libaudcore/plugin.h>
+
+#define AUDPLB_MAGIC "AUDPLBIN"
+#define AUDPLB_MAGIC_LEN 8
+
+/* The file position must be just past the magic. */
+bool binary_load (VFSFile & file, String & title, Index<PlaylistAddItem> & items);
+bool binary_save (VFSFile & file, const char * title, const Index<PlaylistAddItem> & items);
+
+#endif
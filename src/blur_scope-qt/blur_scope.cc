@@ -25,12 +25,20 @@
  */
 
 #include <math.h>
+#include <pthread.h>
 #include <string.h>
 #include <glib-2.0/glib.h>
 
+#if defined (__SSE2__)
+#include <emmintrin.h>
+#elif defined (__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 #include <QWidget>
 #include <QImage>
 #include <QPainter>
+#include <QThread>
 
 #include "libaudqt/colorbutton.h"
 
@@ -54,6 +62,105 @@ static const char * const bscope_defaults[] = {
 
 static int bscope_color;
 
+/* The blur reads only the previous frame and writes a second buffer, so
+ * that rows (and groups of pixels within a row) can be computed in any
+ * order: in parallel bands on large images, four pixels at a time where
+ * SSE2 or NEON is available. */
+#define BAND_PIXELS (256 * 1024) /* smallest band worth a thread */
+#define MAX_BANDS 8
+
+struct BlurBand
+{
+    const uint32_t * src;
+    uint32_t * dest;
+    int width, stride, top, bottom;
+};
+
+static int s_bands = 1;
+
+/* We do a quick and dirty average of four color values, first masking off the
+ * lowest two bits.  Over a large area, this masking has the net effect of
+ * subtracting 1.5 from each value, which by a happy chance is just right for a
+ * gradual fade effect. */
+static inline uint32_t blur_pixel (const uint32_t * p, int stride)
+{
+    return ((p[-stride] & 0xFCFCFC) + (p[-1] & 0xFCFCFC) + (p[1] & 0xFCFCFC) +
+     (p[stride] & 0xFCFCFC)) >> 2;
+}
+
+static void blur_row (const uint32_t * p, uint32_t * out, int width, int stride)
+{
+    int x = 0;
+
+#if defined (__SSE2__)
+    const __m128i mask = _mm_set1_epi32 (0xFCFCFC);
+
+    for (; x + 4 <= width; x += 4)
+    {
+        __m128i a = _mm_loadu_si128 ((const __m128i *) (p + x - stride));
+        __m128i l = _mm_loadu_si128 ((const __m128i *) (p + x - 1));
+        __m128i r = _mm_loadu_si128 ((const __m128i *) (p + x + 1));
+        __m128i b = _mm_loadu_si128 ((const __m128i *) (p + x + stride));
+
+        __m128i sum = _mm_add_epi32 (_mm_add_epi32 (_mm_and_si128 (a, mask),
+         _mm_and_si128 (l, mask)), _mm_add_epi32 (_mm_and_si128 (r, mask),
+         _mm_and_si128 (b, mask)));
+
+        _mm_storeu_si128 ((__m128i *) (out + x), _mm_srli_epi32 (sum, 2));
+    }
+#elif defined (__ARM_NEON)
+    const uint32x4_t mask = vdupq_n_u32 (0xFCFCFC);
+
+    for (; x + 4 <= width; x += 4)
+    {
+        uint32x4_t a = vandq_u32 (vld1q_u32 (p + x - stride), mask);
+        uint32x4_t l = vandq_u32 (vld1q_u32 (p + x - 1), mask);
+        uint32x4_t r = vandq_u32 (vld1q_u32 (p + x + 1), mask);
+        uint32x4_t b = vandq_u32 (vld1q_u32 (p + x + stride), mask);
+
+        uint32x4_t sum = vaddq_u32 (vaddq_u32 (a, l), vaddq_u32 (r, b));
+        vst1q_u32 (out + x, vshrq_n_u32 (sum, 2));
+    }
+#endif
+
+    for (; x < width; x ++)
+        out[x] = blur_pixel (p + x, stride);
+}
+
+static void * blur_band (void * data)
+{
+    auto band = (const BlurBand *) data;
+
+    for (int y = band->top; y < band->bottom; y ++)
+        blur_row (band->src + band->stride * y, band->dest + band->stride * y,
+         band->width, band->stride);
+
+    return nullptr;
+}
+
+/* src and dest point to the top left pixel, inside the border */
+static void blur_image (const uint32_t * src, uint32_t * dest, int width,
+ int height, int stride)
+{
+    int n_bands = aud::clamp (width * height / BAND_PIXELS, 1, s_bands);
+
+    BlurBand bands[MAX_BANDS];
+    pthread_t threads[MAX_BANDS];
+
+    for (int i = 0; i < n_bands; i ++)
+        bands[i] = {src, dest, width, stride, height * i / n_bands,
+         height * (i + 1) / n_bands};
+
+    /* the calling thread takes the first band */
+    for (int i = 1; i < n_bands; i ++)
+        pthread_create (& threads[i], nullptr, blur_band, & bands[i]);
+
+    blur_band (& bands[0]);
+
+    for (int i = 1; i < n_bands; i ++)
+        pthread_join (threads[i], nullptr);
+}
+
 class BlurScopeWidget : public QWidget {
 public:
     BlurScopeWidget (QWidget * parent = nullptr);
@@ -72,6 +179,7 @@ protected:
 private:
     int m_width = 0, m_height = 0, m_image_size = 0;
     uint32_t * m_image = nullptr, * m_corner = nullptr;
+    uint32_t * m_blurred = nullptr; /* written by blur (), then swapped */
 };
 
 static BlurScopeWidget *s_widget = nullptr;
@@ -85,7 +193,9 @@ BlurScopeWidget::BlurScopeWidget (QWidget * parent) :
 BlurScopeWidget::~BlurScopeWidget ()
 {
     g_free(m_image);
+    g_free(m_blurred);
     m_image = nullptr;
+    m_blurred = nullptr;
     s_widget = nullptr;
 }
 
@@ -106,9 +216,12 @@ void BlurScopeWidget::resize (int w, int h)
 {
     m_width = w;
     m_height = h;
-    m_image_size = (m_width << 2) * (m_height + 2);
+    /* the neighbour below the last pixel is one past the bottom border */
+    m_image_size = (m_width * (m_height + 2) + 1) << 2;
     m_image = (uint32_t *) g_realloc (m_image, m_image_size);
+    m_blurred = (uint32_t *) g_realloc (m_blurred, m_image_size);
     memset (m_image, 0, m_image_size);
+    memset (m_blurred, 0, m_image_size);
     m_corner = m_image + m_width + 1;
 }
 
@@ -120,21 +233,10 @@ void BlurScopeWidget::clear ()
 
 void BlurScopeWidget::blur ()
 {
-    for (int y = 0; y < m_height; y ++)
-    {
-        uint32_t * p = m_corner + m_width * y;
-        uint32_t * end = p + m_width;
-        uint32_t * plast = p - m_width;
-        uint32_t * pnext = p + m_width;
-
-        /* We do a quick and dirty average of four color values, first masking
-         * off the lowest two bits.  Over a large area, this masking has the net
-         * effect of subtracting 1.5 from each value, which by a happy chance
-         * is just right for a gradual fade effect. */
-        for (; p < end; p ++)
-            * p = ((* plast ++ & 0xFCFCFC) + (p[-1] & 0xFCFCFC) + (p[1] &
-             0xFCFCFC) + (* pnext ++ & 0xFCFCFC)) >> 2;
-    }
+    blur_image (m_corner, m_blurred + m_width + 1, m_width, m_height, m_width);
+
+    std::swap (m_image, m_blurred);
+    m_corner = m_image + m_width + 1;
 }
 
 void BlurScopeWidget::draw_vert_line (int x, int y1, int y2)
@@ -180,6 +282,8 @@ bool BlurScopeQt::init ()
     aud_config_set_defaults ("BlurScope", bscope_defaults);
     bscope_color = aud_get_int ("BlurScope", "color");
 
+    s_bands = aud::clamp (QThread::idealThreadCount (), 1, MAX_BANDS);
+
     return true;
 }
 
@@ -198,6 +302,10 @@ void BlurScopeQt::render_mono_pcm (const float * pcm)
 {
     g_assert(s_widget);
 
+    /* nobody would see the result */
+    if (! s_widget->isVisible () || s_widget->visibleRegion ().isEmpty ())
+        return;
+
     s_widget->blur ();
 
     int width = s_widget->width ();
@@ -17,18 +17,13 @@
  * the use of this software.
  */
 
+#include <stdio.h>
 #include <string.h>
 #include <pthread.h>
-
-#ifdef HAVE_LIBCUE2
-#include <libcue.h>
-#else
-extern "C" {
-#include <libcue/libcue.h>
-}
-#endif
+#include <sys/stat.h>
 
 #include <libaudcore/audstrings.h>
+#include <libaudcore/hash.h>
 #include <libaudcore/i18n.h>
 #include <libaudcore/plugin.h>
 #include <libaudcore/probe.h>
@@ -42,12 +37,53 @@ public:
     static constexpr PluginInfo info = {N_("Cue Sheet Plugin"), PACKAGE};
     constexpr CueLoader () : PlaylistPlugin (info, cue_exts, false) {}
 
+    void cleanup ();
+
     bool load (const char * filename, VFSFile & file, String & title,
      Index<PlaylistAddItem> & items);
 };
 
 EXPORT CueLoader aud_plugin_instance;
 
+struct CueTrack
+{
+    String filename;
+    int start = -1, pregap = -1;  /* INDEX 01 and 00, in frames */
+    String performer, title, genre;
+    String gain, peak;
+};
+
+struct CueSheet
+{
+    String performer, title, genre, composer, date;
+    String gain, peak;
+    Index<CueTrack> tracks;
+};
+
+struct ProbeResult
+{
+    int64_t mtime, size;
+    PluginHandle * decoder;
+    Tuple tuple;
+    unsigned last_used;
+};
+
+/* many cue sheets may reference the same audio file, so recent probing
+ * results are kept for local files, checked against the modification time
+ * and size; the lock is never held while probing */
+static pthread_mutex_t probe_mutex = PTHREAD_MUTEX_INITIALIZER;
+static SimpleHash<String, ProbeResult> probe_cache;
+static unsigned probe_clock;
+
+static constexpr int probe_cache_max = 256;
+
+void CueLoader::cleanup ()
+{
+    pthread_mutex_lock (& probe_mutex);
+    probe_cache.clear ();
+    pthread_mutex_unlock (& probe_mutex);
+}
+
 static bool is_year (const char * s)
 {
     auto is_digit = [] (char c)
@@ -57,28 +93,250 @@ static bool is_year (const char * s)
            is_digit (s[2]) && is_digit (s[3]) && ! s[4];
 }
 
+static char * split_line (char * line)
+{
+    char * feed = strchr (line, '\n');
+    if (! feed)
+        return nullptr;
+
+    if (feed > line && feed[-1] == '\r')
+        feed[-1] = 0;
+    else
+        feed[0] = 0;
+
+    return feed + 1;
+}
+
+/* returns the next word of the line, with quotes removed */
+static char * parse_word (char * & parse)
+{
+    while (* parse == ' ' || * parse == '\t')
+        parse ++;
+
+    if (! * parse)
+        return nullptr;
+
+    char * word;
+
+    if (* parse == '"')
+    {
+        word = ++ parse;
+        char * quote = strchr (parse, '"');
+
+        if (quote)
+        {
+            * quote = 0;
+            parse = quote + 1;
+        }
+        else
+            parse += strlen (parse);
+    }
+    else
+    {
+        word = parse;
+        while (* parse && * parse != ' ' && * parse != '\t')
+            parse ++;
+
+        if (* parse)
+            * parse ++ = 0;
+    }
+
+    return word;
+}
+
+/* returns the rest of the line, trimmed and with quotes removed */
+static char * parse_rest (char * parse)
+{
+    while (* parse == ' ' || * parse == '\t')
+        parse ++;
+
+    int len = strlen (parse);
+    while (len && (parse[len - 1] == ' ' || parse[len - 1] == '\t'))
+        parse[-- len] = 0;
+
+    if (len >= 2 && parse[0] == '"' && parse[len - 1] == '"')
+    {
+        parse[len - 1] = 0;
+        parse ++;
+    }
+
+    return * parse ? parse : nullptr;
+}
+
+static int track_start (const CueTrack * track)
+{
+    if (track->start >= 0)
+        return track->start;
+
+    return aud::max (track->pregap, 0);
+}
+
+static void set_field (String & field, const char * value)
+{
+    if (value)
+        field = String (value);
+}
+
+/* a small line-based parser; unlike libcue's it keeps no global state */
+static void parse_cue (char * text, CueSheet & sheet)
+{
+    String cur_file;
+    CueTrack * track = nullptr;
+
+    if (! strncmp (text, "\xef\xbb\xbf", 3)) /* byte order mark */
+        text += 3;
+
+    for (char * parse = text; parse; )
+    {
+        char * next = split_line (parse);
+        const char * key = parse_word (parse);
+
+        if (! key)
+            ;
+        else if (! strcmp_nocase (key, "FILE"))
+            set_field (cur_file, parse_word (parse));
+        else if (! strcmp_nocase (key, "TRACK"))
+        {
+            track = & sheet.tracks.append ();
+            track->filename = cur_file;
+        }
+        else if (! strcmp_nocase (key, "INDEX"))
+        {
+            const char * number = parse_word (parse);
+            const char * time = parse_word (parse);
+            int min, sec, frame;
+
+            if (track && number && time &&
+             sscanf (time, "%d:%d:%d", & min, & sec, & frame) == 3)
+            {
+                int pos = (min * 60 + sec) * 75 + frame;
+                int n = str_to_int (number);
+
+                if (n == 1)
+                    track->start = pos;
+                else if (n == 0)
+                    track->pregap = pos;
+            }
+        }
+        else if (! strcmp_nocase (key, "PERFORMER"))
+            set_field (track ? track->performer : sheet.performer, parse_word (parse));
+        else if (! strcmp_nocase (key, "TITLE"))
+            set_field (track ? track->title : sheet.title, parse_word (parse));
+        else if (! strcmp_nocase (key, "GENRE"))
+            set_field (track ? track->genre : sheet.genre, parse_word (parse));
+        else if (! strcmp_nocase (key, "COMPOSER"))
+        {
+            if (! track)
+                set_field (sheet.composer, parse_word (parse));
+        }
+        else if (! strcmp_nocase (key, "REM"))
+        {
+            const char * rem = parse_word (parse);
+
+            if (! rem)
+                ;
+            else if (! strcmp_nocase (rem, "DATE"))
+                set_field (sheet.date, parse_rest (parse));
+            else if (! strcmp_nocase (rem, "REPLAYGAIN_ALBUM_GAIN"))
+                set_field (sheet.gain, parse_rest (parse));
+            else if (! strcmp_nocase (rem, "REPLAYGAIN_ALBUM_PEAK"))
+                set_field (sheet.peak, parse_rest (parse));
+            else if (track && ! strcmp_nocase (rem, "REPLAYGAIN_TRACK_GAIN"))
+                set_field (track->gain, parse_rest (parse));
+            else if (track && ! strcmp_nocase (rem, "REPLAYGAIN_TRACK_PEAK"))
+                set_field (track->peak, parse_rest (parse));
+        }
+
+        parse = next;
+    }
+}
+
+static void probe_cache_evict ()
+{
+    const String * oldest = nullptr;
+    unsigned oldest_used = 0;
+
+    probe_cache.iterate ([&] (const String & name, ProbeResult & result)
+    {
+        if (! oldest || (int) (result.last_used - oldest_used) < 0)
+        {
+            oldest = & name;
+            oldest_used = result.last_used;
+        }
+    });
+
+    if (oldest)
+        probe_cache.remove (String (* oldest));
+}
+
+static PluginHandle * probe_file (const char * filename, Tuple & tuple)
+{
+    StringBuf path = uri_to_filename (filename);
+    struct stat info;
+    bool cacheable = path && stat (path, & info) == 0;
+
+    if (cacheable)
+    {
+        pthread_mutex_lock (& probe_mutex);
+
+        ProbeResult * cached = probe_cache.lookup (String (filename));
+        PluginHandle * decoder = nullptr;
+
+        if (cached && cached->mtime == (int64_t) info.st_mtime &&
+         cached->size == (int64_t) info.st_size)
+        {
+            decoder = cached->decoder;
+            tuple = cached->tuple.ref ();
+            cached->last_used = ++ probe_clock;
+        }
+
+        pthread_mutex_unlock (& probe_mutex);
+
+        if (decoder)
+            return decoder;
+    }
+
+    VFSFile file (filename, "r");
+
+    PluginHandle * decoder = aud_file_find_decoder (filename, false, file);
+    if (! decoder || ! aud_file_read_tag (filename, decoder, file, tuple))
+        return nullptr;
+
+    if (cacheable)
+    {
+        pthread_mutex_lock (& probe_mutex);
+
+        if (! probe_cache.lookup (String (filename)) &&
+         probe_cache.n_items () >= probe_cache_max)
+            probe_cache_evict ();
+
+        probe_cache.add (String (filename), {(int64_t) info.st_mtime,
+         (int64_t) info.st_size, decoder, tuple.ref (), ++ probe_clock});
+
+        pthread_mutex_unlock (& probe_mutex);
+    }
+
+    return decoder;
+}
+
 bool CueLoader::load (const char * cue_filename, VFSFile & file, String & title,
  Index<PlaylistAddItem> & items)
 {
-    // XXX: cue_parse_string crashes if called concurrently
-    static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
-
     Index<char> buffer = file.read_all ();
     if (! buffer.len ())
         return false;
 
     buffer.append (0);  /* null-terminate */
 
-    pthread_mutex_lock (& mutex);
-    Cd * cd = cue_parse_string (buffer.begin ());
-    pthread_mutex_unlock (& mutex);
+    CueSheet cd;
+    parse_cue (buffer.begin (), cd);
 
-    int tracks = cd ? cd_get_ntrack (cd) : 0;
+    int tracks = cd.tracks.len ();
     if (tracks < 1)
         return false;
 
-    Track * cur = cd_get_track (cd, 1);
-    const char * cur_name = cur ? track_get_filename (cur) : nullptr;
+    const CueTrack * cur = & cd.tracks[0];
+    const char * cur_name = cur->filename;
 
     if (! cur_name)
         return false;
@@ -96,55 +354,40 @@ bool CueLoader::load (const char * cue_filename, VFSFile & file, String & title,
             decoder = nullptr;
             base_tuple = Tuple ();
 
-            VFSFile file;
-
             if (filename)
-                decoder = aud_file_find_decoder (filename, false, file);
+                decoder = probe_file (filename, base_tuple);
             else
                 AUDWARN ("Unable to construct URI for track '%s' in cuesheet '%s'\n",
                  cur_name, cue_filename);
 
-            if (decoder && aud_file_read_tag (filename, decoder, file, base_tuple))
+            if (decoder && base_tuple.valid ())
             {
-                Cdtext * cdtext = cd_get_cdtext (cd);
-
-                if (cdtext)
+                if (cd.performer)
+                    base_tuple.set_str (Tuple::AlbumArtist, cd.performer);
+                if (cd.title)
+                    base_tuple.set_str (Tuple::Album, cd.title);
+                if (cd.genre)
+                    base_tuple.set_str (Tuple::Genre, cd.genre);
+                if (cd.composer)
+                    base_tuple.set_str (Tuple::Composer, cd.composer);
+
+                if (cd.date)
                 {
-                    const char * s;
-                    if ((s = cdtext_get (PTI_PERFORMER, cdtext)))
-                        base_tuple.set_str (Tuple::AlbumArtist, s);
-                    if ((s = cdtext_get (PTI_TITLE, cdtext)))
-                        base_tuple.set_str (Tuple::Album, s);
-                    if ((s = cdtext_get (PTI_GENRE, cdtext)))
-                        base_tuple.set_str (Tuple::Genre, s);
-                    if ((s = cdtext_get (PTI_COMPOSER, cdtext)))
-                        base_tuple.set_str (Tuple::Composer, s);
+                    if (is_year (cd.date))
+                        base_tuple.set_int (Tuple::Year, str_to_int (cd.date));
+                    else
+                        base_tuple.set_str (Tuple::Date, cd.date);
                 }
 
-                Rem * rem = cd_get_rem (cd);
-
-                if (rem)
-                {
-                    const char * s;
-
-                    if ((s = rem_get (REM_DATE, rem)))
-                    {
-                        if (is_year (s))
-                            base_tuple.set_int (Tuple::Year, str_to_int (s));
-                        else
-                            base_tuple.set_str (Tuple::Date, s);
-                    }
-
-                    if ((s = rem_get (REM_REPLAYGAIN_ALBUM_GAIN, rem)))
-                        base_tuple.set_gain (Tuple::AlbumGain, Tuple::GainDivisor, s);
-                    if ((s = rem_get (REM_REPLAYGAIN_ALBUM_PEAK, rem)))
-                        base_tuple.set_gain (Tuple::AlbumPeak, Tuple::PeakDivisor, s);
-                }
+                if (cd.gain)
+                    base_tuple.set_gain (Tuple::AlbumGain, Tuple::GainDivisor, cd.gain);
+                if (cd.peak)
+                    base_tuple.set_gain (Tuple::AlbumPeak, Tuple::PeakDivisor, cd.peak);
             }
         }
 
-        Track * next = (track + 1 <= tracks) ? cd_get_track (cd, track + 1) : nullptr;
-        const char * next_name = next ? track_get_filename (next) : nullptr;
+        const CueTrack * next = (track + 1 <= tracks) ? & cd.tracks[track] : nullptr;
+        const char * next_name = next ? (const char *) next->filename : nullptr;
 
         same_file = (next_name && ! strcmp (next_name, cur_name));
 
@@ -156,12 +399,12 @@ bool CueLoader::load (const char * cue_filename, VFSFile & file, String & title,
             tuple.set_int (Tuple::Track, track);
             tuple.set_str (Tuple::AudioFile, filename);
 
-            int begin = (int64_t) track_get_start (cur) * 1000 / 75;
+            int begin = (int64_t) track_start (cur) * 1000 / 75;
             tuple.set_int (Tuple::StartTime, begin);
 
             if (same_file)
             {
-                int end = (int64_t) track_get_start (next) * 1000 / 75;
+                int end = (int64_t) track_start (next) * 1000 / 75;
                 tuple.set_int (Tuple::EndTime, end);
                 tuple.set_int (Tuple::Length, end - begin);
             }
@@ -172,29 +415,17 @@ bool CueLoader::load (const char * cue_filename, VFSFile & file, String & title,
                     tuple.set_int (Tuple::Length, length - begin);
             }
 
-            Cdtext * cdtext = track_get_cdtext (cur);
-
-            if (cdtext)
-            {
-                const char * s;
-                if ((s = cdtext_get (PTI_PERFORMER, cdtext)))
-                    tuple.set_str (Tuple::Artist, s);
-                if ((s = cdtext_get (PTI_TITLE, cdtext)))
-                    tuple.set_str (Tuple::Title, s);
-                if ((s = cdtext_get (PTI_GENRE, cdtext)))
-                    tuple.set_str (Tuple::Genre, s);
-            }
-
-            Rem * rem = track_get_rem (cur);
-
-            if (rem)
-            {
-                const char * s;
-                if ((s = rem_get (REM_REPLAYGAIN_TRACK_GAIN, rem)))
-                    tuple.set_gain (Tuple::TrackGain, Tuple::GainDivisor, s);
-                if ((s = rem_get (REM_REPLAYGAIN_TRACK_PEAK, rem)))
-                    tuple.set_gain (Tuple::TrackPeak, Tuple::PeakDivisor, s);
-            }
+            if (cur->performer)
+                tuple.set_str (Tuple::Artist, cur->performer);
+            if (cur->title)
+                tuple.set_str (Tuple::Title, cur->title);
+            if (cur->genre)
+                tuple.set_str (Tuple::Genre, cur->genre);
+
+            if (cur->gain)
+                tuple.set_gain (Tuple::TrackGain, Tuple::GainDivisor, cur->gain);
+            if (cur->peak)
+                tuple.set_gain (Tuple::TrackPeak, Tuple::PeakDivisor, cur->peak);
 
             items.append (String (tfilename), std::move (tuple), decoder);
         }
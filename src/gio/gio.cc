@@ -17,6 +17,7 @@
  * the use of this software.
  */
 
+#include <pthread.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
@@ -28,21 +29,56 @@
 #include <libaudcore/i18n.h>
 #include <libaudcore/interface.h>
 #include <libaudcore/plugin.h>
+#include <libaudcore/preferences.h>
 #include <libaudcore/runtime.h>
 
+/* Files opened for reading are read in aligned blocks of this size by a
+ * worker thread, which also reads ahead of the decoder. */
+#define GIO_BLOCK_SIZE (64 * 1024)
+
 static const char gio_about[] =
  N_("GIO Plugin for Audacious\n"
     "Copyright 2009-2012 John Lindgren");
 
 static const char * const gio_schemes[] = {"ftp", "sftp", "smb", "mtp"};
 
+static const char * const gio_defaults[] = {
+    "read_ahead", "TRUE",
+    "read_ahead_kb", "256",
+    "cache_kb", "1024",
+    nullptr
+};
+
+static const PreferencesWidget gio_widgets[] = {
+    WidgetLabel (N_("<b>Buffering</b>")),
+    WidgetCheck (N_("Read files in the background"),
+        WidgetBool ("gio", "read_ahead")),
+    WidgetSpin (N_("Read ahead:"),
+        WidgetInt ("gio", "read_ahead_kb"),
+        {0, 8192, 64, N_("KiB")},
+        WIDGET_CHILD),
+    WidgetSpin (N_("Cache per file:"),
+        WidgetInt ("gio", "cache_kb"),
+        {64, 65536, 64, N_("KiB")},
+        WIDGET_CHILD)
+};
+
+static const PluginPreferences gio_prefs = {{gio_widgets}};
+
 class GIOTransport : public TransportPlugin
 {
 public:
-    static constexpr PluginInfo info = {N_("GIO Plugin"), PACKAGE, gio_about};
+    static constexpr PluginInfo info = {
+        N_("GIO Plugin"),
+        PACKAGE,
+        gio_about,
+        & gio_prefs
+    };
 
     constexpr GIOTransport () : TransportPlugin (info, gio_schemes) {}
 
+    bool init ();
+
     VFSImpl * fopen (const char * path, const char * mode, String & error);
     VFSFileTest test_file (const char * filename, VFSFileTest test, String & error);
     Index<String> read_folder (const char * filename, String & error);
@@ -50,6 +86,19 @@ public:
 
 EXPORT GIOTransport aud_plugin_instance;
 
+bool GIOTransport::init ()
+{
+    aud_config_set_defaults ("gio", gio_defaults);
+    return true;
+}
+
+struct CachedBlock
+{
+    int64_t index;
+    Index<char> data;
+    int64_t used;
+};
+
 class GIOFile : public VFSImpl
 {
 public:
@@ -82,6 +131,38 @@ private:
     GOutputStream * m_ostream = nullptr;
     GSeekable * m_seekable = nullptr;
     bool m_eof = false;
+
+    /* Block mode, for files opened read-only with a known size.  The
+     * worker thread does all reads from the stream; the decoder only
+     * copies out of the cached blocks.  Everything below m_size is
+     * protected by m_mutex. */
+    bool m_blocks = false;
+    int64_t m_pos = 0;
+    int64_t m_size = -1;
+
+    pthread_mutex_t m_mutex = PTHREAD_MUTEX_INITIALIZER;
+    pthread_cond_t m_cond = PTHREAD_COND_INITIALIZER;
+    pthread_t m_worker;
+    bool m_worker_running = false;
+
+    Index<CachedBlock> m_cache;
+    int64_t m_use_counter = 0;
+    int64_t m_read_block = 0;     /* block being read, for read-ahead */
+    int64_t m_want_block = -1;    /* block the decoder is waiting for */
+    bool m_read_error = false;    /* stops read-ahead after an error */
+    int64_t m_stream_pos = 0;     /* position of the stream (worker only) */
+
+    void start_blocks ();
+    void stop_worker ();
+    CachedBlock * find_block (int64_t index);
+    int64_t next_block ();
+    bool read_block (int64_t index, Index<char> & data);
+    void store_block (int64_t index, Index<char> && data);
+    void worker ();
+    int64_t block_fread (char * buf, int64_t bytes);
+
+    static void * worker_thread (void * data)
+        { ((GIOFile *) data)->worker (); return nullptr; }
 };
 
 #define CHECK_ERROR(op, name) do { \
@@ -125,6 +206,9 @@ GIOFile::GIOFile (const char * filename, const char * mode) :
             m_istream = (GInputStream *) g_file_read (m_file, 0, & error);
             CHECK_AND_SAVE_ERROR ("open", filename);
             m_seekable = (GSeekable *) m_istream;
+
+            if (aud_get_bool ("gio", "read_ahead"))
+                start_blocks ();
         }
         break;
     case 'w':
@@ -177,6 +261,8 @@ GIOFile::~GIOFile ()
 {
     GError * error = nullptr;
 
+    stop_worker ();
+
     if (m_iostream)
     {
         g_io_stream_close (m_iostream, 0, & error);
@@ -200,6 +286,239 @@ FAILED:
     g_object_unref (m_file);
 }
 
+/* Switches to block mode if the size of the file can be had cheaply. */
+void GIOFile::start_blocks ()
+{
+    if (! g_seekable_can_seek (m_seekable))
+        return;
+
+    GFileInfo * info = g_file_input_stream_query_info ((GFileInputStream *) m_istream,
+     G_FILE_ATTRIBUTE_STANDARD_SIZE, nullptr, nullptr);
+
+    if (! info)
+        return;
+
+    if (g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_STANDARD_SIZE))
+    {
+        m_size = g_file_info_get_size (info);
+        m_blocks = true;
+    }
+
+    g_object_unref (info);
+}
+
+void GIOFile::stop_worker ()
+{
+    pthread_mutex_lock (& m_mutex);
+
+    if (! m_worker_running)
+    {
+        pthread_mutex_unlock (& m_mutex);
+        return;
+    }
+
+    m_worker_running = false;
+    pthread_cond_broadcast (& m_cond);
+    pthread_mutex_unlock (& m_mutex);
+
+    pthread_join (m_worker, nullptr);
+}
+
+/* Called with m_mutex held */
+CachedBlock * GIOFile::find_block (int64_t index)
+{
+    for (CachedBlock & block : m_cache)
+    {
+        if (block.index == index)
+        {
+            block.used = ++ m_use_counter;
+            return & block;
+        }
+    }
+
+    return nullptr;
+}
+
+/* Picks the block the worker should read next: the one the decoder is
+ * waiting for, else the first missing one in the read-ahead window.
+ * Called with m_mutex held. */
+int64_t GIOFile::next_block ()
+{
+    if (m_want_block >= 0)
+        return m_want_block;
+
+    if (m_read_error)
+        return -1;
+
+    int64_t ahead = aud_get_int ("gio", "read_ahead_kb") * 1024 / GIO_BLOCK_SIZE;
+    int64_t last = aud::min ((m_size - 1) / GIO_BLOCK_SIZE, m_read_block + ahead);
+
+    for (int64_t index = m_read_block + 1; index <= last; index ++)
+    {
+        bool cached = false;
+
+        for (const CachedBlock & block : m_cache)
+            cached = cached || block.index == index;
+
+        if (! cached)
+            return index;
+    }
+
+    return -1;
+}
+
+/* Called from the worker thread only, without m_mutex held */
+bool GIOFile::read_block (int64_t index, Index<char> & data)
+{
+    GError * error = nullptr;
+    int64_t start = index * GIO_BLOCK_SIZE;
+    gsize length = 0;
+
+    if (m_stream_pos != start)
+    {
+        g_seekable_seek (m_seekable, start, G_SEEK_SET, nullptr, & error);
+        CHECK_ERROR ("seek within", m_filename);
+        m_stream_pos = start;
+    }
+
+    data.resize (aud::min ((int64_t) GIO_BLOCK_SIZE, m_size - start));
+
+    g_input_stream_read_all (m_istream, data.begin (), data.len (), & length, nullptr, & error);
+    m_stream_pos += length;
+    CHECK_ERROR ("read from", m_filename);
+
+    /* the file may have shrunk since we opened it */
+    data.resize (length);
+    return true;
+
+FAILED:
+    m_stream_pos = -1;
+    return false;
+}
+
+/* Called with m_mutex held.  Evicts the least recently used blocks to
+ * stay within the cache size, but never the block being read. */
+void GIOFile::store_block (int64_t index, Index<char> && data)
+{
+    int64_t ahead = aud_get_int ("gio", "read_ahead_kb") * 1024 / GIO_BLOCK_SIZE;
+    int64_t limit = aud::max (aud_get_int ("gio", "cache_kb") * 1024 / GIO_BLOCK_SIZE, ahead + 2);
+
+    while (m_cache.len () >= limit)
+    {
+        int oldest = -1;
+
+        for (int i = 0; i < m_cache.len (); i ++)
+        {
+            if (m_cache[i].index != m_read_block &&
+             (oldest < 0 || m_cache[i].used < m_cache[oldest].used))
+                oldest = i;
+        }
+
+        if (oldest < 0)
+            break;
+
+        m_cache.remove (oldest, 1);
+    }
+
+    CachedBlock & block = m_cache.append ();
+    block.index = index;
+    block.data = std::move (data);
+    block.used = ++ m_use_counter;
+}
+
+void GIOFile::worker ()
+{
+    pthread_mutex_lock (& m_mutex);
+
+    while (m_worker_running)
+    {
+        int64_t index = next_block ();
+
+        if (index < 0)
+        {
+            /* Nothing to do until the decoder moves on. */
+            pthread_cond_wait (& m_cond, & m_mutex);
+            continue;
+        }
+
+        pthread_mutex_unlock (& m_mutex);
+
+        Index<char> data;
+        bool success = read_block (index, data);
+
+        pthread_mutex_lock (& m_mutex);
+
+        if (success)
+            store_block (index, std::move (data));
+        else
+            m_read_error = true;
+
+        /* A failed read is reported to a waiting decoder by leaving the
+         * block out of the cache. */
+        if (index == m_want_block)
+            m_want_block = -1;
+
+        pthread_cond_broadcast (& m_cond);
+    }
+
+    pthread_mutex_unlock (& m_mutex);
+}
+
+/* Serves a read from the cached blocks, waiting for the worker to read
+ * any that are missing.  Small reads are thereby coalesced into block
+ * sized requests to the server. */
+int64_t GIOFile::block_fread (char * buf, int64_t bytes)
+{
+    int64_t total = 0;
+
+    pthread_mutex_lock (& m_mutex);
+
+    if (! m_worker_running)
+    {
+        m_worker_running = true;
+        pthread_create (& m_worker, nullptr, worker_thread, this);
+    }
+
+    while (total < bytes && m_pos < m_size)
+    {
+        int64_t index = m_pos / GIO_BLOCK_SIZE;
+        m_read_block = index;
+
+        CachedBlock * block = find_block (index);
+
+        if (! block)
+        {
+            /* retry blocks that failed to read ahead */
+            m_read_error = false;
+            m_want_block = index;
+            pthread_cond_broadcast (& m_cond);
+
+            while (m_want_block >= 0)
+                pthread_cond_wait (& m_cond, & m_mutex);
+
+            if (! (block = find_block (index)))
+                break;
+        }
+        else
+            pthread_cond_broadcast (& m_cond);
+
+        int64_t offset = m_pos - index * GIO_BLOCK_SIZE;
+        int64_t copy = aud::min (bytes - total, block->data.len () - offset);
+
+        if (copy <= 0)
+            break;
+
+        memcpy (buf + total, block->data.begin () + offset, copy);
+        total += copy;
+        m_pos += copy;
+    }
+
+    pthread_mutex_unlock (& m_mutex);
+
+    m_eof = (total < bytes);
+    return total;
+}
+
 VFSImpl * GIOTransport::fopen (const char * filename, const char * mode, String & error)
 {
     g_type_init ();
@@ -222,6 +541,9 @@ int64_t GIOFile::fread (void * buf, int64_t size, int64_t nitems)
         return 0;
     }
 
+    if (m_blocks)
+        return (size > 0) ? block_fread ((char *) buf, size * nitems) / size : 0;
+
     int64_t total = 0;
     int64_t remain = size * nitems;
 
@@ -295,6 +617,23 @@ int GIOFile::fseek (int64_t offset, VFSSeekType whence)
         return -1;
     }
 
+    /* In block mode, the next read fetches whatever blocks it needs. */
+    if (m_blocks)
+    {
+        int64_t base = (whence == VFS_SEEK_SET) ? 0 :
+         (whence == VFS_SEEK_CUR) ? m_pos : m_size;
+
+        if (base + offset < 0)
+        {
+            AUDERR ("Cannot seek within %s: invalid offset.\n", (const char *) m_filename);
+            return -1;
+        }
+
+        m_pos = base + offset;
+        m_eof = (whence == VFS_SEEK_END && offset == 0);
+        return 0;
+    }
+
     g_seekable_seek (m_seekable, offset, gwhence, nullptr, & error);
     CHECK_ERROR ("seek within", m_filename);
 
@@ -308,6 +647,9 @@ FAILED:
 
 int64_t GIOFile::ftell ()
 {
+    if (m_blocks)
+        return m_pos;
+
     return g_seekable_tell (m_seekable);
 }
 
@@ -333,6 +675,9 @@ FAILED:
 
 int64_t GIOFile::fsize ()
 {
+    if (m_blocks)
+        return m_size;
+
     if (! g_seekable_can_seek (m_seekable))
         return -1;
 
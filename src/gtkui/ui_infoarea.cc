@@ -27,6 +27,7 @@
 #include <libaudcore/interface.h>
 #include <libaudgui/libaudgui-gtk.h>
 
+#include "../ui-common/art-gtk.h"
 #include "ui_infoarea.h"
 
 #define VIS_BANDS 12
@@ -291,16 +292,25 @@ static void ui_infoarea_set_title ()
     gtk_widget_queue_draw (area->main);
 }
 
-static void set_album_art ()
+static void album_art_ready (ArtImage * image, void *)
 {
     g_return_if_fail (area);
 
-    area->pb = audgui_pixbuf_request_current ();
-
-    if (area->pb)
-        audgui_pixbuf_scale_within (area->pb, ICON_SIZE);
+    if (image)
+        area->pb = std::move (image->pixbuf);
     else
         area->pb = audgui_pixbuf_fallback ();
+
+    gtk_widget_queue_draw (area->main);
+}
+
+static void set_album_art ()
+{
+    g_return_if_fail (area);
+
+    area->pb.clear ();
+    art_request_current (ICON_SIZE, album_art_ready, area);
+    art_prefetch_next (ICON_SIZE);
 }
 
 static void infoarea_next ()
@@ -336,6 +346,7 @@ static void ui_infoarea_playback_stop ()
 {
     g_return_if_fail (area);
 
+    art_cancel (area);
     infoarea_next ();
     area->stopped = true;
 
@@ -397,6 +408,8 @@ static void destroy_cb (GtkWidget * widget)
 
     timer_remove (TimerRate::Hz30, ui_infoarea_do_fade);
 
+    art_cleanup ();
+
     delete area;
     area = nullptr;
 }
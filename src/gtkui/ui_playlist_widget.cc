@@ -107,28 +107,139 @@ static const Playlist::SortType pw_col_sort_types[PW_COLS] = {
     Playlist::Comment          // comment
 };
 
+/* Formatted values are cached for a window of rows around the last one
+ * shown.  The tuple of each entry is fetched once when the window is
+ * filled, rather than once for every cell on every repaint. */
+#define CACHE_ROWS 256
+
+struct CachedRow
+{
+    bool fetched = false;
+    int formatted = 0;  // bit mask of columns
+    Tuple tuple;
+    String values[PW_COLS];
+};
+
 struct PlaylistWidgetData
 {
     Playlist list;
     int popup_pos = -1;
     QueuedFunc popup_timer;
 
+    int cache_start = 0;
+    Index<CachedRow> cache;
+    CachedRow empty_row;  // for rows not (or no longer) in the playlist
+
     void show_popup ()
         { audgui_infopopup_show (list, popup_pos); }
+
+    CachedRow & cached_row (int row);
+    void invalidate_rows (int row, int count);
 };
 
-static void set_int_from_tuple (GValue * value, const Tuple & tuple, Tuple::Field field)
+CachedRow & PlaylistWidgetData::cached_row (int row)
+{
+    /* GTK may repaint rows before the update hook has shrunk the model */
+    if (row < 0 || row >= list.n_entries ())
+    {
+        empty_row = CachedRow ();
+        empty_row.fetched = true;
+        return empty_row;
+    }
+
+    if (row < cache_start || row >= cache_start + cache.len ())
+    {
+        cache_start = aud::max (row - CACHE_ROWS / 2, 0);
+        int cache_end = aud::min (cache_start + CACHE_ROWS, list.n_entries ());
+
+        cache.clear ();
+        cache.insert (0, aud::max (cache_end - cache_start, 0));
+
+        for (int i = 0; i < cache.len (); i ++)
+        {
+            cache[i].tuple = list.entry_tuple (cache_start + i, Playlist::NoWait);
+            cache[i].fetched = true;
+        }
+    }
+
+    CachedRow & cached = cache[row - cache_start];
+
+    if (! cached.fetched)
+    {
+        cached.tuple = list.entry_tuple (row, Playlist::NoWait);
+        cached.fetched = true;
+        cached.formatted = 0;
+    }
+
+    return cached;
+}
+
+/* count = -1 means all rows from the given one; those are dropped from
+ * the window, so that they are fetched again in one go */
+void PlaylistWidgetData::invalidate_rows (int row, int count)
+{
+    int first = aud::clamp (row - cache_start, 0, cache.len ());
+
+    if (count < 0)
+    {
+        cache.remove (first, -1);
+        return;
+    }
+
+    int last = aud::clamp (row + count - cache_start, first, cache.len ());
+
+    for (int i = first; i < last; i ++)
+    {
+        cache[i].fetched = false;
+        cache[i].formatted = 0;
+    }
+}
+
+static String format_int (const Tuple & tuple, Tuple::Field field)
 {
     int i = tuple.get_int (field);
-    if (i > 0)
-        g_value_take_string (value, g_strdup_printf ("%d", i));
-    else
-        g_value_set_string (value, "");
+    return (i > 0) ? String (int_to_str (i)) : String ("");
 }
 
-static void set_string_from_tuple (GValue * value, const Tuple & tuple, Tuple::Field field)
+static String format_length (const Tuple & tuple)
 {
-    g_value_set_string (value, tuple.get_str (field));
+    int len = tuple.get_int (Tuple::Length);
+    return (len >= 0) ? String (str_format_time (len)) : String ("");
+}
+
+static String format_value (const Tuple & tuple, int column)
+{
+    switch (column)
+    {
+    case PW_COL_TITLE:
+        return tuple.get_str (Tuple::Title);
+    case PW_COL_ARTIST:
+        return tuple.get_str (Tuple::Artist);
+    case PW_COL_YEAR:
+        return format_int (tuple, Tuple::Year);
+    case PW_COL_ALBUM:
+        return tuple.get_str (Tuple::Album);
+    case PW_COL_ALBUM_ARTIST:
+        return tuple.get_str (Tuple::AlbumArtist);
+    case PW_COL_TRACK:
+        return format_int (tuple, Tuple::Track);
+    case PW_COL_GENRE:
+        return tuple.get_str (Tuple::Genre);
+    case PW_COL_LENGTH:
+        return format_length (tuple);
+    case PW_COL_FILENAME:
+        return tuple.get_str (Tuple::Basename);
+    case PW_COL_PATH:
+        return tuple.get_str (Tuple::Path);
+    case PW_COL_CUSTOM:
+        return tuple.get_str (Tuple::FormattedTitle);
+    case PW_COL_BITRATE:
+        return format_int (tuple, Tuple::Bitrate);
+    case PW_COL_COMMENT:
+        return tuple.get_str (Tuple::Comment);
+    default:
+        return String ();
+    }
 }
 
 static void set_queued (GValue * value, Playlist list, int row)
@@ -140,15 +251,6 @@ static void set_queued (GValue * value, Playlist list, int row)
         g_value_take_string (value, g_strdup_printf ("#%d", 1 + q));
 }
 
-static void set_length (GValue * value, const Tuple & tuple)
-{
-    int len = tuple.get_int (Tuple::Length);
-    if (len >= 0)
-        g_value_set_string (value, str_format_time (len));
-    else
-        g_value_set_string (value, "");
-}
-
 static void get_value (void * user, int row, int column, GValue * value)
 {
     PlaylistWidgetData * data = (PlaylistWidgetData *) user;
@@ -157,57 +259,24 @@ static void get_value (void * user, int row, int column, GValue * value)
 
     column = pw_cols[column];
 
-    Tuple tuple;
-
-    if (column != PW_COL_NUMBER && column != PW_COL_QUEUED)
-        tuple = data->list.entry_tuple (row, Playlist::NoWait);
-
     switch (column)
     {
     case PW_COL_NUMBER:
         g_value_set_int (value, 1 + row);
         break;
-    case PW_COL_TITLE:
-        set_string_from_tuple (value, tuple, Tuple::Title);
-        break;
-    case PW_COL_ARTIST:
-        set_string_from_tuple (value, tuple, Tuple::Artist);
-        break;
-    case PW_COL_YEAR:
-        set_int_from_tuple (value, tuple, Tuple::Year);
-        break;
-    case PW_COL_ALBUM:
-        set_string_from_tuple (value, tuple, Tuple::Album);
-        break;
-    case PW_COL_ALBUM_ARTIST:
-        set_string_from_tuple (value, tuple, Tuple::AlbumArtist);
-        break;
-    case PW_COL_TRACK:
-        set_int_from_tuple (value, tuple, Tuple::Track);
-        break;
-    case PW_COL_GENRE:
-        set_string_from_tuple (value, tuple, Tuple::Genre);
-        break;
     case PW_COL_QUEUED:
         set_queued (value, data->list, row);
         break;
-    case PW_COL_LENGTH:
-        set_length (value, tuple);
-        break;
-    case PW_COL_FILENAME:
-        set_string_from_tuple (value, tuple, Tuple::Basename);
-        break;
-    case PW_COL_PATH:
-        set_string_from_tuple (value, tuple, Tuple::Path);
-        break;
-    case PW_COL_CUSTOM:
-        set_string_from_tuple (value, tuple, Tuple::FormattedTitle);
-        break;
-    case PW_COL_BITRATE:
-        set_int_from_tuple (value, tuple, Tuple::Bitrate);
-        break;
-    case PW_COL_COMMENT:
-        set_string_from_tuple (value, tuple, Tuple::Comment);
+    default:
+        CachedRow & cached = data->cached_row (row);
+
+        if (! (cached.formatted & (1 << column)))
+        {
+            cached.values[column] = format_value (cached.tuple, column);
+            cached.formatted |= (1 << column);
+        }
+
+        g_value_set_string (value, cached.values[column]);
         break;
     }
 }
@@ -434,6 +503,9 @@ void ui_playlist_widget_update (GtkWidget * widget)
         int old_entries = audgui_list_row_count (widget);
         int removed = old_entries - update.before - update.after;
 
+        /* later rows have moved */
+        data->invalidate_rows (update.before, -1);
+
         audgui_list_delete_rows (widget, update.before, removed);
         audgui_list_insert_rows (widget, update.before, changed);
 
@@ -445,7 +517,12 @@ void ui_playlist_widget_update (GtkWidget * widget)
         ui_playlist_widget_scroll (widget);
     }
     else if (update.level == Playlist::Metadata || update.queue_changed)
+    {
+        if (update.level == Playlist::Metadata)
+            data->invalidate_rows (update.before, changed);
+
         audgui_list_update_rows (widget, update.before, changed);
+    }
 
     if (update.queue_changed)
     {
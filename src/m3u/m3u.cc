@@ -18,12 +18,16 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
  */
 
+#include <stdlib.h>
 #include <string.h>
 
 #include <libaudcore/audstrings.h>
 #include <libaudcore/i18n.h>
 #include <libaudcore/plugin.h>
 
+/* lines are collected and written out in chunks of about this size */
+#define WRITE_CHUNK (64 * 1024)
+
 static const char * const m3u_exts[] = {"m3u", "m3u8"};
 
 class M3ULoader : public PlaylistPlugin
@@ -55,6 +59,80 @@ static char * split_line (char * line)
     return feed + 1;
 }
 
+static const char * skip_prefix (const char * line, const char * prefix)
+{
+    int len = strlen (prefix);
+    return strncmp (line, prefix, len) ? nullptr : line + len;
+}
+
+/* #EXTINF:<seconds>[ key="value" ...],[<artist> - ]<title>
+ * The first " - " separates the artist; an empty artist lets a title
+ * contain " - " itself. */
+static void parse_extinf (const char * info, Tuple & tuple)
+{
+    char * end;
+    double seconds = strtod (info, & end);
+
+    if (end > info && seconds > 0)
+        tuple.set_int (Tuple::Length, seconds * 1000);
+
+    /* skip any attributes, which may contain quoted commas */
+    bool quoted = false;
+    const char * p = end;
+
+    while (* p && (quoted || * p != ','))
+    {
+        if (* p == '"')
+            quoted = ! quoted;
+
+        p ++;
+    }
+
+    if (! * p || ! p[1])
+        return;
+
+    StringBuf name = str_to_utf8 (p + 1, -1);
+    if (! name)
+        return;
+
+    const char * dash = strstr (name, " - ");
+
+    if (dash)
+    {
+        if (dash > name)
+            tuple.set_str (Tuple::Artist, str_copy (name, dash - name));
+
+        tuple.set_str (Tuple::Title, dash + 3);
+    }
+    else
+        tuple.set_str (Tuple::Title, name);
+}
+
+/* #EXTALB:, #EXTART: and #EXTGENRE: apply to the next entry */
+static void parse_extension (const char * line, Tuple & tuple)
+{
+    static const struct {
+        const char * prefix;
+        Tuple::Field field;
+    } extensions[] = {
+        {"#EXTALB:", Tuple::Album},
+        {"#EXTART:", Tuple::AlbumArtist},
+        {"#EXTGENRE:", Tuple::Genre}
+    };
+
+    for (auto & ext : extensions)
+    {
+        const char * value = skip_prefix (line, ext.prefix);
+
+        if (value && * value)
+        {
+            StringBuf str = str_to_utf8 (value, -1);
+            if (str)
+                tuple.set_str (ext.field, str);
+        }
+    }
+}
+
 bool M3ULoader::load (const char * filename, VFSFile & file, String & title,
  Index<PlaylistAddItem> & items)
 {
@@ -68,6 +146,11 @@ bool M3ULoader::load (const char * filename, VFSFile & file, String & title,
     if (! strncmp (parse, "\xef\xbb\xbf", 3)) /* byte order mark */
         parse += 3;
 
+    /* Extended info from the comment lines before an entry goes into an
+     * initial tuple, so that the entry need not be probed to show it. */
+    Tuple tuple;
+    bool have_info = false;
+
     while (parse)
     {
         char * next = split_line (parse);
@@ -75,11 +158,43 @@ bool M3ULoader::load (const char * filename, VFSFile & file, String & title,
         while (* parse == ' ' || * parse == '\t')
             parse ++;
 
-        if (* parse && * parse != '#')
+        if (* parse == '#')
+        {
+            const char * value;
+
+            if ((value = skip_prefix (parse, "#EXTINF:")))
+            {
+                parse_extinf (value, tuple);
+                have_info = true;
+            }
+            else if ((value = skip_prefix (parse, "#PLAYLIST:")) && * value)
+                title = String (str_to_utf8 (value, -1));
+            else if (! strncmp (parse, "#EXT", 4) && strcmp (parse, "#EXTM3U"))
+            {
+                parse_extension (parse, tuple);
+                have_info = true;
+            }
+        }
+        else if (* parse)
         {
             StringBuf s = uri_construct (parse, filename);
+
             if (s)
-                items.append (String (s));
+            {
+                String uri (s);
+
+                if (have_info && tuple.get_str (Tuple::Title))
+                {
+                    tuple.set_filename (uri);
+                    tuple.set_state (Tuple::Valid);
+                    items.append (uri, std::move (tuple));
+                }
+                else
+                    items.append (uri);
+            }
+
+            tuple = Tuple ();
+            have_info = false;
         }
 
         parse = next;
@@ -88,16 +203,65 @@ bool M3ULoader::load (const char * filename, VFSFile & file, String & title,
     return true;
 }
 
+static bool flush_text (VFSFile & file, Index<char> & text)
+{
+    bool success = (file.fwrite (text.begin (), 1, text.len ()) == text.len ());
+    text.clear ();
+    return success;
+}
+
+static void append_line (Index<char> & text, const char * line)
+{
+    text.insert (line, -1, strlen (line));
+    text.append ('\n');
+}
+
 bool M3ULoader::save (const char * filename, VFSFile & file, const char * title,
  const Index<PlaylistAddItem> & items)
 {
+    Index<char> text;
+
+    append_line (text, "#EXTM3U");
+
+    if (title && title[0])
+        append_line (text, str_concat ({"#PLAYLIST:", title}));
+
     for (auto & item : items)
     {
-        StringBuf path = uri_deconstruct (item.filename, filename);
-        StringBuf line = str_concat ({path, "\n"});
-        if (file.fwrite (line, 1, line.len ()) != line.len ())
+        const Tuple & tuple = item.tuple;
+        String item_title = tuple.valid () ? tuple.get_str (Tuple::Title) : String ();
+
+        if (item_title)
+        {
+            String artist = tuple.get_str (Tuple::Artist);
+            String album = tuple.get_str (Tuple::Album);
+            String album_artist = tuple.get_str (Tuple::AlbumArtist);
+            String genre = tuple.get_str (Tuple::Genre);
+            int length = tuple.get_int (Tuple::Length);
+
+            StringBuf seconds = int_to_str (length > 0 ? (length + 500) / 1000 : -1);
+
+            /* without an artist, a title containing " - " would be split
+             * when the playlist is loaded again */
+            if (artist || strstr (item_title, " - "))
+                append_line (text, str_concat ({"#EXTINF:", seconds, ",",
+                 artist ? (const char *) artist : "", " - ", item_title}));
+            else
+                append_line (text, str_concat ({"#EXTINF:", seconds, ",", item_title}));
+
+            if (album)
+                append_line (text, str_concat ({"#EXTALB:", album}));
+            if (album_artist)
+                append_line (text, str_concat ({"#EXTART:", album_artist}));
+            if (genre)
+                append_line (text, str_concat ({"#EXTGENRE:", genre}));
+        }
+
+        append_line (text, uri_deconstruct (item.filename, filename));
+
+        if (text.len () >= WRITE_CHUNK && ! flush_text (file, text))
             return false;
     }
 
-    return true;
+    return flush_text (file, text);
 }
@@ -0,0 +1,350 @@
+/*
+ *  Block cache for the neon HTTP input plugin
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#define __STDC_FORMAT_MACROS
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <string.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <libaudcore/audstrings.h>
+#include <libaudcore/list.h>
+#include <libaudcore/multihash.h>
+#include <libaudcore/runtime.h>
+
+#include "block_cache.h"
+
+/* Blocks are kept in memory up to the "cache_mb" budget.  Blocks pushed
+ * out of memory are written to the user's cache directory, if enabled,
+ * up to the "disk_cache_mb" budget.  The disk files only live as long as
+ * the plugin is loaded; they are a spill area, not a persistent cache.
+ *
+ * The lock is never held during file operations, so that one stream
+ * reading or writing the disk does not stall the others.  A block being
+ * written is not in the cache yet; a block being read back has already
+ * been taken out of it. */
+
+struct BlockKey
+{
+    String key;
+    int64_t index;
+
+    /* Strings are pooled, so comparing the pointers is enough */
+    bool operator== (const BlockKey & b) const
+        { return index == b.index && key == b.key; }
+    unsigned hash () const
+        { return key.hash () + 31 * (unsigned) index; }
+};
+
+struct Block : public ListNode
+{
+    BlockKey id;
+    Index<char> data;  /* in memory */
+    String path;       /* on disk */
+    int64_t size;
+};
+
+/* file operations collected under the lock and done after releasing it */
+struct DiskWork
+{
+    unsigned generation;
+    Index<Block *> writes;
+    Index<String> unlinks;
+};
+
+static pthread_mutex_t cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* least recently used first */
+static List<Block> memory_lru, disk_lru;
+static SimpleHash<BlockKey, Block *> memory_blocks, disk_blocks;
+
+static int64_t memory_size, disk_size;
+static unsigned generation;  /* bumped by block_cache_clear () */
+static unsigned file_serial;
+
+static StringBuf disk_cache_dir ()
+{
+    return filename_build ({g_get_user_cache_dir (), "audacious", "neon"});
+}
+
+static int64_t disk_limit ()
+{
+    return (int64_t) aud_get_int ("neon", "disk_cache_mb") << 20;
+}
+
+static void remove_disk_block (Block * block, DiskWork & work)
+{
+    disk_lru.remove (block);
+    disk_blocks.remove (block->id);
+    disk_size -= block->size;
+
+    work.unlinks.append (std::move (block->path));
+    delete block;
+}
+
+static void add_to_memory (const BlockKey & id, Index<char> && data, DiskWork & work)
+{
+    int64_t limit = (int64_t) aud_get_int ("neon", "cache_mb") << 20;
+    bool spill = aud_get_bool ("neon", "disk_cache");
+
+    Block * oldest;
+    while ((oldest = memory_lru.head ()) && memory_size + data.len () > limit)
+    {
+        memory_lru.remove (oldest);
+        memory_blocks.remove (oldest->id);
+        memory_size -= oldest->data.len ();
+
+        if (spill && oldest->data.len () <= disk_limit () &&
+         ! disk_blocks.lookup (oldest->id))
+        {
+            /* the serial keeps a file being written apart from an older
+             * copy of the same block */
+            CharPtr hash (g_compute_checksum_for_string (G_CHECKSUM_SHA1, oldest->id.key, -1));
+            oldest->path = String (str_printf ("%s-%" PRId64 "-%u",
+             (const char *) hash, oldest->id.index, ++ file_serial));
+
+            work.writes.append (oldest);
+        }
+        else
+            delete oldest;
+    }
+
+    auto block = new Block;
+    block->id = id;
+    block->data = std::move (data);
+    block->size = block->data.len ();
+
+    memory_lru.append (block);
+    memory_blocks.add (block->id, (Block *) block);
+    memory_size += block->size;
+}
+
+static void unlink_files (const Index<String> & paths)
+{
+    for (const String & path : paths)
+        g_unlink (path);
+}
+
+/* block->path holds the file name until the block is written */
+static bool write_block (Block * block, const char * dir)
+{
+    StringBuf path = filename_build ({dir, block->path});
+    GError * error = nullptr;
+
+    if (! g_file_set_contents (path, block->data.begin (), block->data.len (), & error))
+    {
+        AUDERR ("Failed to write %s: %s\n", (const char *) path, error->message);
+        g_error_free (error);
+        return false;
+    }
+
+    block->path = String (path);
+    block->data.clear ();
+    return true;
+}
+
+static void finish_disk_work (DiskWork & work)
+{
+    unlink_files (work.unlinks);
+
+    if (! work.writes.len ())
+        return;
+
+    StringBuf dir = disk_cache_dir ();
+    bool have_dir = (g_mkdir_with_parents (dir, 0700) == 0);
+
+    if (! have_dir)
+        AUDERR ("Failed to create %s: %s\n", (const char *) dir, strerror (errno));
+
+    for (Block * block : work.writes)
+    {
+        if (! have_dir || ! write_block (block, dir))
+        {
+            delete block;
+            continue;
+        }
+
+        DiskWork evicted;
+
+        pthread_mutex_lock (& cache_mutex);
+
+        int64_t limit = disk_limit ();
+
+        /* skip blocks made stale by a clear or already spilled by another
+         * stream in the meantime */
+        if (work.generation == generation && block->size <= limit &&
+         ! disk_blocks.lookup (block->id))
+        {
+            Block * oldest;
+            while ((oldest = disk_lru.head ()) && disk_size + block->size > limit)
+                remove_disk_block (oldest, evicted);
+
+            disk_lru.append (block);
+            disk_blocks.add (block->id, (Block *) block);
+            disk_size += block->size;
+            block = nullptr;
+        }
+
+        pthread_mutex_unlock (& cache_mutex);
+
+        if (block)
+        {
+            g_unlink (block->path);
+            delete block;
+        }
+
+        unlink_files (evicted.unlinks);
+    }
+}
+
+static void copy_data (Index<char> & to, const Index<char> & from)
+{
+    to.clear ();
+    to.insert (from.begin (), 0, from.len ());
+}
+
+bool block_cache_lookup (const String & key, int64_t index, Index<char> & data)
+{
+    BlockKey id = {key, index};
+    bool found = false;
+    String path;
+    int64_t size = 0;
+    unsigned gen;
+
+    pthread_mutex_lock (& cache_mutex);
+
+    Block * * block;
+
+    if ((block = memory_blocks.lookup (id)))
+    {
+        memory_lru.remove (* block);
+        memory_lru.append (* block);
+        copy_data (data, (* block)->data);
+        found = true;
+    }
+    else if ((block = disk_blocks.lookup (id)))
+    {
+        /* take the block out of the cache; the file is read and removed
+         * after the lock is released */
+        Block * taken = * block;
+        disk_lru.remove (taken);
+        disk_blocks.remove (id);
+        disk_size -= taken->size;
+
+        path = std::move (taken->path);
+        size = taken->size;
+        delete taken;
+    }
+
+    gen = generation;
+
+    pthread_mutex_unlock (& cache_mutex);
+
+    if (found || ! path)
+        return found;
+
+    char * contents = nullptr;
+    size_t length = 0;
+
+    bool read = g_file_get_contents (path, & contents, & length, nullptr) &&
+     (int64_t) length == size;
+
+    g_unlink (path);
+
+    if (! read)
+    {
+        AUDERR ("Lost cached block %s\n", (const char *) path);
+        g_free (contents);
+        return false;
+    }
+
+    data.clear ();
+    data.insert (contents, 0, length);
+    g_free (contents);
+
+    /* promote the block back into memory */
+    Index<char> copy;
+    copy_data (copy, data);
+
+    DiskWork work;
+
+    pthread_mutex_lock (& cache_mutex);
+
+    work.generation = generation;
+    if (gen == generation && ! memory_blocks.lookup (id))
+        add_to_memory (id, std::move (copy), work);
+
+    pthread_mutex_unlock (& cache_mutex);
+
+    finish_disk_work (work);
+    return true;
+}
+
+bool block_cache_contains (const String & key, int64_t index)
+{
+    BlockKey id = {key, index};
+
+    pthread_mutex_lock (& cache_mutex);
+    bool found = memory_blocks.lookup (id) || disk_blocks.lookup (id);
+    pthread_mutex_unlock (& cache_mutex);
+
+    return found;
+}
+
+void block_cache_store (const String & key, int64_t index, Index<char> && data)
+{
+    BlockKey id = {key, index};
+    DiskWork work;
+
+    pthread_mutex_lock (& cache_mutex);
+
+    work.generation = generation;
+    if (! memory_blocks.lookup (id))
+        add_to_memory (id, std::move (data), work);
+
+    pthread_mutex_unlock (& cache_mutex);
+
+    finish_disk_work (work);
+}
+
+void block_cache_clear ()
+{
+    Index<String> unlinks;
+
+    pthread_mutex_lock (& cache_mutex);
+
+    generation ++;
+
+    for (Block * block = disk_lru.head (); block; block = disk_lru.next (block))
+        unlinks.append (std::move (block->path));
+
+    memory_blocks.clear ();
+    disk_blocks.clear ();
+    memory_lru.clear ();
+    disk_lru.clear ();
+
+    memory_size = 0;
+    disk_size = 0;
+
+    pthread_mutex_unlock (& cache_mutex);
+
+    unlink_files (unlinks);
+}
@@ -0,0 +1,36 @@
+/*
+ *  Block cache for the neon HTTP input plugin
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef NEON_BLOCK_CACHE_H
+#define NEON_BLOCK_CACHE_H
+
+#include <stdint.h>
+
+#include <libaudcore/index.h>
+#include <libaudcore/objects.h>
+
+/* Resources are cached in aligned blocks of this size.  The key identifies
+ * one version of a resource (URL plus ETag or Last-Modified). */
+#define NEON_BLOCK_SIZE (64 * 1024)
+
+bool block_cache_lookup (const String & key, int64_t index, Index<char> & data);
+bool block_cache_contains (const String & key, int64_t index);
+void block_cache_store (const String & key, int64_t index, Index<char> && data);
+void block_cache_clear ();
+
+#endif
@@ -28,6 +28,7 @@
 #include <libaudcore/audstrings.h>
 #include <libaudcore/i18n.h>
 #include <libaudcore/plugin.h>
+#include <libaudcore/preferences.h>
 #include <libaudcore/ringbuf.h>
 #include <libaudcore/runtime.h>
 
@@ -39,11 +40,18 @@
 #include <ne_uri.h>
 #include <ne_utils.h>
 
+#include "block_cache.h"
 #include "cert_verification.h"
 
 #define NEON_NETBLKSIZE     (4096)
+#define NEON_NETBLKSIZE_MAX (32768)
+#define NEON_BUFFER_MAX     (4 * 1024 * 1024)
 #define NEON_ICY_BUFSIZE    (4096)
 #define NEON_RETRY_COUNT 6
+#define NEON_SEEK_SKIP_MAX  (128 * 1024)
+#define NEON_POOL_MAX       8
+#define NEON_POOL_IDLE_TIME (60 * G_USEC_PER_SEC)
+#define NEON_PAUSE_TIME     (G_USEC_PER_SEC)
 
 enum FillBufferResult {
     FILL_BUFFER_SUCCESS,
@@ -89,12 +97,100 @@ struct icy_metadata
     int stream_bitrate = 0;
 };
 
+/* Figures on the health of a stream, for tuning and monitoring.  Protected
+ * by the reader mutex. */
+struct stream_stats
+{
+    int64_t received = 0;       /* Bytes read from the network */
+    int64_t receive_time = 0;   /* Time spent waiting for them, in microseconds */
+    int64_t consumed = 0;       /* Bytes delivered to the player */
+    int64_t first_read = 0;     /* Time of the first delivery */
+    int64_t last_read = 0;      /* Time the player last returned from a read */
+    int64_t paused_time = 0;    /* Time between reads counted as paused */
+    bool reading = false;       /* The player is in a read */
+    int underruns = 0;          /* Times the player had to wait for data */
+    int reconnects = 0;         /* Times the connection was opened again */
+
+    /* Rate at which the network delivers data while we are reading */
+    int64_t receive_rate () const
+        { return receive_time ? received * G_USEC_PER_SEC / receive_time : 0; }
+
+    /* A gap between reads longer than NEON_PAUSE_TIME means playback was
+     * paused (or stopped waiting on something else), not that the player
+     * consumes slowly. */
+    int64_t pause_gap (int64_t now) const
+    {
+        return (! reading && last_read && now - last_read > NEON_PAUSE_TIME) ?
+         now - last_read : 0;
+    }
+
+    void begin_read ()
+    {
+        paused_time += pause_gap (g_get_monotonic_time ());
+        reading = true;
+    }
+
+    void end_read ()
+    {
+        reading = false;
+        last_read = g_get_monotonic_time ();
+    }
+
+    /* Rate at which the player takes data, not counting pauses */
+    int64_t consume_rate () const
+    {
+        if (! first_read)
+            return 0;
+
+        int64_t now = g_get_monotonic_time ();
+        int64_t elapsed = now - first_read - paused_time - pause_gap (now);
+        return (elapsed > 0) ? consumed * G_USEC_PER_SEC / elapsed : 0;
+    }
+};
+
 static const char * const neon_schemes[] = {"http", "https"};
 
+static const char * const neon_defaults[] = {
+    "block_cache", "FALSE",
+    "cache_mb", "32",
+    "prefetch_blocks", "4",
+    "disk_cache", "FALSE",
+    "disk_cache_mb", "256",
+    nullptr
+};
+
+static const PreferencesWidget neon_widgets[] = {
+    WidgetLabel (N_("<b>Block Cache</b>")),
+    WidgetCheck (N_("Cache seekable files in blocks"),
+        WidgetBool ("neon", "block_cache")),
+    WidgetSpin (N_("Memory cache:"),
+        WidgetInt ("neon", "cache_mb"),
+        {1, 1024, 1, N_("MiB")},
+        WIDGET_CHILD),
+    WidgetSpin (N_("Read ahead:"),
+        WidgetInt ("neon", "prefetch_blocks"),
+        {0, 64, 1, N_("blocks of 64 KiB")},
+        WIDGET_CHILD),
+    WidgetCheck (N_("Spill evicted blocks to disk"),
+        WidgetBool ("neon", "disk_cache"),
+        WIDGET_CHILD),
+    WidgetSpin (N_("Disk cache:"),
+        WidgetInt ("neon", "disk_cache_mb"),
+        {1, 4096, 1, N_("MiB")},
+        WIDGET_CHILD)
+};
+
+static const PluginPreferences neon_prefs = {{neon_widgets}};
+
 class NeonTransport : public TransportPlugin
 {
 public:
-    static constexpr PluginInfo info = {N_("Neon HTTP/HTTPS Plugin"), PACKAGE};
+    static constexpr PluginInfo info = {
+        N_("Neon HTTP/HTTPS Plugin"),
+        PACKAGE,
+        nullptr,
+        & neon_prefs
+    };
 
     constexpr NeonTransport () : TransportPlugin (info, neon_schemes) {}
 
@@ -116,11 +212,82 @@ bool NeonTransport::init ()
         return false;
     }
 
+    aud_config_set_defaults ("neon", neon_defaults);
+
     return true;
 }
 
+/* Idle sessions, kept so that later requests to the same host (seeks,
+ * the next track) can reuse the open connection, or at least the TLS
+ * session.  The key covers everything a session is configured with. */
+struct PooledSession
+{
+    String key;
+    ne_session * session;
+    int64_t released;
+};
+
+static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static Index<PooledSession> session_pool;
+
+static ne_session * pool_take (const char * key)
+{
+    ne_session * session = nullptr;
+    int64_t now = g_get_monotonic_time ();
+
+    pthread_mutex_lock (& pool_mutex);
+
+    for (int i = 0; i < session_pool.len ();)
+    {
+        PooledSession & entry = session_pool[i];
+
+        if (now - entry.released > NEON_POOL_IDLE_TIME)
+            ne_session_destroy (entry.session);
+        else if (! session && ! strcmp (entry.key, key))
+            session = entry.session;
+        else
+        {
+            i ++;
+            continue;
+        }
+
+        session_pool.remove (i, 1);
+    }
+
+    pthread_mutex_unlock (& pool_mutex);
+
+    return session;
+}
+
+static void pool_give (const String & key, ne_session * session)
+{
+    pthread_mutex_lock (& pool_mutex);
+
+    if (session_pool.len () >= NEON_POOL_MAX)
+    {
+        ne_session_destroy (session_pool[0].session);
+        session_pool.remove (0, 1);
+    }
+
+    PooledSession & entry = session_pool.append ();
+    entry.key = key;
+    entry.session = session;
+    entry.released = g_get_monotonic_time ();
+
+    pthread_mutex_unlock (& pool_mutex);
+}
+
 void NeonTransport::cleanup ()
 {
+    pthread_mutex_lock (& pool_mutex);
+
+    for (PooledSession & entry : session_pool)
+        ne_session_destroy (entry.session);
+
+    session_pool.clear ();
+    pthread_mutex_unlock (& pool_mutex);
+
+    block_cache_clear ();
     ne_sock_exit ();
 }
 
@@ -167,27 +334,54 @@ private:
     RingBuf<char> m_rb;           /* Ringbuffer for our data */
     Index<char> m_icy_buf;        /* Buffer for ICY metadata */
     icy_metadata m_icy_metadata;  /* Current ICY metadata */
+    stream_stats m_stats;         /* Statistics on the stream */
 
     ne_session * m_session = nullptr;
     ne_request * m_request = nullptr;
+    String m_session_key;         /* Key of m_session in the session pool */
+    bool m_request_done = false;  /* true if the response has been read completely */
+
+    /* Block mode: if the server answers our initial range request, the
+     * file is read in aligned blocks through the block cache, and the
+     * reader thread fetches missing blocks instead of filling m_rb. */
+    String m_cache_key;           /* Block cache key; set in block mode only */
+    String m_validator;           /* ETag or Last-Modified, for If-Range */
+    int64_t m_range_total = -1;   /* Total size from the content-range header */
+    bool m_no_blocks = false;     /* true if the range answer was not usable */
+    Index<char> m_block;          /* Copy of the block being read */
+    int64_t m_block_index = -1;   /* Index of m_block, -1 if none */
+    int64_t m_want_block = -1;    /* Block the main thread is waiting for */
+    Index<char> m_want_data;      /* Data of m_want_block, once fetched */
+    int64_t m_read_block = 0;     /* Block read ahead of, for the reader thread */
+    bool m_seeked = false;        /* The next block is loaded because of a seek */
 
     pthread_t m_reader;
     reader_status m_reader_status;
 
     void kill_reader ();
-    int server_auth (const char * realm, int attempt, char * username, char * password);
+    void count_received (int64_t bytes, int64_t start_time);
+    void count_consumed (int64_t bytes);
+    void count_read (bool begin);
+    void handle_underrun ();
+    void close_handle ();
+    bool skip_buffered (int64_t bytes);
     void handle_headers ();
     int open_request (int64_t startbyte, String * error);
+    bool start_block_mode ();
     FillBufferResult fill_buffer ();
     void reader ();
     int64_t try_fread (void * ptr, int64_t size, int64_t nmemb, bool & data_read);
 
-    static int server_auth_callback (void * data, const char * realm, int attempt,
-     char * username, char * password)
-        { return ((NeonFile *) data)->server_auth (realm, attempt, username, password); }
+    bool fetch_block (int64_t index, Index<char> & data);
+    int64_t next_block ();
+    void block_reader ();
+    bool load_block (int64_t index);
+    int64_t block_fread (char * ptr, int64_t bytes);
 
     static void * reader_thread (void * data)
         { ((NeonFile *) data)->reader (); return nullptr; }
+    static void * block_reader_thread (void * data)
+        { ((NeonFile *) data)->block_reader (); return nullptr; }
 };
 
 NeonFile::NeonFile (const char * url) :
@@ -202,11 +396,7 @@ NeonFile::~NeonFile ()
     if (m_reader_status.reading)
         kill_reader ();
 
-    if (m_request)
-        ne_request_destroy (m_request);
-    if (m_session)
-        ne_session_destroy (m_session);
-
+    close_handle ();
     ne_uri_free (& m_purl);
 }
 
@@ -331,15 +521,93 @@ void NeonFile::kill_reader ()
     AUDDBG ("Reader thread has died\n");
 }
 
-int NeonFile::server_auth (const char * realm, int attempt, char * username, char * password)
+void NeonFile::count_received (int64_t bytes, int64_t start_time)
+{
+    pthread_mutex_lock (& m_reader_status.mutex);
+    m_stats.received += bytes;
+    m_stats.receive_time += g_get_monotonic_time () - start_time;
+    pthread_mutex_unlock (& m_reader_status.mutex);
+}
+
+/* Called with the reader mutex held */
+void NeonFile::count_consumed (int64_t bytes)
+{
+    if (! m_stats.first_read)
+        m_stats.first_read = g_get_monotonic_time ();
+
+    m_stats.consumed += bytes;
+}
+
+void NeonFile::count_read (bool begin)
+{
+    pthread_mutex_lock (& m_reader_status.mutex);
+
+    if (begin)
+        m_stats.begin_read ();
+    else
+        m_stats.end_read ();
+
+    pthread_mutex_unlock (& m_reader_status.mutex);
+}
+
+/* Called with the reader mutex held, when the player finds the buffer
+ * empty.  If the network delivers faster than the player consumes, the
+ * link is merely bursty, and a larger buffer will ride out the gaps.  If
+ * it does not, a larger buffer would only delay the next underrun. */
+void NeonFile::handle_underrun ()
+{
+    m_stats.underruns ++;
+
+    int64_t receive_rate = m_stats.receive_rate ();
+    int64_t consume_rate = m_stats.consume_rate ();
+
+    AUDDBG ("<%p> Buffer underrun: receiving %" PRId64 " B/s, consuming %"
+     PRId64 " B/s\n", this, receive_rate, consume_rate);
+
+    if (m_cache_key || ! consume_rate || receive_rate < consume_rate ||
+     m_rb.size () >= NEON_BUFFER_MAX)
+        return;
+
+    int size = aud::min (m_rb.size () * 2, NEON_BUFFER_MAX);
+    AUDDBG ("<%p> Growing buffer to %d bytes\n", this, size);
+    m_rb.alloc (size);
+}
+
+/* Returns the session to the pool.  Unless the response was read to the
+ * end, the connection is closed first, since it is in an unknown state. */
+void NeonFile::close_handle ()
+{
+    if (m_request)
+    {
+        ne_request_destroy (m_request);
+        m_request = nullptr;
+    }
+
+    if (m_session)
+    {
+        if (! m_request_done)
+            ne_close_connection (m_session);
+
+        pool_give (m_session_key, m_session);
+        m_session = nullptr;
+    }
+
+    m_request_done = false;
+}
+
+/* userdata is the userinfo part of the URL the session was created for */
+static int server_auth_cb (void * userdata, const char * realm, int attempt,
+ char * username, char * password)
 {
-    if (! m_purl.userinfo || ! m_purl.userinfo[0])
+    const char * userinfo = (const char *) userdata;
+
+    if (! userinfo || ! userinfo[0])
     {
         AUDERR ("Authentication required, but no credentials set\n");
         return 1;
     }
 
-    char * * authtok = g_strsplit (m_purl.userinfo, ":", 2);
+    char * * authtok = g_strsplit (userinfo, ":", 2);
 
     if (strlen (authtok[1]) > NE_ABUFSIZ - 1 || strlen (authtok[0]) > NE_ABUFSIZ - 1)
     {
@@ -394,6 +662,32 @@ void NeonFile::handle_headers ()
             else
                 AUDERR ("Invalid content length header: %s\n", value);
         }
+        else if (neon_strcmp (name, "content-range"))
+        {
+            /* The answer to a range request: "bytes first-last/total" */
+            const char * slash = strchr (value, '/');
+            char * endptr;
+            int64_t len = slash ? strtoll (slash + 1, & endptr, 10) : -1;
+
+            if (slash && slash[1] && ! endptr[0] && len > 0)
+            {
+                AUDDBG ("Total length as advertised by server: %" PRId64 "\n", len);
+                m_range_total = len;
+            }
+            else
+                AUDERR ("Invalid content range header: %s\n", value);
+        }
+        else if (neon_strcmp (name, "etag"))
+        {
+            /* Identifies the version of the content, for the block cache */
+            m_validator = String (value);
+        }
+        else if (neon_strcmp (name, "last-modified"))
+        {
+            /* A weaker identification, used if there is no ETag */
+            if (! m_validator)
+                m_validator = String (value);
+        }
         else if (neon_strcmp (name, "content-type"))
         {
             /* The server sent us a content type. Save it for later */
@@ -457,7 +751,14 @@ int NeonFile::open_request (int64_t startbyte, String * error)
     else
         m_request = ne_request_create (m_session, "GET", m_purl.path);
 
-    if (startbyte > 0)
+    /* Ask for the first block only if the block cache is enabled.  Servers
+     * that do not support ranges (internet radio) answer with the whole
+     * stream, which is then read as usual. */
+    bool want_blocks = (! startbyte && ! m_no_blocks && aud_get_bool ("neon", "block_cache"));
+
+    if (want_blocks)
+        ne_add_request_header (m_request, "Range", str_printf ("bytes=0-%d", NEON_BLOCK_SIZE - 1));
+    else if (startbyte > 0)
         ne_add_request_header (m_request, "Range", str_printf ("bytes=%" PRIu64 "-", startbyte));
 
     ne_add_request_header (m_request, "Icy-MetaData", "1");
@@ -507,6 +808,38 @@ int NeonFile::open_request (int64_t startbyte, String * error)
             m_content_start = startbyte;
             m_pos = startbyte;
             handle_headers ();
+
+            /* Without the total size (or with ICY metadata in the way),
+             * the blocks cannot be addressed.  Ask again for the whole
+             * stream and read it as usual. */
+            if (want_blocks && status->code == 206 && (m_range_total < 0 || m_icy_metaint))
+            {
+                AUDDBG ("<%p> Unusable partial response, streaming instead
+", this);
+
+                if (ne_discard_response (m_request) != NE_OK || ne_end_request (m_request) != NE_OK)
+                    ne_close_connection (m_session);
+
+                ne_request_destroy (m_request);
+                m_request = nullptr;
+
+                m_content_length = -1;
+                m_icy_metaint = 0;
+                m_no_blocks = true;
+
+                return open_request (startbyte, error);
+            }
+
+            if (want_blocks && status->code == 206 && ! start_block_mode ())
+            {
+                if (error)
+                    * error = String (_("Invalid partial response"));
+
+                ne_request_destroy (m_request);
+                m_request = nullptr;
+                return -1;
+            }
+
             return 0;
         }
 
@@ -584,6 +917,8 @@ int NeonFile::open_handle (int64_t startbyte, String * error)
 
     AUDDBG ("<%p> Parsing URL\n", this);
 
+    ne_uri_free (& m_purl);
+
     if (ne_uri_parse (m_url, & m_purl) != 0)
     {
         if (error)
@@ -598,46 +933,66 @@ int NeonFile::open_handle (int64_t startbyte, String * error)
         if (! m_purl.port)
             m_purl.port = ne_uri_defaultport (m_purl.scheme);
 
-        AUDDBG ("<%p> Creating session to %s://%s:%d\n", this,
-         m_purl.scheme, m_purl.host, m_purl.port);
-        m_session = ne_session_create (m_purl.scheme,
-         m_purl.host, m_purl.port);
-        ne_redirect_register (m_session);
-        ne_add_server_auth (m_session, NE_AUTH_BASIC, server_auth_callback, this);
-        ne_set_session_flag (m_session, NE_SESSFLAG_ICYPROTO, 1);
-        ne_set_session_flag (m_session, NE_SESSFLAG_PERSIST, 0);
-        ne_set_connect_timeout (m_session, 10);
-        ne_set_read_timeout (m_session, 10);
-        ne_set_useragent (m_session, "Audacious/" PACKAGE_VERSION);
-
-        if (use_proxy)
+        StringBuf key = str_printf ("%s://%s@%s:%d %d:%s:%d:%d:%d:%d:%s:%s",
+         m_purl.scheme, m_purl.userinfo ? m_purl.userinfo : "", m_purl.host,
+         m_purl.port, use_proxy, proxy_host ? (const char *) proxy_host : "", proxy_port,
+         socks_proxy, (int) socks_type, use_proxy_auth,
+         (const char *) proxy_user, (const char *) proxy_pass);
+
+        m_session_key = String (key);
+        m_session = pool_take (key);
+
+        if (m_session)
+            AUDDBG ("<%p> Reusing session to %s://%s:%d\n", this,
+             m_purl.scheme, m_purl.host, m_purl.port);
+        else
         {
-            AUDDBG ("<%p> Using proxy: %s:%d\n", this, (const char *) proxy_host, proxy_port);
-            if (socks_proxy)
+            AUDDBG ("<%p> Creating session to %s://%s:%d\n", this,
+             m_purl.scheme, m_purl.host, m_purl.port);
+            m_session = ne_session_create (m_purl.scheme,
+             m_purl.host, m_purl.port);
+            ne_redirect_register (m_session);
+
+            char * userinfo = g_strdup (m_purl.userinfo);
+            ne_add_server_auth (m_session, NE_AUTH_BASIC, server_auth_cb, userinfo);
+            ne_hook_destroy_session (m_session, g_free, userinfo);
+
+            ne_set_session_flag (m_session, NE_SESSFLAG_ICYPROTO, 1);
+            ne_set_session_flag (m_session, NE_SESSFLAG_PERSIST, 1);
+            ne_set_connect_timeout (m_session, 10);
+            ne_set_read_timeout (m_session, 10);
+            ne_set_useragent (m_session, "Audacious/" PACKAGE_VERSION);
+
+            if (use_proxy)
             {
-                ne_session_socks_proxy (m_session, socks_type, proxy_host, proxy_port, proxy_user, proxy_pass);
-            }
-            else
-            {
-                ne_session_proxy (m_session, proxy_host, proxy_port);
+                AUDDBG ("<%p> Using proxy: %s:%d\n", this, (const char *) proxy_host, proxy_port);
+                if (socks_proxy)
+                {
+                    ne_session_socks_proxy (m_session, socks_type, proxy_host, proxy_port, proxy_user, proxy_pass);
+                }
+                else
+                {
+                    ne_session_proxy (m_session, proxy_host, proxy_port);
+                }
+
+                if (use_proxy_auth)
+                {
+                    AUDDBG ("<%p> Using proxy authentication\n", this);
+                    ne_add_proxy_auth (m_session, NE_AUTH_BASIC,
+                     neon_proxy_auth_cb, nullptr);
+                }
             }
 
-            if (use_proxy_auth)
+            if (! strcmp ("https", m_purl.scheme))
             {
-                AUDDBG ("<%p> Using proxy authentication\n", this);
-                ne_add_proxy_auth (m_session, NE_AUTH_BASIC,
-                 neon_proxy_auth_cb, (void *) this);
+                ne_ssl_trust_default_ca (m_session);
+                ne_ssl_set_verify (m_session,
+                 neon_vfs_verify_environment_ssl_certs, m_session);
             }
         }
 
-        if (! strcmp ("https", m_purl.scheme))
-        {
-            ne_ssl_trust_default_ca (m_session);
-            ne_ssl_set_verify (m_session,
-             neon_vfs_verify_environment_ssl_certs, m_session);
-        }
-
         AUDDBG ("<%p> Creating request\n", this);
+        m_request_done = false;
         ret = open_request (startbyte, error);
 
         if (! ret)
@@ -651,8 +1006,7 @@ int NeonFile::open_handle (int64_t startbyte, String * error)
         }
 
         AUDDBG ("<%p> Following redirect...\n", this);
-        ne_session_destroy (m_session);
-        m_session = nullptr;
+        close_handle ();
     }
 
     /* If we get here, our redirect count exceeded */
@@ -663,20 +1017,86 @@ int NeonFile::open_handle (int64_t startbyte, String * error)
     return 1;
 }
 
+/* Reads the body of a range response into data, which must come to
+ * exactly length bytes. */
+static bool read_range_body (ne_request * request, Index<char> & data, int64_t length)
+{
+    data.resize (length);
+
+    int64_t done = 0;
+
+    while (done < length)
+    {
+        ssize_t bsize = ne_read_response_block (request, data.begin () + done, length - done);
+
+        if (bsize <= 0)
+            break;
+
+        done += bsize;
+    }
+
+    return done == length && ne_discard_response (request) == NE_OK;
+}
+
+/* Called when the server answered our initial range request.  The first
+ * block is read from that response, the rest on demand. */
+bool NeonFile::start_block_mode ()
+{
+    Index<char> data;
+    int64_t length = aud::min ((int64_t) NEON_BLOCK_SIZE, m_range_total);
+
+    if (! read_range_body (m_request, data, length) || ne_end_request (m_request) != NE_OK)
+    {
+        AUDERR ("<%p> Error while reading the first block\n", this);
+        return false;
+    }
+
+    /* The key identifies this version of the file; without a validator,
+     * the size will have to do. */
+    if (m_validator)
+        m_cache_key = String (str_concat ({m_url, " ", m_validator}));
+    else
+        m_cache_key = String (str_printf ("%s %" PRId64, (const char *) m_url, m_range_total));
+
+    AUDDBG ("<%p> Reading in blocks, cache key %s\n", this, (const char *) m_cache_key);
+
+    m_content_length = m_range_total;
+    m_can_ranges = true;
+    m_request_done = true;
+
+    ne_request_destroy (m_request);
+    m_request = nullptr;
+
+    m_block.clear ();
+    m_block.insert (data.begin (), 0, data.len ());
+    m_block_index = 0;
+
+    block_cache_store (m_cache_key, 0, std::move (data));
+    return true;
+}
+
 FillBufferResult NeonFile::fill_buffer ()
 {
-    char buffer[NEON_NETBLKSIZE];
+    char buffer[NEON_NETBLKSIZE_MAX];
     int to_read;
 
+    /* Read as much as fits: neon returns whatever has arrived, so larger
+     * reads only save round trips through the buffer lock. */
     pthread_mutex_lock (& m_reader_status.mutex);
-    to_read = aud::min (m_rb.space (), NEON_NETBLKSIZE);
+    to_read = aud::min (m_rb.space (), NEON_NETBLKSIZE_MAX);
     pthread_mutex_unlock (& m_reader_status.mutex);
 
+    int64_t start_time = g_get_monotonic_time ();
     int bsize = ne_read_response_block (m_request, buffer, to_read);
 
     if (! bsize)
     {
         AUDDBG ("<%p> End of file encountered\n", this);
+
+        /* finishing the request lets the connection be kept alive */
+        if (ne_end_request (m_request) == NE_OK)
+            m_request_done = true;
+
         return FILL_BUFFER_EOF;
     }
 
@@ -694,6 +1114,8 @@ FillBufferResult NeonFile::fill_buffer ()
     m_rb.copy_in (buffer, bsize);
     pthread_mutex_unlock (& m_reader_status.mutex);
 
+    count_received (bsize, start_time);
+
     return FILL_BUFFER_SUCCESS;
 }
 
@@ -745,6 +1167,257 @@ void NeonFile::reader ()
     pthread_mutex_unlock (& m_reader_status.mutex);
 }
 
+/* Fetches one block with a range request on the open session.  If-Range
+ * makes the server send the whole file instead if it has changed since we
+ * opened it, which is treated as an error. */
+bool NeonFile::fetch_block (int64_t index, Index<char> & data)
+{
+    int64_t start = index * NEON_BLOCK_SIZE;
+    int64_t length = aud::min ((int64_t) NEON_BLOCK_SIZE, m_content_length - start);
+
+    ne_request * request;
+
+    if (m_purl.query && * (m_purl.query))
+    {
+        StringBuf tmp = str_concat ({m_purl.path, "?", m_purl.query});
+        request = ne_request_create (m_session, "GET", tmp);
+    }
+    else
+        request = ne_request_create (m_session, "GET", m_purl.path);
+
+    ne_add_request_header (request, "Range", str_printf ("bytes=%" PRId64 "-%"
+     PRId64, start, start + length - 1));
+
+    /* weak ETags are not allowed in If-Range */
+    if (m_validator && strncmp (m_validator, "W/", 2))
+        ne_add_request_header (request, "If-Range", m_validator);
+
+    AUDDBG ("<%p> Fetching block %" PRId64 "\n", this, index);
+
+    int64_t start_time = g_get_monotonic_time ();
+    int ret;
+
+    do
+    {
+        if ((ret = ne_begin_request (request)) != NE_OK)
+            break;
+
+        int code = ne_get_status (request)->code;
+
+        if (code == 206)
+        {
+            if (! read_range_body (request, data, length))
+            {
+                ret = NE_ERROR;
+                break;
+            }
+        }
+        else if (code != 401 && code != 407)
+        {
+            AUDERR ("<%p> Unexpected status %d for block %" PRId64 "\n", this, code, index);
+            ret = NE_ERROR;
+            break;
+        }
+        else if (ne_discard_response (request) != NE_OK)
+        {
+            ret = NE_ERROR;
+            break;
+        }
+
+        /* returns NE_RETRY after an authentication challenge */
+        ret = ne_end_request (request);
+    }
+    while (ret == NE_RETRY);
+
+    ne_request_destroy (request);
+
+    if (ret != NE_OK)
+    {
+        const char * ne_error = ne_get_error (m_session);
+        AUDERR ("<%p> Could not fetch block %" PRId64 ": %s\n", this, index,
+         ne_error ? ne_error : "unknown error");
+
+        /* the connection is in an unknown state */
+        ne_close_connection (m_session);
+        return false;
+    }
+
+    count_received (length, start_time);
+    return true;
+}
+
+/* Picks the block the reader thread should fetch next: the one the main
+ * thread is waiting for, else the first missing one in the read-ahead
+ * window.  Called with the reader mutex held. */
+int64_t NeonFile::next_block ()
+{
+    if (m_want_block >= 0)
+        return m_want_block;
+
+    int64_t blocks = (m_content_length + NEON_BLOCK_SIZE - 1) / NEON_BLOCK_SIZE;
+    int64_t last = aud::min (blocks - 1, m_read_block + aud_get_int ("neon", "prefetch_blocks"));
+
+    for (int64_t index = m_read_block + 1; index <= last; index ++)
+    {
+        if (! block_cache_contains (m_cache_key, index))
+            return index;
+    }
+
+    return -1;
+}
+
+void NeonFile::block_reader ()
+{
+    pthread_mutex_lock (& m_reader_status.mutex);
+
+    while (m_reader_status.reading)
+    {
+        int64_t index = next_block ();
+
+        if (index < 0)
+        {
+            /* Nothing to do until the main thread moves on. */
+            pthread_cond_wait (& m_reader_status.cond, & m_reader_status.mutex);
+            continue;
+        }
+
+        pthread_mutex_unlock (& m_reader_status.mutex);
+
+        Index<char> data, copy;
+        bool success = fetch_block (index, data);
+
+        if (success)
+        {
+            copy.insert (data.begin (), 0, data.len ());
+            block_cache_store (m_cache_key, index, std::move (data));
+        }
+
+        pthread_mutex_lock (& m_reader_status.mutex);
+
+        /* Wake up main thread if it is waiting. */
+        pthread_cond_broadcast (& m_reader_status.cond);
+
+        if (! success)
+        {
+            /* The main thread restarts us when it next needs a block. */
+            AUDERR ("<%p> Error while reading from the network. "
+                    "Terminating reader thread\n", this);
+            m_reader_status.status = NEON_READER_ERROR;
+            pthread_mutex_unlock (& m_reader_status.mutex);
+            return;
+        }
+
+        if (index == m_want_block)
+        {
+            m_want_data = std::move (copy);
+            m_want_block = -1;
+        }
+    }
+
+    AUDDBG ("<%p> Reader thread terminating gracefully\n", this);
+    m_reader_status.status = NEON_READER_TERM;
+    pthread_mutex_unlock (& m_reader_status.mutex);
+}
+
+/* Makes the given block current, from the cache or else through the
+ * reader thread.  Also starts the reader thread for read-ahead. */
+bool NeonFile::load_block (int64_t index)
+{
+    bool cached = (index == m_block_index ||
+     block_cache_lookup (m_cache_key, index, m_block));
+
+    if (cached)
+        m_block_index = index;
+
+    pthread_mutex_lock (& m_reader_status.mutex);
+
+    if (m_reader_status.reading && m_reader_status.status == NEON_READER_ERROR)
+    {
+        pthread_mutex_unlock (& m_reader_status.mutex);
+        kill_reader ();
+        pthread_mutex_lock (& m_reader_status.mutex);
+        m_stats.reconnects ++;
+    }
+
+    m_read_block = index;
+
+    if (! cached)
+    {
+        m_want_block = index;
+        m_want_data.clear ();
+
+        /* waiting for a block after a seek is not a stall */
+        if (! m_seeked)
+            handle_underrun ();
+    }
+
+    m_seeked = false;
+
+    if (! m_reader_status.reading)
+    {
+        AUDDBG ("<%p> Starting reader thread\n", this);
+        m_reader_status.reading = true;
+        m_reader_status.status = NEON_READER_RUN;
+        pthread_create (& m_reader, nullptr, block_reader_thread, this);
+    }
+    else
+        pthread_cond_broadcast (& m_reader_status.cond);
+
+    if (! cached)
+    {
+        while (m_want_block >= 0 && m_reader_status.status == NEON_READER_RUN)
+            pthread_cond_wait (& m_reader_status.cond, & m_reader_status.mutex);
+
+        if (m_want_block < 0)
+        {
+            m_block = std::move (m_want_data);
+            m_block_index = index;
+            cached = true;
+        }
+        else
+            m_want_block = -1;
+    }
+
+    pthread_mutex_unlock (& m_reader_status.mutex);
+
+    return cached;
+}
+
+int64_t NeonFile::block_fread (char * ptr, int64_t bytes)
+{
+    int64_t total = 0;
+
+    while (total < bytes && m_pos < m_content_length)
+    {
+        int64_t index = m_pos / NEON_BLOCK_SIZE;
+
+        if (! load_block (index))
+        {
+            AUDERR ("<%p> Could not read block %" PRId64 "\n", this, index);
+            break;
+        }
+
+        int64_t offset = m_pos - index * NEON_BLOCK_SIZE;
+        int64_t copy = aud::min (bytes - total, m_block.len () - offset);
+
+        if (copy <= 0)
+            break;
+
+        memcpy (ptr + total, m_block.begin () + offset, copy);
+        total += copy;
+        m_pos += copy;
+    }
+
+    if (m_pos >= m_content_length)
+        m_eof = true;
+
+    pthread_mutex_lock (& m_reader_status.mutex);
+    count_consumed (total);
+    pthread_mutex_unlock (& m_reader_status.mutex);
+
+    return total;
+}
+
 VFSImpl * NeonTransport::fopen (const char * path, const char * mode, String & error)
 {
     NeonFile * file = new NeonFile (path);
@@ -781,6 +1454,9 @@ int64_t NeonFile::try_fread (void * ptr, int64_t size, int64_t nmemb, bool & dat
          m_reader_status.status != NEON_READER_RUN)
             break;
 
+        if (! retries)
+            handle_underrun ();
+
         pthread_cond_broadcast (& m_reader_status.cond);
         pthread_cond_wait (& m_reader_status.cond, & m_reader_status.mutex);
     }
@@ -928,6 +1604,7 @@ int64_t NeonFile::try_fread (void * ptr, int64_t size, int64_t nmemb, bool & dat
 
     nmemb = aud::min (belem, nmemb);
     m_rb.move_out ((char *) ptr, nmemb * size);
+    count_consumed (nmemb * size);
 
     /* Signal the network thread to continue reading */
     if (m_reader_status.status == NEON_READER_EOF)
@@ -957,6 +1634,21 @@ int64_t NeonFile::fread (void * buffer, int64_t size, int64_t count)
 
     AUDDBG ("<%p> fread %d x %d\n", this, (int) size, (int) count);
 
+    if (m_cache_key)
+    {
+        if (! size || ! count || m_eof)
+            return 0;
+
+        count_read (true);
+        total = block_fread ((char *) buffer, size * count) / size;
+        count_read (false);
+
+        AUDDBG ("<%p> fread = %d\n", this, (int) total);
+        return total;
+    }
+
+    count_read (true);
+
     while (count > 0)
     {
         bool data_read = false;
@@ -969,6 +1661,8 @@ int64_t NeonFile::fread (void * buffer, int64_t size, int64_t count)
         count -= part;
     }
 
+    count_read (false);
+
     AUDDBG ("<%p> fread = %d\n", this, (int) total);
 
     return total;
@@ -1067,30 +1761,58 @@ int NeonFile::fseek (int64_t offset, VFSSeekType whence)
     if (newpos == m_pos)
         return 0;
 
+    /* In block mode, the next read fetches whatever blocks it needs. */
+    if (m_cache_key)
+    {
+        m_pos = newpos;
+        m_eof = false;
+        m_seeked = true;
+        return 0;
+    }
+
+    /* Short forward seeks (a decoder skipping over a header, say) are
+     * served from the buffer or by reading on, without reconnecting.
+     * ICY streams never get here since they cannot be seeked. */
+    if (newpos > m_pos && ! m_icy_metaint)
+    {
+        if (skip_buffered (newpos - m_pos))
+            return 0;
+
+        if (newpos - m_pos <= NEON_SEEK_SKIP_MAX)
+        {
+            char buffer[NEON_NETBLKSIZE];
+
+            while (m_pos < newpos)
+            {
+                if (fread (buffer, 1, aud::min (newpos - m_pos, (int64_t) sizeof buffer)) <= 0)
+                    break;
+            }
+
+            if (m_pos == newpos)
+                return 0;
+
+            AUDDBG ("<%p> Could not read up to the seek position, reconnecting\n", this);
+        }
+    }
+
     /* To seek to the new position we have to
      * - stop the current reader thread, if there is one
-     * - destroy the current request
+     * - end the current request, returning the session to the pool
      * - dump all data currently in the ringbuffer
      * - create a new request starting at newpos */
     if (m_reader_status.reading)
         kill_reader ();
 
-    if (m_request)
-    {
-        ne_request_destroy (m_request);
-        m_request = nullptr;
-    }
-
-    if (m_session)
-    {
-        ne_session_destroy (m_session);
-        m_session = nullptr;
-    }
+    close_handle ();
 
     m_rb.discard ();
     m_icy_buf.clear ();
     m_icy_len = 0;
 
+    pthread_mutex_lock (& m_reader_status.mutex);
+    m_stats.reconnects ++;
+    pthread_mutex_unlock (& m_reader_status.mutex);
+
     if (open_handle (newpos) != 0)
     {
         AUDERR ("<%p> Error while creating new request!\n", this);
@@ -1104,6 +1826,28 @@ int NeonFile::fseek (int64_t offset, VFSSeekType whence)
     return 0;
 }
 
+bool NeonFile::skip_buffered (int64_t bytes)
+{
+    pthread_mutex_lock (& m_reader_status.mutex);
+
+    if (bytes > m_rb.len ())
+    {
+        pthread_mutex_unlock (& m_reader_status.mutex);
+        return false;
+    }
+
+    AUDDBG ("<%p> Seeking %" PRId64 " bytes ahead within the buffer\n", this, bytes);
+
+    m_rb.discard (bytes);
+
+    /* Signal the network thread to continue reading */
+    pthread_cond_broadcast (& m_reader_status.cond);
+    pthread_mutex_unlock (& m_reader_status.mutex);
+
+    m_pos += bytes;
+    return true;
+}
+
 String NeonFile::get_metadata (const char * field)
 {
     AUDDBG ("<%p> Field name: %s\n", this, field);
@@ -1120,6 +1864,32 @@ String NeonFile::get_metadata (const char * field)
     if (! strcmp (field, "content-bitrate"))
         return String (int_to_str (m_icy_metadata.stream_bitrate * 1000));
 
+    /* Stream health, for tuning and monitoring */
+    if (! strncmp (field, "stream-", 7))
+    {
+        int64_t value = -1;
+
+        pthread_mutex_lock (& m_reader_status.mutex);
+
+        if (! strcmp (field, "stream-buffer-fill"))
+            value = m_cache_key ? 0 : m_rb.len ();
+        else if (! strcmp (field, "stream-buffer-size"))
+            value = m_cache_key ? 0 : m_rb.size ();
+        else if (! strcmp (field, "stream-underruns"))
+            value = m_stats.underruns;
+        else if (! strcmp (field, "stream-reconnects"))
+            value = m_stats.reconnects;
+        else if (! strcmp (field, "stream-receive-rate"))
+            value = m_stats.receive_rate ();
+        else if (! strcmp (field, "stream-consume-rate"))
+            value = m_stats.consume_rate ();
+
+        pthread_mutex_unlock (& m_reader_status.mutex);
+
+        if (value >= 0)
+            return String (str_printf ("%" PRId64, value));
+    }
+
     return String ();
 }
 
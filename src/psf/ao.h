@@ -8,6 +8,7 @@
 #define __AO_H
 
 #include <stdint.h>
+#include <string.h>
 
 #define WANT_AUD_BSWAP
 #include <libaudcore/audio.h>
@@ -35,4 +36,22 @@ enum
 
 Index<char> ao_get_lib(char *filename);
 
+// State snapshots: each emulation module appends its variables to a byte
+// buffer and later reads them back in the same order.  Pointers are stored
+// as-is, so a snapshot is only valid within the playback session that
+// created it.
+static inline void ao_state_save(Index<char> &state, const void *data, int len)
+{
+	state.insert((const char *)data, -1, len);
+}
+
+static inline void ao_state_load(const char *&state, void *data, int len)
+{
+	memcpy(data, state, len);
+	state += len;
+}
+
+#define AO_STATE_SAVE(state, var)	ao_state_save(state, &(var), sizeof(var))
+#define AO_STATE_LOAD(state, var)	ao_state_load(state, &(var), sizeof(var))
+
 #endif // AO_H
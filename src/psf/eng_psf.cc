@@ -335,6 +335,8 @@ int32_t psf_execute(void (*update)(const void *, int))
 	int i;
 
 	while (!stop_flag) {
+		psf_checkpoint();
+
 		for (i = 0; i < 44100 / 60; i++) {
 			psx_hw_slice();
 			SPUasync(384, update);
@@ -346,6 +348,20 @@ int32_t psf_execute(void (*update)(const void *, int))
 	return AO_SUCCESS;
 }
 
+void psf_save_state(Index<char> &state)
+{
+	mips_save_state(state);
+	psx_hw_save_state(state);
+	SPUsave_state(state);
+}
+
+void psf_load_state(const char *&state)
+{
+	mips_load_state(state);
+	psx_hw_load_state(state);
+	SPUload_state(state);
+}
+
 int32_t psf_stop(void)
 {
 	SPUclose();
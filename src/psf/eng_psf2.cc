@@ -567,6 +567,8 @@ int32_t psf2_execute(void (*update)(const void *, int))
 
 	while (!stop_flag)
 	{
+		psf_checkpoint();
+
 		for (i = 0; i < 44100 / 60; i++)
 		{
 			SPU2async(update);
@@ -579,6 +581,20 @@ int32_t psf2_execute(void (*update)(const void *, int))
 	return AO_SUCCESS;
 }
 
+void psf2_save_state(Index<char> &state)
+{
+	mips_save_state(state);
+	psx_hw_save_state(state);
+	SPU2save_state(state);
+}
+
+void psf2_load_state(const char *&state)
+{
+	mips_load_state(state);
+	psx_hw_load_state(state);
+	SPU2load_state(state);
+}
+
 int32_t psf2_stop(void)
 {
 	SPU2close();
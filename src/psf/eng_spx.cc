@@ -215,6 +215,8 @@ int32_t spx_execute(void (*update)(const void *, int))
 
 		if (run)
 		{
+			psf_checkpoint();
+
 			for (i = 0; i < 44100 / 60; i++)
 			{
 			  	spx_tick();
@@ -226,6 +228,24 @@ int32_t spx_execute(void (*update)(const void *, int))
 	return AO_SUCCESS;
 }
 
+void spx_save_state(Index<char> &state)
+{
+	AO_STATE_SAVE(state, song_ptr);
+	AO_STATE_SAVE(state, cur_tick);
+	AO_STATE_SAVE(state, cur_event);
+	AO_STATE_SAVE(state, next_tick);
+	SPUsave_state(state);
+}
+
+void spx_load_state(const char *&state)
+{
+	AO_STATE_LOAD(state, song_ptr);
+	AO_STATE_LOAD(state, cur_tick);
+	AO_STATE_LOAD(state, cur_event);
+	AO_STATE_LOAD(state, next_tick);
+	SPUload_state(state);
+}
+
 int32_t spx_stop(void)
 {
 	SPUclose();
@@ -79,6 +79,8 @@
 
 #define _IN_SPU
 
+#include "../ao.h"
+
 #include "../peops/stdafx.h"
 #include "../peops/externals.h"
 #include "../peops/registers.h"
@@ -194,6 +196,11 @@ int psf_seek(u32 t)
  return(0);
 }
 
+u32 psf_tell(void)
+{
+ return (u64)sampcount*10/441;
+}
+
 static int endless;
 void setendless(int e)
 {
@@ -675,3 +682,50 @@ void SPUinjectRAMImage(u16 *pIncoming)
 		spuMem[i] = pIncoming[i];
 	}
 }
+
+////////////////////////////////////////////////////////////////////////
+// STATE SNAPSHOTS: the mixing buffer is not part of the state, so any
+// partially filled output block is dropped on restore
+////////////////////////////////////////////////////////////////////////
+
+void SPUsave_state(Index<char> &state)
+{
+ AO_STATE_SAVE(state, regArea);
+ AO_STATE_SAVE(state, spuMem);
+ AO_STATE_SAVE(state, pSpuIrq);
+ AO_STATE_SAVE(state, s_chan);
+ AO_STATE_SAVE(state, rvb);
+ AO_STATE_SAVE(state, dwNoiseVal);
+ AO_STATE_SAVE(state, spuCtrl);
+ AO_STATE_SAVE(state, spuStat);
+ AO_STATE_SAVE(state, spuIrq);
+ AO_STATE_SAVE(state, spuAddr);
+ AO_STATE_SAVE(state, ttemp);
+ AO_STATE_SAVE(state, sampcount);
+ AO_STATE_SAVE(state, downbuf);
+ AO_STATE_SAVE(state, upbuf);
+ AO_STATE_SAVE(state, dbpos);
+ AO_STATE_SAVE(state, ubpos);
+}
+
+void SPUload_state(const char *&state)
+{
+ AO_STATE_LOAD(state, regArea);
+ AO_STATE_LOAD(state, spuMem);
+ AO_STATE_LOAD(state, pSpuIrq);
+ AO_STATE_LOAD(state, s_chan);
+ AO_STATE_LOAD(state, rvb);
+ AO_STATE_LOAD(state, dwNoiseVal);
+ AO_STATE_LOAD(state, spuCtrl);
+ AO_STATE_LOAD(state, spuStat);
+ AO_STATE_LOAD(state, spuIrq);
+ AO_STATE_LOAD(state, spuAddr);
+ AO_STATE_LOAD(state, ttemp);
+ AO_STATE_LOAD(state, sampcount);
+ AO_STATE_LOAD(state, downbuf);
+ AO_STATE_LOAD(state, upbuf);
+ AO_STATE_LOAD(state, dbpos);
+ AO_STATE_LOAD(state, ubpos);
+
+ pS=(s16 *)pSpuBuffer;
+}
@@ -27,6 +27,7 @@
 void SPUirq(void);
 
 int psf_seek(uint32_t t);
+uint32_t psf_tell(void);
 void setendless(int e);
 void setlength(int32_t stop, int32_t fade);
 
@@ -40,3 +41,6 @@ void SPUinjectRAMImage(uint16_t *pIncoming);
 void SPUreadDMAMem(uint32_t usPSXMem, int iSize);
 void SPUwriteDMAMem(uint32_t usPSXMem, int iSize);
 uint16_t SPUreadRegister(uint32_t reg);
+
+void SPUsave_state(Index<char> &state);
+void SPUload_state(const char *&state);
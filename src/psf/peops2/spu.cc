@@ -99,6 +99,8 @@
 
 #define _IN_SPU
 
+#include "../ao.h"
+
 #include "../peops2/externals.h"
 #include "../peops2/regs.h"
 #include "../peops2/dma.h"
@@ -337,6 +339,11 @@ int psf2_seek(u32 t)
  return(0);
 }
 
+u32 psf2_tell(void)
+{
+ return (u64)sampcount*10/441;
+}
+
 static int endless;
 void setendless2(int e)
 {
@@ -1000,6 +1007,65 @@ EXPORT_GCC void CALLBACK SPU2close(void)
  RemoveStreams();                                      // no more streaming
 }
 
+////////////////////////////////////////////////////////////////////////
+// STATE SNAPSHOTS: the mixing buffer is not part of the state, so any
+// partially filled output block is dropped on restore
+////////////////////////////////////////////////////////////////////////
+
+void SPU2save_state(Index<char> &state)
+{
+ AO_STATE_SAVE(state, regArea);
+ AO_STATE_SAVE(state, spuMem);
+ AO_STATE_SAVE(state, pSpuIrq);
+ AO_STATE_SAVE(state, s_chan);
+ AO_STATE_SAVE(state, rvb);
+ AO_STATE_SAVE(state, dwNoiseVal);
+ AO_STATE_SAVE(state, spuCtrl2);
+ AO_STATE_SAVE(state, spuStat2);
+ AO_STATE_SAVE(state, spuIrq2);
+ AO_STATE_SAVE(state, spuAddr2);
+ AO_STATE_SAVE(state, spuRvbAddr2);
+ AO_STATE_SAVE(state, spuRvbAEnd2);
+ AO_STATE_SAVE(state, dwNewChannel2);
+ AO_STATE_SAVE(state, dwEndChannel2);
+ AO_STATE_SAVE(state, SSumR);
+ AO_STATE_SAVE(state, SSumL);
+ AO_STATE_SAVE(state, iCycle);
+ AO_STATE_SAVE(state, iSPUIRQWait);
+ AO_STATE_SAVE(state, iSpuAsyncWait);
+ AO_STATE_SAVE(state, lastch);
+ AO_STATE_SAVE(state, iSecureStart);
+ AO_STATE_SAVE(state, sampcount);
+}
+
+void SPU2load_state(const char *&state)
+{
+ AO_STATE_LOAD(state, regArea);
+ AO_STATE_LOAD(state, spuMem);
+ AO_STATE_LOAD(state, pSpuIrq);
+ AO_STATE_LOAD(state, s_chan);
+ AO_STATE_LOAD(state, rvb);
+ AO_STATE_LOAD(state, dwNoiseVal);
+ AO_STATE_LOAD(state, spuCtrl2);
+ AO_STATE_LOAD(state, spuStat2);
+ AO_STATE_LOAD(state, spuIrq2);
+ AO_STATE_LOAD(state, spuAddr2);
+ AO_STATE_LOAD(state, spuRvbAddr2);
+ AO_STATE_LOAD(state, spuRvbAEnd2);
+ AO_STATE_LOAD(state, dwNewChannel2);
+ AO_STATE_LOAD(state, dwEndChannel2);
+ AO_STATE_LOAD(state, SSumR);
+ AO_STATE_LOAD(state, SSumL);
+ AO_STATE_LOAD(state, iCycle);
+ AO_STATE_LOAD(state, iSPUIRQWait);
+ AO_STATE_LOAD(state, iSpuAsyncWait);
+ AO_STATE_LOAD(state, lastch);
+ AO_STATE_LOAD(state, iSecureStart);
+ AO_STATE_LOAD(state, sampcount);
+
+ pS=(short *)pSpuBuffer;
+}
+
 #if 0
 ////////////////////////////////////////////////////////////////////////
 // SPUSHUTDOWN: called by main emu on final exit
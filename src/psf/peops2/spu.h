@@ -36,3 +36,7 @@ void SPU2async(void (*update)(const void *, int));
 void SPU2close(void);
 
 int psf2_seek(uint32_t t);
+uint32_t psf2_tell(void);
+
+void SPU2save_state(Index<char> &state);
+void SPU2load_state(const char *&state);
@@ -27,6 +27,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <zlib.h>
 
 #include <libaudcore/i18n.h>
 #include <libaudcore/plugin.h>
@@ -85,18 +86,22 @@ typedef struct {
     int32_t (*stop)(void);
     int32_t (*seek)(uint32_t);
     int32_t (*execute)(void (*update)(const void *, int));
+    uint32_t (*tell)(void);
+    void (*save_state)(Index<char> &state);
+    void (*load_state)(const char *&state);
 } PSFEngineFunctors;
 
 static PSFEngineFunctors psf_functor_map[ENG_COUNT] = {
-    {nullptr, nullptr, nullptr, nullptr},
-    {psf_start, psf_stop, psf_seek, psf_execute},
-    {psf2_start, psf2_stop, psf2_seek, psf2_execute},
-    {spx_start, spx_stop, psf_seek, spx_execute},
+    {nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr},
+    {psf_start, psf_stop, psf_seek, psf_execute, psf_tell, psf_save_state, psf_load_state},
+    {psf2_start, psf2_stop, psf2_seek, psf2_execute, psf2_tell, psf2_save_state, psf2_load_state},
+    {spx_start, spx_stop, psf_seek, spx_execute, psf_tell, spx_save_state, spx_load_state},
 };
 
 const char* const PSFPlugin::defaults[] =
 {
     "ignore_length", "FALSE",
+    "snapshot_interval", "10",
     nullptr
 };
 
@@ -116,6 +121,23 @@ bool stop_flag = false;
  * to seek backward. */
 static int reverse_seek;
 
+/* To avoid restarting, the emulator state is saved every few seconds of
+ * playback.  A seek then restores the nearest earlier snapshot and emulates
+ * only the remainder.  Snapshots contain raw pointers and are discarded
+ * whenever the engine is restarted. */
+struct Snapshot {
+    int time;          /* milliseconds */
+    int size;          /* uncompressed size */
+    Index<char> data;  /* zlib-compressed state */
+};
+
+static Index<Snapshot> snapshots;
+static int snapshot_interval; /* milliseconds, 0 = disabled */
+
+/* Set from the audio callback and handled in psf_checkpoint(), since the
+ * state can only be swapped between emulated frames. */
+static int restore_snapshot, restore_time;
+
 static PSFEngine psf_probe(const char *buf, int len)
 {
     if (len < 4)
@@ -143,6 +165,79 @@ Index<char> ao_get_lib(char *filename)
     return file ? file.read_all() : Index<char>();
 }
 
+static void save_snapshot(int time)
+{
+    Index<char> state;
+    f->save_state(state);
+
+    uLongf len = compressBound(state.len());
+    Index<char> data;
+    data.resize(len);
+
+    /* PSX RAM is mostly idle, so fast compression pays off well here */
+    if (compress2((Bytef *)data.begin(), &len, (const Bytef *)state.begin(),
+     state.len(), 1) != Z_OK)
+        return;
+
+    data.remove(len, -1);
+
+    Snapshot &snap = snapshots.append();
+    snap.time = time;
+    snap.size = state.len();
+    snap.data = std::move(data);
+}
+
+static bool load_snapshot(const Snapshot &snap)
+{
+    Index<char> state;
+    state.resize(snap.size);
+
+    uLongf len = snap.size;
+    if (uncompress((Bytef *)state.begin(), &len, (const Bytef *)snap.data.begin(),
+     snap.data.len()) != Z_OK || len != (uLongf)snap.size)
+        return false;
+
+    const char *pos = state.begin();
+    f->load_state(pos);
+    return true;
+}
+
+/* returns the latest snapshot at or before <time>, or -1 */
+static int find_snapshot(int time)
+{
+    int found = -1;
+
+    for (int i = 0; i < snapshots.len() && snapshots[i].time <= time; i++)
+        found = i;
+
+    return found;
+}
+
+/* called by the engines at the start of each emulated frame */
+void psf_checkpoint(void)
+{
+    if (restore_snapshot >= 0)
+    {
+        if (load_snapshot(snapshots[restore_snapshot]))
+            f->seek(restore_time);
+        else
+        {
+            reverse_seek = restore_time;
+            stop_flag = true;
+        }
+
+        restore_snapshot = -1;
+        return;
+    }
+
+    if (!snapshot_interval)
+        return;
+
+    int time = f->tell();
+    if (!snapshots.len() || time >= snapshots[snapshots.len() - 1].time + snapshot_interval)
+        save_snapshot(time);
+}
+
 bool PSFPlugin::read_tag(const char *filename, VFSFile &file, Tuple &tuple, Index<char> *image)
 {
     Index<char> buf = file.read_all ();
@@ -199,11 +294,15 @@ bool PSFPlugin::play(const char *filename, VFSFile &file)
     open_audio(FMT_S16_NE, 44100, 2);
 
     reverse_seek = -1;
+    restore_snapshot = -1;
+    snapshot_interval = aud::max(aud_get_int("psf", "snapshot_interval"), 0) * 1000;
 
     /* This loop will restart playback from the beginning when necessary to seek
      * backwards in the file (reverse_seek >= 0). */
     do
     {
+        snapshots.clear();
+
         if (f->start((uint8_t *)buf.begin(), buf.len()) != AO_SUCCESS)
         {
             error = true;
@@ -224,6 +323,7 @@ bool PSFPlugin::play(const char *filename, VFSFile &file)
     while (reverse_seek >= 0);
 
 cleanup:
+    snapshots.clear();
     f = nullptr;
     dirpath = String ();
 
@@ -242,7 +342,17 @@ void PSFPlugin::update(const void *data, int bytes)
 
     if (seek >= 0)
     {
-        if (!f->seek(seek))
+        bool forward = f->seek(seek);
+        int snap = find_snapshot(seek);
+
+        /* restore a snapshot when seeking back, or when one lies between
+         * the current position and the target */
+        if (snap >= 0 && (!forward || snapshots[snap].time > (int)f->tell()))
+        {
+            restore_snapshot = snap;
+            restore_time = seek;
+        }
+        else if (!forward)
         {
             reverse_seek = seek;
             stop_flag = true;
@@ -251,6 +361,10 @@ void PSFPlugin::update(const void *data, int bytes)
         return;
     }
 
+    /* drop audio emulated after a seek but before the state is restored */
+    if (restore_snapshot >= 0)
+        return;
+
     write_audio(data, bytes);
 }
 
@@ -268,6 +382,8 @@ const char *const PSFPlugin::exts[] = { "psf", "minipsf", "psf2", "minipsf2", "s
 const PreferencesWidget PSFPlugin::widgets[] = {
     WidgetLabel(N_("<b>OpenPSF Configuration</b>")),
     WidgetCheck(N_("Ignore length from file"), WidgetBool("psf", "ignore_length")),
+    WidgetSpin(N_("Seek snapshot interval:"), WidgetInt("psf", "snapshot_interval"),
+        {0, 60, 1, N_("seconds (0 = disabled)")}),
 };
 
 const PluginPreferences PSFPlugin::prefs = {{widgets}};
@@ -1661,6 +1661,19 @@ static void mips_set_context( void *src )
 	}
 }
 
+void mips_save_state( Index<char> &state )
+{
+	AO_STATE_SAVE( state, mipscpu );
+	AO_STATE_SAVE( state, mips_ICount );
+}
+
+void mips_load_state( const char *&state )
+{
+	AO_STATE_LOAD( state, mipscpu );
+	AO_STATE_LOAD( state, mips_ICount );
+	change_pc( mipscpu.pc );
+}
+
 static void set_irq_line( int irqline, int state )
 {
 	uint32_t ip;
@@ -291,6 +291,8 @@ extern int psf_refresh;
 int32_t psf_start(uint8_t *buffer, uint32_t length);
 int32_t psf_execute(void (*update)(const void *, int));
 int32_t psf_stop(void);
+void psf_save_state(Index<char> &state);
+void psf_load_state(const char *&state);
 
 /* eng_psf2.cc */
 uint32_t psf2_load_elf(uint8_t *start, uint32_t len);
@@ -298,6 +300,8 @@ uint32_t psf2_load_file(const char *file, uint8_t *buf, uint32_t buflen);
 int32_t psf2_start(uint8_t *, uint32_t length);
 int32_t psf2_execute(void (*update)(const void *, int));
 int32_t psf2_stop(void);
+void psf2_save_state(Index<char> &state);
+void psf2_load_state(const char *&state);
 int32_t psf2_command(int32_t, int32_t);
 uint32_t psf2_get_loadaddr(void);
 void psf2_set_loadaddr(uint32_t addr);
@@ -306,10 +310,14 @@ void psf2_set_loadaddr(uint32_t addr);
 int32_t spx_start(uint8_t *buffer, uint32_t length);
 int32_t spx_execute(void (*update)(const void *, int));
 int32_t spx_stop(void);
+void spx_save_state(Index<char> &state);
+void spx_load_state(const char *&state);
 
 /* plugin.cc */
 extern bool stop_flag;
 
+void psf_checkpoint(void);
+
 /* psx.cc */
 void mips_init(void);
 void mips_reset(void *param);
@@ -323,6 +331,8 @@ void mips_set_status(uint32_t status);
 uint32_t mips_get_ePC(void);
 int mips_get_icount(void);
 void mips_set_icount(int count);
+void mips_save_state(Index<char> &state);
+void mips_load_state(const char *&state);
 
 /* psx_hw.cc */
 extern uint32_t psx_ram[((2*1024*1024)/4)+4];
@@ -349,4 +359,7 @@ void program_write_dword_32le(offs_t address, uint32_t data);
 
 void psx_iop_call(uint32_t pc, uint32_t callnum);
 
+void psx_hw_save_state(Index<char> &state);
+void psx_hw_load_state(const char *&state);
+
 #endif
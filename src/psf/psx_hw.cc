@@ -3512,3 +3512,133 @@ void psx_iop_call(uint32_t pc, uint32_t callnum)
 	}
 }
 
+
+// state snapshots
+
+void psx_hw_save_state(Index<char> &state)
+{
+	int softcall = softcall_target;
+
+	AO_STATE_SAVE(state, psx_ram);
+	AO_STATE_SAVE(state, psx_scratch);
+
+	AO_STATE_SAVE(state, softcall);
+	AO_STATE_SAVE(state, filestat);
+	AO_STATE_SAVE(state, filedata);
+	AO_STATE_SAVE(state, filesize);
+	AO_STATE_SAVE(state, filepos);
+	AO_STATE_SAVE(state, intr_susp);
+	AO_STATE_SAVE(state, sys_time);
+	AO_STATE_SAVE(state, timerexp);
+
+	AO_STATE_SAVE(state, iNumLibs);
+	AO_STATE_SAVE(state, reglibs);
+	AO_STATE_SAVE(state, iNumFlags);
+	AO_STATE_SAVE(state, evflags);
+	AO_STATE_SAVE(state, iNumSema);
+	AO_STATE_SAVE(state, semaphores);
+	AO_STATE_SAVE(state, iNumThreads);
+	AO_STATE_SAVE(state, iCurThread);
+	AO_STATE_SAVE(state, threads);
+	AO_STATE_SAVE(state, iop_timers);
+	AO_STATE_SAVE(state, iNumTimers);
+	AO_STATE_SAVE(state, root_cnts);
+	AO_STATE_SAVE(state, Event);
+	AO_STATE_SAVE(state, CounterEvent);
+
+	AO_STATE_SAVE(state, spu_delay);
+	AO_STATE_SAVE(state, dma_icr);
+	AO_STATE_SAVE(state, irq_data);
+	AO_STATE_SAVE(state, irq_mask);
+	AO_STATE_SAVE(state, dma_timer);
+	AO_STATE_SAVE(state, WAI);
+	AO_STATE_SAVE(state, dma4_madr);
+	AO_STATE_SAVE(state, dma4_bcr);
+	AO_STATE_SAVE(state, dma4_chcr);
+	AO_STATE_SAVE(state, dma4_delay);
+	AO_STATE_SAVE(state, dma7_madr);
+	AO_STATE_SAVE(state, dma7_bcr);
+	AO_STATE_SAVE(state, dma7_chcr);
+	AO_STATE_SAVE(state, dma7_delay);
+	AO_STATE_SAVE(state, dma4_cb);
+	AO_STATE_SAVE(state, dma7_cb);
+	AO_STATE_SAVE(state, dma4_fval);
+	AO_STATE_SAVE(state, dma4_flag);
+	AO_STATE_SAVE(state, dma7_fval);
+	AO_STATE_SAVE(state, dma7_flag);
+	AO_STATE_SAVE(state, irq9_cb);
+	AO_STATE_SAVE(state, irq9_fval);
+	AO_STATE_SAVE(state, irq9_flag);
+
+	AO_STATE_SAVE(state, gpu_stat);
+	AO_STATE_SAVE(state, fcnt);
+	AO_STATE_SAVE(state, heap_addr);
+	AO_STATE_SAVE(state, entry_int);
+	AO_STATE_SAVE(state, irq_regs);
+	AO_STATE_SAVE(state, irq_mutex);
+}
+
+void psx_hw_load_state(const char *&state)
+{
+	int softcall;
+
+	AO_STATE_LOAD(state, psx_ram);
+	AO_STATE_LOAD(state, psx_scratch);
+
+	AO_STATE_LOAD(state, softcall);
+	AO_STATE_LOAD(state, filestat);
+	AO_STATE_LOAD(state, filedata);
+	AO_STATE_LOAD(state, filesize);
+	AO_STATE_LOAD(state, filepos);
+	AO_STATE_LOAD(state, intr_susp);
+	AO_STATE_LOAD(state, sys_time);
+	AO_STATE_LOAD(state, timerexp);
+
+	AO_STATE_LOAD(state, iNumLibs);
+	AO_STATE_LOAD(state, reglibs);
+	AO_STATE_LOAD(state, iNumFlags);
+	AO_STATE_LOAD(state, evflags);
+	AO_STATE_LOAD(state, iNumSema);
+	AO_STATE_LOAD(state, semaphores);
+	AO_STATE_LOAD(state, iNumThreads);
+	AO_STATE_LOAD(state, iCurThread);
+	AO_STATE_LOAD(state, threads);
+	AO_STATE_LOAD(state, iop_timers);
+	AO_STATE_LOAD(state, iNumTimers);
+	AO_STATE_LOAD(state, root_cnts);
+	AO_STATE_LOAD(state, Event);
+	AO_STATE_LOAD(state, CounterEvent);
+
+	AO_STATE_LOAD(state, spu_delay);
+	AO_STATE_LOAD(state, dma_icr);
+	AO_STATE_LOAD(state, irq_data);
+	AO_STATE_LOAD(state, irq_mask);
+	AO_STATE_LOAD(state, dma_timer);
+	AO_STATE_LOAD(state, WAI);
+	AO_STATE_LOAD(state, dma4_madr);
+	AO_STATE_LOAD(state, dma4_bcr);
+	AO_STATE_LOAD(state, dma4_chcr);
+	AO_STATE_LOAD(state, dma4_delay);
+	AO_STATE_LOAD(state, dma7_madr);
+	AO_STATE_LOAD(state, dma7_bcr);
+	AO_STATE_LOAD(state, dma7_chcr);
+	AO_STATE_LOAD(state, dma7_delay);
+	AO_STATE_LOAD(state, dma4_cb);
+	AO_STATE_LOAD(state, dma7_cb);
+	AO_STATE_LOAD(state, dma4_fval);
+	AO_STATE_LOAD(state, dma4_flag);
+	AO_STATE_LOAD(state, dma7_fval);
+	AO_STATE_LOAD(state, dma7_flag);
+	AO_STATE_LOAD(state, irq9_cb);
+	AO_STATE_LOAD(state, irq9_fval);
+	AO_STATE_LOAD(state, irq9_flag);
+
+	AO_STATE_LOAD(state, gpu_stat);
+	AO_STATE_LOAD(state, fcnt);
+	AO_STATE_LOAD(state, heap_addr);
+	AO_STATE_LOAD(state, entry_int);
+	AO_STATE_LOAD(state, irq_regs);
+	AO_STATE_LOAD(state, irq_mutex);
+
+	softcall_target = softcall;
+}
@@ -89,6 +89,44 @@ private:
 
 GLSpectrumWidget * s_widget = nullptr;
 
+/* Each bar is drawn as four quads (top, left, right, front).  The x and z
+ * coordinates of the corners never change, so only the heights and colors
+ * are filled in for each frame, and all bars are drawn in a single call. */
+#define BAR_VERTICES 16
+
+/* corners of a bar as {right, top, back} */
+static const unsigned char bar_shape[BAR_VERTICES][3] = {
+    {0, 1, 0}, {1, 1, 0}, {1, 1, 1}, {0, 1, 1},  /* top */
+    {0, 0, 0}, {0, 1, 0}, {0, 1, 1}, {0, 0, 1},  /* left */
+    {1, 1, 0}, {1, 0, 0}, {1, 0, 1}, {1, 1, 1},  /* right */
+    {0, 0, 0}, {1, 0, 0}, {1, 1, 0}, {0, 1, 0}   /* front */
+};
+
+static const float bar_shade[BAR_VERTICES / 4] = {1, 0.65f, 0.65f, 0.8f};
+
+static float s_vertices[NUM_BANDS][NUM_BANDS][BAR_VERTICES][3];
+static float s_vertex_colors[NUM_BANDS][NUM_BANDS][BAR_VERTICES][3];
+
+static void init_bars ()
+{
+    for (int i = 0; i < NUM_BANDS; i ++)
+    {
+        float z = -1.6f + (NUM_BANDS - i) * BAR_SPACING;
+
+        for (int j = 0; j < NUM_BANDS; j ++)
+        {
+            float x = 1.6f - BAR_SPACING * j;
+
+            for (int v = 0; v < BAR_VERTICES; v ++)
+            {
+                s_vertices[i][j][v][0] = x + bar_shape[v][0] * BAR_WIDTH;
+                s_vertices[i][j][v][1] = 0;
+                s_vertices[i][j][v][2] = z + bar_shape[v][2] * BAR_WIDTH;
+            }
+        }
+    }
+}
+
 bool GLSpectrumQt::init ()
 {
     for (int i = 0; i <= NUM_BANDS; i ++)
@@ -108,6 +146,8 @@ bool GLSpectrumQt::init ()
         }
     }
 
+    init_bars ();
+
     return true;
 }
 
@@ -170,48 +210,20 @@ void GLSpectrumQt::clear ()
         s_widget->updateGL ();
 }
 
-static void draw_rectangle (float x1, float y1, float z1, float x2, float y2,
- float z2, float r, float g, float b)
+static void update_bar (int i, int j, float h)
 {
-    glColor3f (r, g, b);
-
-    glBegin (GL_POLYGON);
-    glVertex3f (x1, y2, z1);
-    glVertex3f (x2, y2, z1);
-    glVertex3f (x2, y2, z2);
-    glVertex3f (x1, y2, z2);
-    glEnd ();
-
-    glColor3f (0.65f * r, 0.65f * g, 0.65f * b);
-
-    glBegin (GL_POLYGON);
-    glVertex3f (x1, y1, z1);
-    glVertex3f (x1, y2, z1);
-    glVertex3f (x1, y2, z2);
-    glVertex3f (x1, y1, z2);
-    glEnd ();
-
-    glBegin (GL_POLYGON);
-    glVertex3f (x2, y2, z1);
-    glVertex3f (x2, y1, z1);
-    glVertex3f (x2, y1, z2);
-    glVertex3f (x2, y2, z2);
-    glEnd ();
-
-    glColor3f (0.8f * r, 0.8f * g, 0.8f * b);
-
-    glBegin (GL_POLYGON);
-    glVertex3f (x1, y1, z1);
-    glVertex3f (x2, y1, z1);
-    glVertex3f (x2, y2, z1);
-    glVertex3f (x1, y2, z1);
-    glEnd ();
-}
+    float bright = 0.2f + 0.8f * h;
 
-static void draw_bar (float x, float z, float h, float r, float g, float b)
-{
-    draw_rectangle (x, 0, z, x + BAR_WIDTH, h, z + BAR_WIDTH,
-     r * (0.2f + 0.8f * h), g * (0.2f + 0.8f * h), b * (0.2f + 0.8f * h));
+    for (int v = 0; v < BAR_VERTICES; v ++)
+    {
+        float shade = bright * bar_shade[v / 4];
+
+        if (bar_shape[v][1])
+            s_vertices[i][j][v][1] = h;
+
+        for (int c = 0; c < 3; c ++)
+            s_vertex_colors[i][j][v][c] = colors[i][j][c] * shade;
+    }
 }
 
 static void draw_bars ()
@@ -224,16 +236,20 @@ static void draw_bars ()
 
     for (int i = 0; i < NUM_BANDS; i ++)
     {
-        float z = -1.6f + (NUM_BANDS - i) * BAR_SPACING;
-
         for (int j = 0; j < NUM_BANDS; j ++)
-        {
-            draw_bar (1.6f - BAR_SPACING * j, z,
-             s_bars[(s_pos + i) % NUM_BANDS][j] * 1.6,
-             colors[i][j][0], colors[i][j][1], colors[i][j][2]);
-        }
+            update_bar (i, j, s_bars[(s_pos + i) % NUM_BANDS][j] * 1.6f);
     }
 
+    glEnableClientState (GL_VERTEX_ARRAY);
+    glEnableClientState (GL_COLOR_ARRAY);
+    glVertexPointer (3, GL_FLOAT, 0, s_vertices);
+    glColorPointer (3, GL_FLOAT, 0, s_vertex_colors);
+
+    glDrawArrays (GL_QUADS, 0, NUM_BANDS * NUM_BANDS * BAR_VERTICES);
+
+    glDisableClientState (GL_COLOR_ARRAY);
+    glDisableClientState (GL_VERTEX_ARRAY);
+
     glPolygonMode (GL_FRONT_AND_BACK, GL_FILL);
     glPopMatrix ();
 }
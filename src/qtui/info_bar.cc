@@ -19,6 +19,7 @@
 
 #include <cmath>
 
+#include "../ui-common/art-qt.h"
 #include "info_bar.h"
 #include "settings.h"
 
@@ -209,6 +210,12 @@ InfoBar::InfoBar(QWidget * parent)
     }
 }
 
+InfoBar::~InfoBar()
+{
+    art_cancel(this);
+    art_cleanup();
+}
+
 void InfoBar::resizeEvent(QResizeEvent *)
 {
     for (SongData & d : sd)
@@ -274,7 +281,29 @@ void InfoBar::update_title()
 
 void InfoBar::update_album_art()
 {
-    sd[Cur].art = audqt::art_request_current(ps.IconSize, ps.IconSize);
+    int size = std::lround(ps.IconSize * devicePixelRatioF());
+
+    sd[Cur].art = QPixmap();
+    art_request_current(size,
+                        [](ArtImage * image, void * bar) {
+                            ((InfoBar *)bar)->set_album_art(image);
+                        },
+                        this);
+    art_prefetch_next(size);
+}
+
+void InfoBar::set_album_art(ArtImage * image)
+{
+    if (image)
+    {
+        sd[Cur].art = QPixmap::fromImage(image->image);
+        sd[Cur].art.setDevicePixelRatio(devicePixelRatioF());
+    }
+    else
+        sd[Cur].art = audqt::get_icon("audio-x-generic")
+                          .pixmap(ps.IconSize, ps.IconSize);
+
+    update();
 }
 
 void InfoBar::next_song()
@@ -320,6 +349,7 @@ void InfoBar::playback_ready_cb()
 
 void InfoBar::playback_stop_cb()
 {
+    art_cancel(this);
     next_song();
     m_stopped = true;
 
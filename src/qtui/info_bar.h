@@ -26,12 +26,14 @@
 #include <libaudcore/hook.h>
 
 class InfoVis;
+struct ArtImage;
 struct PixelSizes;
 
 class InfoBar : public QWidget
 {
 public:
     InfoBar(QWidget * parent = nullptr);
+    ~InfoBar();
 
     void resizeEvent(QResizeEvent *);
     void paintEvent(QPaintEvent *);
@@ -39,6 +41,7 @@ public:
 private:
     void update_title();
     void update_album_art();
+    void set_album_art(ArtImage * image);
     void next_song();
     void do_fade();
 
@@ -373,11 +373,19 @@ void PlaylistWidget::playlistUpdate()
         else if (currentPos >= update.before)
             currentPos = -1;
 
+        proxyModel->entriesRemoved(update.before, removed);
+        proxyModel->entriesAdded(update.before, changed);
+
         model->entriesRemoved(update.before, removed);
         model->entriesAdded(update.before, changed);
     }
     else if (update.level == Playlist::Metadata || update.queue_changed)
+    {
+        if (update.level == Playlist::Metadata)
+            proxyModel->entriesChanged(update.before, changed);
+
         model->entriesChanged(update.before, changed);
+    }
 
     if (update.queue_changed)
     {
@@ -17,9 +17,12 @@
  * the use of this software.
  */
 
+#include <pthread.h>
+
 #include <QApplication>
 #include <QIcon>
 #include <QMimeData>
+#include <QThread>
 #include <QUrl>
 
 #include <libaudcore/audstrings.h>
@@ -81,34 +84,110 @@ QVariant PlaylistModel::alignment(int col) const
     }
 }
 
+static QVariant format_value(const Tuple & tuple, int col)
+{
+    int val = -1;
+
+    switch (tuple.get_value_type(s_fields[col]))
+    {
+    case Tuple::Empty:
+        return QVariant();
+    case Tuple::String:
+        return QString(tuple.get_str(s_fields[col]));
+    case Tuple::Int:
+        val = tuple.get_int(s_fields[col]);
+        break;
+    }
+
+    switch (col)
+    {
+    case PlaylistModel::Length:
+        return QString(str_format_time(val));
+    case PlaylistModel::Bitrate:
+        return QString("%1 kbps").arg(val);
+    default:
+        return QString("%1").arg(val);
+    }
+}
+
+PlaylistModel::CachedRow & PlaylistModel::cachedRow(int row) const
+{
+    constexpr int window = 256;
+
+    if (row < m_cacheStart || row >= m_cacheStart + m_cache.len())
+    {
+        m_cacheStart = aud::max(row - window / 2, 0);
+        int cacheEnd = aud::min(m_cacheStart + window, m_playlist.n_entries());
+
+        m_cache.clear();
+        m_cache.insert(0, aud::max(cacheEnd - m_cacheStart, 0));
+
+        for (int i = 0; i < m_cache.len(); i++)
+        {
+            m_cache[i].tuple =
+                m_playlist.entry_tuple(m_cacheStart + i, Playlist::NoWait);
+            m_cache[i].fetched = true;
+        }
+    }
+
+    CachedRow & cached = m_cache[row - m_cacheStart];
+
+    if (!cached.fetched)
+    {
+        cached.tuple = m_playlist.entry_tuple(row, Playlist::NoWait);
+        cached.fetched = true;
+        cached.formatted = 0;
+    }
+
+    return cached;
+}
+
+QVariant PlaylistModel::cachedValue(int row, int col) const
+{
+    if (row < 0 || row >= m_playlist.n_entries())
+        return QVariant();
+
+    CachedRow & cached = cachedRow(row);
+
+    if (!(cached.formatted & (1u << col)))
+    {
+        cached.values[col] = format_value(cached.tuple, col);
+        cached.formatted |= (1u << col);
+    }
+
+    return cached.values[col];
+}
+
+/* count = -1 means all rows from the given one; those are dropped from
+ * the window, so that they are fetched again in one go */
+void PlaylistModel::invalidateRows(int row, int count)
+{
+    int first = aud::clamp(row - m_cacheStart, 0, m_cache.len());
+
+    if (count < 0)
+    {
+        m_cache.remove(first, -1);
+        return;
+    }
+
+    int last = aud::min(row + count - m_cacheStart, m_cache.len());
+
+    for (int i = first; i < last; i++)
+    {
+        m_cache[i].fetched = false;
+        m_cache[i].formatted = 0;
+    }
+}
+
 QVariant PlaylistModel::data(const QModelIndex & index, int role) const
 {
     int col = index.column() - 1;
     if (col < 0 || col >= n_cols)
         return QVariant();
 
-    Tuple tuple;
-    int val = -1;
-
     switch (role)
     {
     case Qt::DisplayRole:
-        if (s_fields[col] != Tuple::Invalid)
-        {
-            tuple = m_playlist.entry_tuple(index.row(), Playlist::NoWait);
-
-            switch (tuple.get_value_type(s_fields[col]))
-            {
-            case Tuple::Empty:
-                return QVariant();
-            case Tuple::String:
-                return QString(tuple.get_str(s_fields[col]));
-            case Tuple::Int:
-                val = tuple.get_int(s_fields[col]);
-                break;
-            }
-        }
-
         switch (col)
         {
         case NowPlaying:
@@ -117,12 +196,8 @@ QVariant PlaylistModel::data(const QModelIndex & index, int role) const
             return QString("%1").arg(index.row() + 1);
         case QueuePos:
             return queuePos(index.row());
-        case Length:
-            return QString(str_format_time(val));
-        case Bitrate:
-            return QString("%1 kbps").arg(val);
         default:
-            return QString("%1").arg(val);
+            return cachedValue(index.row(), col);
         }
 
     case Qt::TextAlignmentRole:
@@ -243,6 +318,8 @@ void PlaylistModel::entriesAdded(int row, int count)
     if (count < 1)
         return;
 
+    invalidateRows(row, -1);
+
     int last = row + count - 1;
     beginInsertRows(QModelIndex(), row, last);
     m_rows += count;
@@ -254,6 +331,8 @@ void PlaylistModel::entriesRemoved(int row, int count)
     if (count < 1)
         return;
 
+    invalidateRows(row, -1);
+
     int last = row + count - 1;
     beginRemoveRows(QModelIndex(), row, last);
     m_rows -= count;
@@ -265,6 +344,8 @@ void PlaylistModel::entriesChanged(int row, int count)
     if (count < 1)
         return;
 
+    invalidateRows(row, count);
+
     int bottom = row + count - 1;
     auto topLeft = createIndex(row, 0);
     auto bottomRight = createIndex(bottom, columnCount() - 1);
@@ -282,36 +363,145 @@ QString PlaylistModel::queuePos(int row) const
 
 /* ---------------------------------- */
 
-void PlaylistProxyModel::setFilter(const char * filter)
+PlaylistProxyModel::PlaylistProxyModel(QObject * parent, Playlist playlist)
+    : QSortFilterProxyModel(parent), m_playlist(playlist)
 {
-    m_searchTerms = str_list_to_index(filter, " ");
-    invalidateFilter();
+    entriesAdded(0, playlist.n_entries());
 }
 
-bool PlaylistProxyModel::filterAcceptsRow(int source_row,
-                                          const QModelIndex &) const
+void PlaylistProxyModel::entriesAdded(int row, int count)
 {
-    if (!m_searchTerms.len())
-        return true;
+    if (count < 1)
+        return;
+
+    m_folded.insert(row, count);
+    m_accepted.insert(row, count);
+
+    for (int i = row; i < row + count; i++)
+        m_accepted[i] = -1;
+}
+
+void PlaylistProxyModel::entriesRemoved(int row, int count)
+{
+    if (count < 1)
+        return;
+
+    m_folded.remove(row, count);
+    m_accepted.remove(row, count);
+}
+
+void PlaylistProxyModel::entriesChanged(int row, int count)
+{
+    for (int i = row; i < aud::min(row + count, m_accepted.len()); i++)
+    {
+        m_folded[i] = String();
+        m_accepted[i] = -1;
+    }
+}
+
+String PlaylistProxyModel::foldedText(int row) const
+{
+    if (m_folded[row])
+        return m_folded[row];
+
+    /* never wait for an entry to be scanned */
+    Tuple tuple = m_playlist.entry_tuple(row, Playlist::NoWait);
+
+    String title = tuple.get_str(Tuple::Title);
+    String artist = tuple.get_str(Tuple::Artist);
+    String album = tuple.get_str(Tuple::Album);
 
-    Tuple tuple = m_playlist.entry_tuple(source_row);
+    /* search terms never contain a newline, so they can't match across
+     * two fields */
+    StringBuf text = str_concat({title ? title : "", "\n",
+                                 artist ? artist : "", "\n",
+                                 album ? album : ""});
+    String folded(str_tolower_utf8(text));
 
-    String strings[] = {tuple.get_str(Tuple::Title),
-                        tuple.get_str(Tuple::Artist),
-                        tuple.get_str(Tuple::Album)};
+    /* the title of an unscanned entry will change once it is scanned */
+    if (tuple.state() == Tuple::Valid)
+        m_folded[row] = folded;
+
+    return folded;
+}
+
+bool PlaylistProxyModel::rowMatches(int row) const
+{
+    String text = foldedText(row);
 
     for (auto & term : m_searchTerms)
+    {
+        if (!strstr(text, term))
+            return false;
+    }
+
+    return true;
+}
+
+/* When narrowing, only the rows that passed the previous filter (or have
+ * not been checked yet) are checked again. */
+void PlaylistProxyModel::filterRows(int first, int last, bool narrow)
+{
+    for (int row = first; row < last; row++)
+    {
+        if (!narrow || m_accepted[row] != 0)
+            m_accepted[row] = rowMatches(row);
+    }
+}
+
+struct FilterChunk
+{
+    PlaylistProxyModel * model;
+    int first, last;
+    bool narrow;
+};
+
+void * PlaylistProxyModel::filterThread(void * data)
+{
+    auto chunk = (FilterChunk *)data;
+    chunk->model->filterRows(chunk->first, chunk->last, chunk->narrow);
+    return nullptr;
+}
+
+/* Each thread handles a separate range of rows, so no locking is needed
+ * (entry_tuple() does its own). */
+void PlaylistProxyModel::filterAll(bool narrow)
+{
+    constexpr int min_chunk = 4096;
+
+    int rows = m_accepted.len();
+    int n_chunks = aud::clamp(rows / min_chunk, 1, QThread::idealThreadCount());
+
+    Index<FilterChunk> chunks;
+    Index<pthread_t> threads;
+    threads.insert(0, n_chunks);
+
+    for (int i = 0; i < n_chunks; i++)
+        chunks.append(FilterChunk{this, rows * i / n_chunks,
+                                  rows * (i + 1) / n_chunks, narrow});
+
+    for (int i = 1; i < n_chunks; i++)
+        pthread_create(&threads[i], nullptr, filterThread, &chunks[i]);
+
+    filterRows(chunks[0].first, chunks[0].last, narrow);
+
+    for (int i = 1; i < n_chunks; i++)
+        pthread_join(threads[i], nullptr);
+}
+
+/* true if each of the old terms is part of one of the new terms */
+static bool is_refinement(const Index<String> & old_terms,
+                          const Index<String> & new_terms)
+{
+    if (!old_terms.len())
+        return false;
+
+    for (auto & old_term : old_terms)
     {
         bool found = false;
 
-        for (auto & s : strings)
-        {
-            if (s && strstr_nocase_utf8(s, term))
-            {
-                found = true;
-                break;
-            }
-        }
+        for (auto & new_term : new_terms)
+            found = found || strstr(new_term, old_term);
 
         if (!found)
             return false;
@@ -319,3 +509,45 @@ bool PlaylistProxyModel::filterAcceptsRow(int source_row,
 
     return true;
 }
+
+void PlaylistProxyModel::setFilter(const char * filter)
+{
+    auto terms = str_list_to_index(str_tolower_utf8(filter), " ");
+    bool narrow = is_refinement(m_searchTerms, terms);
+
+    m_searchTerms = std::move(terms);
+
+    /* resynchronize, just in case */
+    if (m_accepted.len() != m_playlist.n_entries())
+    {
+        entriesRemoved(0, m_accepted.len());
+        entriesAdded(0, m_playlist.n_entries());
+        narrow = false;
+    }
+
+    if (!narrow)
+    {
+        for (auto & accepted : m_accepted)
+            accepted = -1;
+    }
+
+    if (m_searchTerms.len())
+        filterAll(narrow);
+
+    invalidateFilter();
+}
+
+bool PlaylistProxyModel::filterAcceptsRow(int source_row,
+                                          const QModelIndex &) const
+{
+    if (!m_searchTerms.len())
+        return true;
+
+    if (source_row < 0 || source_row >= m_accepted.len())
+        return false;
+
+    if (m_accepted[source_row] < 0)
+        m_accepted[source_row] = rowMatches(source_row);
+
+    return m_accepted[source_row];
+}
@@ -72,28 +72,59 @@ public:
     void entriesChanged(int row, int count);
 
 private:
+    /* formatted values for a window of rows around the last one shown;
+     * each tuple is fetched once when the window is filled */
+    struct CachedRow
+    {
+        bool fetched = false;
+        unsigned formatted = 0; // bit mask of columns
+        Tuple tuple;
+        QVariant values[n_cols];
+    };
+
     Playlist m_playlist;
     int m_rows;
 
+    mutable int m_cacheStart = 0;
+    mutable Index<CachedRow> m_cache;
+
     QVariant alignment(int col) const;
     QString queuePos(int row) const;
+
+    CachedRow & cachedRow(int row) const;
+    QVariant cachedValue(int row, int col) const;
+    void invalidateRows(int row, int count);
 };
 
 class PlaylistProxyModel : public QSortFilterProxyModel
 {
 public:
-    PlaylistProxyModel(QObject * parent, Playlist playlist)
-        : QSortFilterProxyModel(parent), m_playlist(playlist)
-    {
-    }
+    PlaylistProxyModel(QObject * parent, Playlist playlist);
 
     void setFilter(const char * filter);
 
+    /* must be called before the source model is updated */
+    void entriesAdded(int row, int count);
+    void entriesRemoved(int row, int count);
+    void entriesChanged(int row, int count);
+
 private:
     bool filterAcceptsRow(int source_row, const QModelIndex &) const;
 
+    String foldedText(int row) const;
+    bool rowMatches(int row) const;
+    void filterRows(int first, int last, bool narrow);
+    void filterAll(bool narrow);
+
+    static void * filterThread(void * data);
+
     Playlist m_playlist;
     Index<String> m_searchTerms;
+
+    /* case-folded title, artist and album of each entry (null if not
+     * cached yet), and whether it passes the filter (-1 if not known) */
+    mutable Index<String> m_folded;
+    mutable Index<signed char> m_accepted;
 };
 
 #endif
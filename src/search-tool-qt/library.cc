@@ -19,8 +19,21 @@
 
 #include "library.h"
 
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+#include <stdio.h>
 #include <string.h>
+
+#include <sys/stat.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <libaudcore/audstrings.h>
 #include <libaudcore/i18n.h>
+#include <libaudcore/probe.h>
+#include <libaudcore/runtime.h>
+#include <libaudcore/vfs.h>
 
 aud::spinlock Library::s_adding_lock;
 Library * Library::s_adding_library = nullptr;
@@ -71,6 +84,12 @@ void Library::set_adding (bool adding)
 
 bool Library::filter_cb (const char * filename, void *)
 {
+    /* the stamp is taken before the file is probed, so a change made
+     * during the scan is picked up by the next refresh */
+    StringBuf path = uri_to_filename (filename);
+    GStatBuf info;
+    bool have_stamp = path && g_stat (path, & info) == 0;
+
     bool add = false;
     auto lh = s_adding_lock.take ();
 
@@ -82,6 +101,10 @@ bool Library::filter_cb (const char * filename, void *)
             s_adding_library->m_added_table.add (String (filename), true);
         else
             (* added) = true;
+
+        if (have_stamp)
+            s_adding_library->m_added_stamps.add (String (filename),
+             {(int64_t) info.st_mtime, (int64_t) info.st_size});
     }
 
     return add;
@@ -92,6 +115,9 @@ void Library::begin_add (const char * uri)
     if (s_adding_library)
         return;
 
+    cancel_refresh ();
+    m_refreshing = false;
+
     if (! check_playlist (false, false))
         create_playlist ();
 
@@ -114,6 +140,8 @@ void Library::begin_add (const char * uri)
 
     m_playlist.remove_selected ();
 
+    m_added_stamps.clear ();
+    m_unplayable.clear ();
     set_adding (true);
 
     Index<PlaylistAddItem> add;
@@ -123,6 +151,25 @@ void Library::begin_add (const char * uri)
 
 void Library::check_ready_and_update (bool force)
 {
+    if (m_refreshing)
+    {
+        /* wait until the new entries are scanned */
+        if (m_playlist.exists () && (m_playlist.add_in_progress () ||
+         m_playlist.scan_in_progress () || m_playlist.update_pending ()))
+            return;
+
+        finish_refresh ();
+
+        /* pick up changes made while refreshing */
+        if (m_refresh_again)
+        {
+            m_refresh_again = false;
+            begin_refresh (m_manifest_root);
+        }
+
+        return;
+    }
+
     bool now_ready = check_playlist (true, true);
     if (now_ready != m_is_ready || force)
     {
@@ -160,6 +207,14 @@ void Library::add_complete ()
             m_playlist.select_all (false);
 
         m_playlist.sort_entries (Playlist::Path);
+
+        /* the next refresh then only looks at files changed since */
+        m_manifest.clear ();
+        m_added_stamps.iterate ([&] (const String & uri, FileStamp & stamp)
+            { m_manifest.add (uri, FileStamp (stamp)); });
+
+        m_added_stamps.clear ();
+        save_manifest ();
     }
 
     if (! m_playlist.update_pending ())
@@ -176,3 +231,378 @@ void Library::playlist_update ()
 {
     check_ready_and_update (m_playlist.update_detail ().level >= Playlist::Metadata);
 }
+
+/*
+ * Incremental refresh
+ *
+ * The folder is walked on a worker thread, comparing each file's
+ * modification time and size with the manifest from the last scan.
+ * Entries whose files are gone or changed are removed from the playlist,
+ * and only new or changed files are probed and inserted where sorting by
+ * path would put them.  Unlike begin_add(), this does not reload the whole
+ * folder through the playlist.  The manifest is written by either one.
+ */
+
+static StringBuf manifest_path ()
+{
+    return filename_build ({aud_get_path (AudPath::UserDir), "search-tool-manifest"});
+}
+
+static bool uri_in_dir (const char * uri, const char * dir_uri)
+{
+    int len = strlen (dir_uri);
+    return ! strncmp (uri, dir_uri, len) && (uri[len] == '/' || ! uri[len]);
+}
+
+/* entries of multi-track files look like file:///path?1 */
+static String strip_subtune (const String & uri)
+{
+    const char * sub = strrchr (uri, '?');
+    if (! sub || ! sub[1] || strspn (sub + 1, "0123456789") != strlen (sub + 1))
+        return uri;
+
+    return String (str_copy (uri, sub - uri));
+}
+
+void Library::load_manifest ()
+{
+    if (m_manifest_loaded)
+        return;
+
+    m_manifest_loaded = true;
+
+    StringBuf path = manifest_path ();
+    if (! g_file_test (path, G_FILE_TEST_EXISTS))
+        return;
+
+    VFSFile file (filename_to_uri (path), "r");
+    if (! file)
+        return;
+
+    Index<char> text = file.read_all ();
+    text.append (0);
+
+    char * line = text.begin ();
+    char * next = strchr (line, '\n');
+    if (! next)
+        return;
+
+    * next = 0;
+    m_manifest_root = String (line);
+
+    for (line = next + 1; * line; line = next + 1)
+    {
+        if (! (next = strchr (line, '\n')))
+            break;
+
+        * next = 0;
+
+        FileStamp stamp;
+        int pos = 0;
+
+        if (sscanf (line, "%" SCNd64 " %" SCNd64 " %n", & stamp.mtime, & stamp.size, & pos) >= 2 && pos)
+            m_manifest.add (String (line + pos), std::move (stamp));
+    }
+}
+
+void Library::save_manifest ()
+{
+    StringBuf path = manifest_path ();
+    VFSFile file (filename_to_uri (path), "w");
+    if (! file)
+        return;
+
+    Index<char> text;
+    text.insert (m_manifest_root, -1, strlen (m_manifest_root));
+    text.append ('\n');
+
+    m_manifest.iterate ([&] (const String & uri, FileStamp & stamp)
+    {
+        StringBuf line = str_printf ("%" PRId64 " %" PRId64 " %s\n",
+         stamp.mtime, stamp.size, (const char *) uri);
+        text.insert (line, -1, line.len ());
+    });
+
+    if (file.fwrite (text.begin (), 1, text.len ()) != text.len ())
+        AUDERR ("Failed to write %s\n", (const char *) path);
+}
+
+void Library::clear_changes ()
+{
+    m_has_changes = false;
+    m_removed.clear ();
+    m_added.clear ();
+}
+
+void Library::begin_refresh (const char * uri, const char * dir_uri)
+{
+    if (s_adding_library)
+        return;
+
+    if (m_refresh_running || m_refreshing)
+    {
+        m_refresh_again = true;
+        return;
+    }
+
+    load_manifest ();
+
+    /* a full scan is needed for a new folder, or the first time */
+    if (! uri_to_filename (uri) || ! m_manifest_root || strcmp (m_manifest_root, uri) ||
+     ! check_playlist (true, true) || ! m_playlist.n_entries ())
+    {
+        if (! m_manifest_root || strcmp (m_manifest_root, uri))
+        {
+            m_manifest_root = String (uri);
+            m_manifest.clear ();
+        }
+
+        begin_add (uri);
+        check_ready_and_update (true);
+        return;
+    }
+
+    m_refresh_dir = String ((dir_uri && uri_in_dir (dir_uri, uri)) ? dir_uri : uri);
+
+    m_refresh_entries.clear ();
+
+    int entries = m_playlist.n_entries ();
+    for (int entry = 0; entry < entries; entry ++)
+        m_refresh_entries.add (strip_subtune (m_playlist.entry_filename (entry)), true);
+
+    m_refresh_cancel = false;
+    m_refresh_running = true;
+    pthread_create (& m_refresh_thread, nullptr, refresh_thread, this);
+}
+
+void Library::cancel_refresh ()
+{
+    if (m_refresh_running)
+    {
+        m_refresh_cancel = true;
+        pthread_join (m_refresh_thread, nullptr);
+        m_refresh_running = false;
+    }
+
+    m_refresh_done.stop ();
+    m_refresh_entries.clear ();
+    m_refresh_seen.clear ();
+    m_refresh_changed.clear ();
+    m_refresh_add.clear ();
+}
+
+/* runs in the worker thread */
+void Library::run_refresh ()
+{
+    Index<String> dirs;
+    dirs.append (String (uri_to_filename (m_refresh_dir)));
+
+    while (dirs.len () && ! m_refresh_cancel)
+    {
+        String dir = std::move (dirs[dirs.len () - 1]);
+        dirs.remove (dirs.len () - 1, 1);
+
+        GDir * folder = g_dir_open (dir, 0, nullptr);
+        if (! folder)
+            continue;
+
+        const char * name;
+        while ((name = g_dir_read_name (folder)) && ! m_refresh_cancel)
+        {
+            if (name[0] == '.')
+                continue;
+
+            StringBuf path = filename_build ({dir, name});
+            GStatBuf info;
+
+            if (g_stat (path, & info) < 0)
+                continue;
+
+            if (S_ISDIR (info.st_mode))
+            {
+                dirs.append (String (path));
+                continue;
+            }
+
+            if (! S_ISREG (info.st_mode))
+                continue;
+
+            String uri (filename_to_uri (path));
+            FileStamp stamp = {(int64_t) info.st_mtime, (int64_t) info.st_size};
+            FileStamp * old = m_manifest.lookup (uri);
+            bool listed = m_refresh_entries.lookup (uri);
+
+            m_refresh_seen.add (uri, FileStamp (stamp));
+
+            /* files missing from the playlist are probed again, in case
+             * they were removed from it or their add was cut short */
+            FileStamp * unplayable = m_unplayable.lookup (uri);
+
+            if (old && * old == stamp && listed)
+                continue;
+            if (! listed && unplayable && * unplayable == stamp)
+                continue;
+
+            if (listed)
+                m_refresh_changed.add (uri, true);
+
+            VFSFile file (uri, "r");
+            PluginHandle * decoder = file ? aud_file_find_decoder (uri, true, file) : nullptr;
+
+            if (decoder)
+                m_refresh_add.append (uri, Tuple (), decoder);
+            else if (unplayable)
+                * unplayable = stamp;
+            else
+                m_unplayable.add (uri, FileStamp (stamp));
+        }
+
+        g_dir_close (folder);
+    }
+
+    if (! m_refresh_cancel)
+        m_refresh_done.queue (refresh_done, this);
+}
+
+/* called in the main thread, once the folder has been walked */
+void Library::apply_refresh ()
+{
+    pthread_join (m_refresh_thread, nullptr);
+    m_refresh_running = false;
+
+    if (! check_playlist (true, true))
+    {
+        cancel_refresh ();
+        return;
+    }
+
+    Index<int> removed;
+    int entries = m_playlist.n_entries ();
+
+    for (int entry = 0; entry < entries; entry ++)
+    {
+        String uri = strip_subtune (m_playlist.entry_filename (entry));
+        bool remove = uri_in_dir (uri, m_refresh_dir) &&
+         (! m_refresh_seen.lookup (uri) || m_refresh_changed.lookup (uri));
+
+        m_playlist.select_entry (entry, remove);
+        if (remove)
+            removed.append (entry);
+    }
+
+    /* drop vanished files from the manifest and record the others; it is
+     * saved once the new entries have been scanned */
+    Index<String> gone;
+
+    m_manifest.iterate ([&] (const String & uri, FileStamp &)
+    {
+        if (uri_in_dir (uri, m_refresh_dir) && ! m_refresh_seen.lookup (uri))
+            gone.append (uri);
+    });
+
+    for (const String & uri : gone)
+        m_manifest.remove (uri);
+
+    m_refresh_seen.iterate ([&] (const String & uri, FileStamp & stamp)
+    {
+        FileStamp * old = m_manifest.lookup (uri);
+        if (old)
+            * old = stamp;
+        else
+            m_manifest.add (uri, FileStamp (stamp));
+    });
+
+    clear_changes ();
+    m_refreshing = true;
+    m_added_count = m_refresh_add.len ();
+    m_kept_count = entries - removed.len ();
+
+    if (removed.len ())
+    {
+        m_playlist.remove_selected ();
+
+        m_has_changes = true;
+        m_removed = std::move (removed);
+        if (update_func)
+            update_func (update_data);
+        clear_changes ();
+    }
+    else
+        m_playlist.select_all (false);
+
+    if (m_added_count)
+        insert_sorted (std::move (m_refresh_add));
+
+    AUDINFO ("Library refresh: %d removed, %d added.\n",
+     entries - m_kept_count, m_added_count);
+
+    m_refresh_entries.clear ();
+    m_refresh_seen.clear ();
+    m_refresh_changed.clear ();
+    m_refresh_add.clear ();
+
+    if (! m_added_count && ! m_playlist.update_pending ())
+        check_ready_and_update (false);
+}
+
+/* Inserts the new files where sorting by path would put them, so that
+ * the playlist stays sorted as after begin_add().  Their positions are
+ * kept for the search index. */
+void Library::insert_sorted (Index<PlaylistAddItem> && items)
+{
+    items.sort ([] (const PlaylistAddItem & a, const PlaylistAddItem & b)
+        { return str_compare_encoded (a.filename, b.filename); });
+
+    Index<int> positions;
+    int entries = m_playlist.n_entries ();
+    int entry = 0;
+
+    for (auto & item : items)
+    {
+        while (entry < entries && str_compare_encoded
+         (m_playlist.entry_filename (entry), item.filename) <= 0)
+            entry ++;
+
+        positions.append (entry);
+        m_added.append (entry + positions.len () - 1);
+    }
+
+    /* insert runs from the end, so that earlier positions stay valid */
+    for (int end = items.len (); end > 0; )
+    {
+        int start = end - 1;
+        while (start > 0 && positions[start - 1] == positions[start])
+            start --;
+
+        Index<PlaylistAddItem> run;
+        run.move_from (items, start, 0, end - start, true, true);
+        m_playlist.insert_items (positions[start], std::move (run), false);
+
+        end = start;
+    }
+}
+
+/* called once the new entries have been scanned */
+void Library::finish_refresh ()
+{
+    m_refreshing = false;
+    save_manifest ();
+
+    if (! check_playlist (true, true))
+    {
+        check_ready_and_update (true);
+        return;
+    }
+
+    int entries = m_playlist.n_entries ();
+    if (entries == m_kept_count)
+        return;
+
+    /* if something else changed the playlist meanwhile, rebuild */
+    if (entries == m_kept_count + m_added_count)
+        m_has_changes = true;
+
+    if (update_func)
+        update_func (update_data);
+    clear_changes ();
+}
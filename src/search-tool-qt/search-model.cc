@@ -142,61 +142,227 @@ void SearchModel::update ()
 
 void SearchModel::destroy_database ()
 {
+    cancel_search ();
+    m_last_terms.clear ();
+    m_last_matches.clear ();
+
     m_playlist = Playlist ();
     m_items.clear ();
     m_hidden_items = 0;
     m_database.clear ();
+    m_all_items.clear ();
+    m_trigrams.clear ();
 }
 
-void SearchModel::create_database (Playlist playlist)
+/* Folded strings are indexed by their byte trigrams.  A term of three or
+ * more bytes can only occur in an item that contains all of its trigrams,
+ * so the posting lists of those trigrams narrow down the items to check. */
+static Trigram trigram_at (const char * s)
 {
-    destroy_database ();
+    return {(unsigned char) s[0] | ((unsigned char) s[1] << 8) |
+     ((unsigned) (unsigned char) s[2] << 16)};
+}
 
-    int entries = playlist.n_entries ();
+void SearchModel::index_item (Item * item)
+{
+    item->id = m_all_items.len ();
+    m_all_items.append (item);
 
-    for (int e = 0; e < entries; e ++)
+    const char * folded = item->folded;
+    int len = strlen (folded);
+
+    for (int i = 0; i + 3 <= len; i ++)
+    {
+        Trigram key = trigram_at (folded + i);
+        Index<int> * ids = m_trigrams.lookup (key);
+
+        if (! ids)
+            ids = m_trigrams.add (key, Index<int> ());
+
+        /* posting lists are sorted, since items are indexed in order */
+        if (! ids->len () || (* ids)[ids->len () - 1] != item->id)
+            ids->append (item->id);
+    }
+}
+
+static int posting_compare (const Index<int> * const & a, const Index<int> * const & b)
+{
+    return a->len () - b->len ();
+}
+
+/* removes the ids not found in the (sorted) list */
+static void intersect (Index<int> & ids, const Index<int> & list)
+{
+    int kept = 0, pos = 0;
+
+    for (int i = 0; i < ids.len (); i ++)
     {
-        Tuple tuple = playlist.entry_tuple (e, Playlist::NoWait);
+        while (pos < list.len () && list[pos] < ids[i])
+            pos ++;
+
+        if (pos < list.len () && list[pos] == ids[i])
+            ids[kept ++] = ids[i];
+    }
+
+    ids.remove (kept, -1);
+}
+
+/* Finds the items that may contain the term.  Returns false if the term
+ * is too short to be looked up in the index. */
+bool SearchModel::lookup_term (const char * term, Index<int> & ids)
+{
+    int len = strlen (term);
+    if (len < 3)
+        return false;
 
-        aud::array<SearchField, String> fields;
-        fields[SearchField::Genre] = tuple.get_str (Tuple::Genre);
-        fields[SearchField::Artist] = tuple.get_str (Tuple::Artist);
-        fields[SearchField::Album] = tuple.get_str (Tuple::Album);
-        fields[SearchField::Title] = tuple.get_str (Tuple::Title);
+    Index<const Index<int> *> lists;
 
-        Item * parent = nullptr;
-        SimpleHash<Key, Item> * hash = & m_database;
+    for (int i = 0; i + 3 <= len; i ++)
+    {
+        const Index<int> * list = m_trigrams.lookup (trigram_at (term + i));
 
-        for (auto f : aud::range<SearchField> ())
+        if (! list)
         {
-            if (fields[f])
+            ids.clear ();
+            return true;
+        }
+
+        lists.append (list);
+    }
+
+    /* start with the shortest list */
+    lists.sort (posting_compare);
+
+    ids.clear ();
+    ids.insert (lists[0]->begin (), 0, lists[0]->len ());
+
+    for (int i = 1; i < lists.len () && ids.len (); i ++)
+        intersect (ids, * lists[i]);
+
+    return true;
+}
+
+void SearchModel::add_entry (int e)
+{
+    Tuple tuple = m_playlist.entry_tuple (e, Playlist::NoWait);
+
+    aud::array<SearchField, String> fields;
+    fields[SearchField::Genre] = tuple.get_str (Tuple::Genre);
+    fields[SearchField::Artist] = tuple.get_str (Tuple::Artist);
+    fields[SearchField::Album] = tuple.get_str (Tuple::Album);
+    fields[SearchField::Title] = tuple.get_str (Tuple::Title);
+
+    Item * parent = nullptr;
+    SimpleHash<Key, Item> * hash = & m_database;
+
+    for (auto f : aud::range<SearchField> ())
+    {
+        if (fields[f])
+        {
+            Key key = {f, fields[f]};
+            Item * item = hash->lookup (key);
+
+            if (! item)
             {
-                Key key = {f, fields[f]};
-                Item * item = hash->lookup (key);
+                item = hash->add (key, Item (f, fields[f], parent));
+                index_item (item);
+            }
 
-                if (! item)
-                    item = hash->add (key, Item (f, fields[f], parent));
+            /* keep the entries in order, also when added by an update */
+            int pos = item->matches.len ();
+            while (pos > 0 && item->matches[pos - 1] > e)
+                pos --;
 
-                item->matches.append (e);
+            item->matches.insert (& e, pos, 1);
 
-                /* genre is outside the normal hierarchy */
-                if (f != SearchField::Genre)
-                {
-                    parent = item;
-                    hash = & item->children;
-                }
+            /* genre is outside the normal hierarchy */
+            if (f != SearchField::Genre)
+            {
+                parent = item;
+                hash = & item->children;
             }
         }
     }
+}
+
+void SearchModel::create_database (Playlist playlist)
+{
+    destroy_database ();
 
     m_playlist = playlist;
+
+    int entries = playlist.n_entries ();
+    for (int e = 0; e < entries; e ++)
+        add_entry (e);
+}
+
+/* Updates the database in place after entries were removed from the
+ * playlist (removed holds their former positions, in order) and others
+ * were inserted (added holds their new positions, in order).  Items left
+ * without any entry are skipped when searching, until the next full
+ * rebuild. */
+void SearchModel::update_database (Playlist playlist,
+ const Index<int> & removed, const Index<int> & added)
+{
+    if (playlist != m_playlist)
+    {
+        create_database (playlist);
+        return;
+    }
+
+    cancel_search ();
+    m_last_terms.clear ();
+    m_last_matches.clear ();
+    m_items.clear ();
+    m_hidden_items = 0;
+
+    int dead = 0;
+
+    for (Item * item : m_all_items)
+    {
+        int kept = 0, r = 0, a = 0;
+
+        for (int e : item->matches)
+        {
+            while (r < removed.len () && removed[r] < e)
+                r ++;
+
+            if (r < removed.len () && removed[r] == e)
+                continue;
+
+            /* the entries left fill the positions not taken by new ones */
+            while (a < added.len () && added[a] <= e - r + a)
+                a ++;
+
+            item->matches[kept ++] = e - r + a;
+        }
+
+        item->matches.remove (kept, -1);
+
+        if (! kept)
+            dead ++;
+    }
+
+    /* rebuild once most of the items are unused */
+    if (dead > m_all_items.len () / 2)
+    {
+        create_database (playlist);
+        return;
+    }
+
+    for (int e : added)
+        add_entry (e);
 }
 
 static void search_recurse (SimpleHash<Key, Item> & domain,
- const Index<String> & terms, int mask, Index<const Item *> & results)
+ const Index<String> & terms, int mask, Index<const Item *> & results,
+ const std::atomic<bool> & cancel)
 {
     domain.iterate ([&] (const Key & key, Item & item)
     {
+        if (cancel || ! item.matches.len ())
+            return;
+
         int count = terms.len ();
         int new_mask = mask;
 
@@ -215,10 +381,99 @@ static void search_recurse (SimpleHash<Key, Item> & domain,
         if (! new_mask && item.children.n_items () != 1)
             results.append (& item);
 
-        search_recurse (item.children, terms, new_mask, results);
+        search_recurse (item.children, terms, new_mask, results, cancel);
     });
 }
 
+/* returns the mask of terms not found in the item */
+static int check_item (const Item & item, const Index<String> & terms, int mask)
+{
+    for (int t = 0, bit = 1; t < terms.len (); t ++, bit <<= 1)
+    {
+        if ((mask & bit) && strstr (item.folded, terms[t]))
+            mask &= ~bit;
+    }
+
+    return mask;
+}
+
+/* Searches below the items that contain the given term, which must be
+ * somewhere in the path of every result.  Unlike search_recurse, this
+ * does not have to look at the rest of the database. */
+static void search_roots (const Index<Item *> & roots, const Index<String> & terms,
+ int root_term, Index<const Item *> & results, const std::atomic<bool> & cancel)
+{
+    const char * term = terms[root_term];
+
+    for (Item * item : roots)
+    {
+        if (cancel)
+            return;
+
+        /* skip false positives from the index, and unused items */
+        if (! strstr (item->folded, term) || ! item->matches.len ())
+            continue;
+
+        /* skip items that will be reached from a parent */
+        bool nested = false;
+        for (const Item * p = item->parent; p && ! nested; p = p->parent)
+            nested = (strstr (p->folded, term) != nullptr);
+
+        if (nested)
+            continue;
+
+        int mask = check_item (* item, terms, (1 << terms.len ()) - 1);
+        for (const Item * p = item->parent; p && mask; p = p->parent)
+            mask = check_item (* p, terms, mask);
+
+        /* adding an item with exactly one child is redundant, so avoid it */
+        if (! mask && item->children.n_items () != 1)
+            results.append (item);
+
+        search_recurse (item->children, terms, mask, results, cancel);
+    }
+}
+
+/* Narrows down the results of a previous search.  Adding to the terms
+ * can only remove results, so there is no need to look elsewhere. */
+static void search_refine (const Index<const Item *> & previous,
+ const Index<String> & terms, Index<const Item *> & results,
+ const std::atomic<bool> & cancel)
+{
+    for (const Item * item : previous)
+    {
+        if (cancel)
+            return;
+
+        int mask = (1 << terms.len ()) - 1;
+        for (const Item * p = item; p && mask; p = p->parent)
+            mask = check_item (* p, terms, mask);
+
+        if (! mask)
+            results.append (item);
+    }
+}
+
+/* true if each of the old terms is part of one of the new terms */
+static bool is_refinement (const Index<String> & old_terms, const Index<String> & new_terms)
+{
+    if (! old_terms.len ())
+        return false; /* nothing was filtered out before */
+
+    for (const String & old_term : old_terms)
+    {
+        bool found = false;
+
+        for (const String & new_term : new_terms)
+            found = found || strstr (new_term, old_term);
+
+        if (! found)
+            return false;
+    }
+
+    return true;
+}
+
 static int item_compare (const Item * const & a, const Item * const & b)
 {
     if (a->field < b->field)
@@ -246,24 +501,129 @@ static int item_compare_pass1 (const Item * const & a, const Item * const & b)
     return item_compare (a, b);
 }
 
-void SearchModel::do_search (const Index<String> & terms, int max_results)
+void SearchModel::begin_search (const Index<String> & terms, int max_results,
+ QueuedFunc::Func done, void * data)
 {
-    m_items.clear ();
-    m_hidden_items = 0;
+    cancel_search ();
+
+    m_job.terms.clear ();
+    m_job.terms.insert (terms.begin (), 0, terms.len ());
+    m_job.max_results = max_results;
+    m_job.refine = is_refinement (m_last_terms, terms);
 
-    /* effectively limits number of search terms to 32 */
-    search_recurse (m_database, terms, (1 << terms.len ()) - 1, m_items);
+    m_done_func = done;
+    m_done_data = data;
+
+    m_cancel = false;
+    m_thread_running = true;
+    pthread_create (& m_thread, nullptr, search_thread, this);
+}
+
+void SearchModel::finish_search ()
+{
+    if (! m_thread_running)
+        return;
+
+    pthread_join (m_thread, nullptr);
+    m_thread_running = false;
+
+    m_search_done.stop ();
+    apply_results ();
+}
+
+void SearchModel::cancel_search ()
+{
+    if (m_thread_running)
+    {
+        m_cancel = true;
+        pthread_join (m_thread, nullptr);
+        m_thread_running = false;
+    }
+
+    m_search_done.stop ();
+    m_job = Job ();
+}
+
+/* runs in the worker thread; m_job is not touched by the main thread
+ * until the thread has been joined */
+void SearchModel::run_search ()
+{
+    auto & terms = m_job.terms;
+    auto & matches = m_job.matches;
+
+    if (m_job.refine)
+        search_refine (m_last_matches, terms, matches, m_cancel);
+    else
+    {
+        /* look up the most selective term in the index */
+        Index<int> ids;
+        int root_term = -1;
+
+        for (int t = 0; t < terms.len (); t ++)
+        {
+            Index<int> term_ids;
+
+            if (lookup_term (terms[t], term_ids) &&
+             (root_term < 0 || term_ids.len () < ids.len ()))
+            {
+                ids = std::move (term_ids);
+                root_term = t;
+            }
+        }
+
+        if (root_term >= 0)
+        {
+            Index<Item *> roots;
+            for (int id : ids)
+                roots.append (m_all_items[id]);
+
+            search_roots (roots, terms, root_term, matches, m_cancel);
+        }
+        else
+        {
+            /* no term is long enough to be looked up, so search everything;
+             * effectively limits number of search terms to 32 */
+            search_recurse (m_database, terms, (1 << terms.len ()) - 1, matches, m_cancel);
+        }
+    }
+
+    if (m_cancel)
+        return;
+
+    auto & items = m_job.items;
+    items.insert (matches.begin (), 0, matches.len ());
 
     /* first sort by number of songs per item */
-    m_items.sort (item_compare_pass1);
+    items.sort (item_compare_pass1);
 
     /* limit to items with most songs */
-    if (m_items.len () > max_results)
+    if (items.len () > m_job.max_results)
     {
-        m_hidden_items = m_items.len () - max_results;
-        m_items.remove (max_results, -1);
+        m_job.hidden_items = items.len () - m_job.max_results;
+        items.remove (m_job.max_results, -1);
     }
 
     /* sort by item type, then item name */
-    m_items.sort (item_compare);
+    items.sort (item_compare);
+
+    m_search_done.queue (search_done, this);
+}
+
+/* called in the main thread, once the search has finished */
+void SearchModel::apply_results ()
+{
+    if (m_thread_running)
+    {
+        pthread_join (m_thread, nullptr);
+        m_thread_running = false;
+    }
+
+    m_items = std::move (m_job.items);
+    m_hidden_items = m_job.hidden_items;
+    m_last_terms = std::move (m_job.terms);
+    m_last_matches = std::move (m_job.matches);
+    m_job = Job ();
+
+    if (m_done_func)
+        m_done_func (m_done_data);
 }
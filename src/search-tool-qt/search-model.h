@@ -22,7 +22,11 @@
 
 #include <QAbstractListModel>
 
+#include <pthread.h>
+#include <atomic>
+
 #include <libaudcore/audstrings.h>
+#include <libaudcore/mainloop.h>
 #include <libaudcore/multihash.h>
 #include <libaudcore/playlist.h>
 
@@ -45,6 +49,17 @@ struct Key
         { return (unsigned) field + name.hash (); }
 };
 
+/* three bytes of a folded string, for the search index */
+struct Trigram
+{
+    unsigned code;
+
+    bool operator== (const Trigram & b) const
+        { return code == b.code; }
+    unsigned hash () const
+        { return code * 0x9e3779b1; }
+};
+
 struct Item
 {
     SearchField field;
@@ -52,6 +67,7 @@ struct Item
     Item * parent;
     SimpleHash<Key, Item> children;
     Index<int> matches;
+    int id = -1;
 
     Item (SearchField field, const String & name, Item * parent) :
         field (field),
@@ -66,6 +82,8 @@ struct Item
 class SearchModel : public QAbstractListModel
 {
 public:
+    ~SearchModel () { cancel_search (); }
+
     int num_items () const { return m_items.len (); }
     const Item & item_at (int idx) const { return * m_items[idx]; }
     int num_hidden_items () const { return m_hidden_items; }
@@ -73,7 +91,17 @@ public:
     void update ();
     void destroy_database ();
     void create_database (Playlist playlist);
-    void do_search (const Index<String> & terms, int max_results);
+    void update_database (Playlist playlist, const Index<int> & removed,
+     const Index<int> & added);
+
+    /* Searches run on a worker thread.  When one finishes, its results
+     * replace the current ones and done is called from the main thread.
+     * Starting a new search cancels the previous one. */
+    void begin_search (const Index<String> & terms, int max_results,
+     QueuedFunc::Func done, void * data);
+    /* waits for a running search and applies its results */
+    void finish_search ();
+    void cancel_search ();
 
 protected:
     int rowCount (const QModelIndex & parent) const { return m_rows; }
@@ -98,9 +126,45 @@ protected:
 private:
     Playlist m_playlist;
     SimpleHash<Key, Item> m_database;
+    Index<Item *> m_all_items;
+    SimpleHash<Trigram, Index<int>> m_trigrams;
     Index<const Item *> m_items;
     int m_hidden_items = 0;
     int m_rows = 0;
+
+    /* results of the last completed search, which a refined query
+     * (one that only adds to the previous terms) searches within */
+    Index<String> m_last_terms;
+    Index<const Item *> m_last_matches;
+
+    /* the search being run by the worker thread */
+    struct Job
+    {
+        Index<String> terms;
+        int max_results = 0;
+        bool refine = false;
+        Index<const Item *> matches, items;
+        int hidden_items = 0;
+    };
+
+    Job m_job;
+    pthread_t m_thread;
+    bool m_thread_running = false;
+    std::atomic<bool> m_cancel {false};
+    QueuedFunc m_search_done;
+    QueuedFunc::Func m_done_func = nullptr;
+    void * m_done_data = nullptr;
+
+    void add_entry (int e);
+    void index_item (Item * item);
+    bool lookup_term (const char * term, Index<int> & ids);
+    void run_search ();
+    void apply_results ();
+
+    static void * search_thread (void * data)
+        { ((SearchModel *) data)->run_search (); return nullptr; }
+    static void search_done (void * data)
+        { ((SearchModel *) data)->apply_results (); }
 };
 
 #endif // SEARCHMODEL_H
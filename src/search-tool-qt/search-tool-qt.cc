@@ -122,6 +122,8 @@ private:
     void init_library ();
     void show_hide_widgets ();
     void search_timeout ();
+    void search_done ();
+    void finish_search ();
     void library_updated ();
     void location_changed ();
     void walk_library_paths ();
@@ -271,7 +273,7 @@ void SearchWidget::init_library ()
      (aud::obj_member<SearchWidget, & SearchWidget::library_updated>, this);
 
     if (aud_get_bool (CFG_ID, "rescan_on_startup"))
-        m_library.begin_add (get_uri ());
+        m_library.begin_refresh (get_uri ());
 
     m_library.check_ready_and_update (true);
 }
@@ -304,11 +306,8 @@ void SearchWidget::show_hide_widgets ()
     }
 }
 
-void SearchWidget::search_timeout ()
+void SearchWidget::search_done ()
 {
-    auto text = m_search_entry.text ().toUtf8 ();
-    auto terms = str_list_to_index (str_tolower_utf8 (text), " ");
-    m_model.do_search (terms, aud_get_int (CFG_ID, "max_results"));
     m_model.update ();
 
     int shown = m_model.num_items ();
@@ -328,11 +327,28 @@ void SearchWidget::search_timeout ()
     else
         m_stats_label.setText ((const char *)
          str_printf (dngettext (PACKAGE, "%d result", "%d results", total), total));
+}
+
+void SearchWidget::search_timeout ()
+{
+    auto text = m_search_entry.text ().toUtf8 ();
+    auto terms = str_list_to_index (str_tolower_utf8 (text), " ");
+    m_model.begin_search (terms, aud_get_int (CFG_ID, "max_results"),
+     aud::obj_member<SearchWidget, & SearchWidget::search_done>, this);
 
     m_search_timer.stop ();
     m_search_pending = false;
 }
 
+/* makes sure the results match the current text */
+void SearchWidget::finish_search ()
+{
+    if (m_search_pending)
+        search_timeout ();
+
+    m_model.finish_search ();
+}
+
 void SearchWidget::trigger_search ()
 {
     m_search_timer.queue (SEARCH_DELAY,
@@ -344,8 +360,15 @@ void SearchWidget::library_updated ()
 {
     if (m_library.is_ready ())
     {
-        m_model.create_database (m_library.playlist ());
+        if (m_library.has_changes ())
+            m_model.update_database (m_library.playlist (),
+             m_library.removed_entries (), m_library.added_entries ());
+        else
+            m_model.create_database (m_library.playlist ());
+
+        /* the old results are gone, so wait for the new ones */
         search_timeout ();
+        m_model.finish_search ();
     }
     else
     {
@@ -369,8 +392,7 @@ void SearchWidget::location_changed ()
     StringBuf path = uri_to_filename (uri);
     aud_set_str (CFG_ID, "path", path ? path : uri);
 
-    m_library.begin_add (uri);
-    m_library.check_ready_and_update (true);
+    m_library.begin_refresh (uri);
     reset_monitor ();
 }
 
@@ -405,12 +427,12 @@ void SearchWidget::setup_monitor ()
     m_watcher_paths.clear ();
 
     QObject::connect (m_watcher.get (), & QFileSystemWatcher::directoryChanged,
-     [this] (const QString &)
+     [this] (const QString & path)
     {
         AUDINFO ("Library directory changed, refreshing library.\n");
 
-        m_library.begin_add (get_uri ());
-        m_library.check_ready_and_update (true);
+        /* only the changed folder needs to be rescanned */
+        m_library.begin_refresh (get_uri (), filename_to_uri (path.toUtf8 ()));
 
         walk_library_paths ();
     });
@@ -434,8 +456,7 @@ void SearchWidget::reset_monitor ()
 
 void SearchWidget::do_add (bool play, bool set_title)
 {
-    if (m_search_pending)
-        search_timeout ();
+    finish_search ();
 
     int n_items = m_model.num_items ();
     int n_selected = 0;
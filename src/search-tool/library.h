@@ -20,28 +20,62 @@
 #ifndef LIBRARY_H
 #define LIBRARY_H
 
+#include <pthread.h>
+#include <stdint.h>
+#include <atomic>
+
 #include <libaudcore/hook.h>
+#include <libaudcore/mainloop.h>
 #include <libaudcore/multihash.h>
 #include <libaudcore/playlist.h>
 
+/* modification time and size of a file, as of the last scan */
+struct FileStamp
+{
+    int64_t mtime, size;
+
+    bool operator== (const FileStamp & b) const
+        { return mtime == b.mtime && size == b.size; }
+};
+
 class Library
 {
 public:
     Library () { find_playlist (); }
-    ~Library () { set_adding (false); }
+    ~Library () { cancel_refresh (); set_adding (false); }
 
     Playlist playlist () const { return m_playlist; }
     bool is_ready () const { return m_is_ready; }
 
     void begin_add (const char * uri);
+    /* rescans only the files changed since the last scan, optionally
+     * only those in one folder; falls back to begin_add() if needed */
+    void begin_refresh (const char * uri, const char * dir_uri = nullptr);
     void check_ready_and_update (bool force);
 
+    /* During an update after a refresh, the entries removed (by their
+     * positions before the removal) and the entries added (by their
+     * positions after it), so that the search index can be updated in
+     * place. */
+    bool has_changes () const { return m_has_changes; }
+    const Index<int> & removed_entries () const { return m_removed; }
+    const Index<int> & added_entries () const { return m_added; }
+
 private:
     void find_playlist ();
     void create_playlist ();
     bool check_playlist (bool require_added, bool require_scanned);
     void set_adding (bool adding);
 
+    void load_manifest ();
+    void save_manifest ();
+    void cancel_refresh ();
+    void clear_changes ();
+    void run_refresh ();
+    void apply_refresh ();
+    void insert_sorted (Index<PlaylistAddItem> && items);
+    void finish_refresh ();
+
     static bool filter_cb (const char * filename, void *);
 
     void add_complete (void);
@@ -53,6 +87,41 @@ private:
     Playlist m_playlist;
     bool m_is_ready = false;
     SimpleHash<String, bool> m_added_table;
+    /* stamps of the files seen by a full scan, for the manifest */
+    SimpleHash<String, FileStamp> m_added_stamps;
+
+    /* file stamps of the library folder, saved between sessions */
+    bool m_manifest_loaded = false;
+    String m_manifest_root;
+    SimpleHash<String, FileStamp> m_manifest;
+    /* files found to be unplayable, so that a refresh does not probe them
+     * again while they are unchanged; kept for the session only */
+    SimpleHash<String, FileStamp> m_unplayable;
+
+    /* state of a refresh; the worker thread reads m_manifest and
+     * m_refresh_entries, updates m_unplayable and fills in the rest */
+    String m_refresh_dir;
+    SimpleHash<String, bool> m_refresh_entries;
+    SimpleHash<String, FileStamp> m_refresh_seen;
+    SimpleHash<String, bool> m_refresh_changed;
+    Index<PlaylistAddItem> m_refresh_add;
+    pthread_t m_refresh_thread;
+    bool m_refresh_running = false;
+    std::atomic<bool> m_refresh_cancel {false};
+    QueuedFunc m_refresh_done;
+
+    /* set while the changes are applied to the playlist */
+    bool m_refreshing = false;
+    bool m_refresh_again = false;
+    int m_kept_count = 0, m_added_count = 0;
+
+    bool m_has_changes = false;
+    Index<int> m_removed, m_added;
+
+    static void * refresh_thread (void * data)
+        { ((Library *) data)->run_refresh (); return nullptr; }
+    static void refresh_done (void * data)
+        { ((Library *) data)->apply_refresh (); }
 
     /* to allow safe callback access from playlist add thread */
     static aud::spinlock s_adding_lock;
@@ -132,12 +132,8 @@ static void show_hide_widgets ()
     }
 }
 
-static void search_timeout (void * = nullptr)
+static void search_done (void *)
 {
-    const char * text = gtk_entry_get_text ((GtkEntry *) entry);
-    auto terms = str_list_to_index (str_tolower_utf8 (text), " ");
-    s_model.do_search (terms, aud_get_int (CFG_ID, "max_results"));
-
     int shown = s_model.num_items ();
     int hidden = s_model.num_hidden_items ();
     int total = shown + hidden;
@@ -157,11 +153,27 @@ static void search_timeout (void * = nullptr)
     else
         gtk_label_set_text ((GtkLabel *) stats_label,
          str_printf (dngettext (PACKAGE, "%d result", "%d results", total), total));
+}
+
+static void search_timeout (void * = nullptr)
+{
+    const char * text = gtk_entry_get_text ((GtkEntry *) entry);
+    auto terms = str_list_to_index (str_tolower_utf8 (text), " ");
+    s_model.begin_search (terms, aud_get_int (CFG_ID, "max_results"), search_done, nullptr);
 
     s_search_timer.stop ();
     s_search_pending = false;
 }
 
+/* makes sure the results match the current text */
+static void finish_search ()
+{
+    if (s_search_pending)
+        search_timeout ();
+
+    s_model.finish_search ();
+}
+
 static void trigger_search ()
 {
     s_search_timer.queue (SEARCH_DELAY, search_timeout, nullptr);
@@ -172,8 +184,15 @@ void Library::signal_update ()
 {
     if (s_library->is_ready ())
     {
-        s_model.create_database (s_library->playlist ());
+        if (s_library->has_changes ())
+            s_model.update_database (s_library->playlist (),
+             s_library->removed_entries (), s_library->added_entries ());
+        else
+            s_model.create_database (s_library->playlist ());
+
+        /* the old results are gone, so wait for the new ones */
         search_timeout ();
+        s_model.finish_search ();
     }
     else
     {
@@ -191,7 +210,7 @@ static void search_init ()
     s_library = new Library;
 
     if (aud_get_bool (CFG_ID, "rescan_on_startup"))
-        s_library->begin_add (get_uri ());
+        s_library->begin_refresh (get_uri ());
 
     s_library->check_ready_and_update (true);
 }
@@ -210,8 +229,7 @@ static void search_cleanup ()
 
 static void do_add (bool play, bool set_title)
 {
-    if (s_search_pending)
-        search_timeout ();
+    finish_search ();
 
     auto list = s_library->playlist ();
     int n_items = s_model.num_items ();
@@ -355,8 +373,7 @@ static void list_right_click (void * user, GdkEventButton * event)
 
 static Index<char> list_get_data (void * user)
 {
-    if (s_search_pending)
-        search_timeout ();
+    finish_search ();
 
     auto list = s_library->playlist ();
     int n_items = s_model.num_items ();
@@ -423,8 +440,7 @@ static void refresh_cb (GtkButton * button, GtkWidget * file_entry)
         StringBuf path = uri_to_filename (uri);
         aud_set_str (CFG_ID, "path", path ? path : uri);
 
-        s_library->begin_add (uri);
-        s_library->check_ready_and_update (true);
+        s_library->begin_refresh (uri);
     }
 }
 
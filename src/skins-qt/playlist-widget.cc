@@ -27,6 +27,8 @@
  * Audacious or using our public API to be a derived work.
  */
 
+#include <math.h>
+
 #include "menus.h"
 #include "skins_cfg.h"
 #include "skin.h"
@@ -128,12 +130,58 @@ void PlaylistWidget::cancel_all ()
     popup_hide ();
 }
 
+/* Laying out text is the costliest part of drawing, so the layouts of
+ * the most recently drawn strings are kept until the font changes. */
+#define TEXT_CACHE_MAX 512
+
+const TextLayout & PlaylistWidget::get_text (const String & text)
+{
+    String key = text ? text : String ("");
+    TextLayout * cached = m_texts.lookup (key);
+
+    if (! cached)
+    {
+        /* drop the least recently used layout */
+        if (m_texts.n_items () >= TEXT_CACHE_MAX)
+        {
+            const String * oldest = nullptr;
+            unsigned oldest_used = 0;
+
+            m_texts.iterate ([&] (const String & k, TextLayout & l)
+            {
+                if (! oldest || l.used < oldest_used)
+                {
+                    oldest = & k;
+                    oldest_used = l.used;
+                }
+            });
+
+            String old_key = * oldest;
+            m_texts.remove (old_key);
+        }
+
+        QStaticText layout ((const char *) key);
+        layout.setTextFormat (Qt::PlainText);
+        layout.prepare (QTransform (), * m_font);
+
+        cached = m_texts.add (key, {layout, (int) ceil (layout.size ().width ()), 0});
+    }
+
+    cached->used = ++ m_text_counter;
+    return * cached;
+}
+
+void PlaylistWidget::show_text (QPainter & cr, const TextLayout & text, int x, int y)
+{
+    int height = (int) text.text.size ().height ();
+    cr.drawStaticText (x, y + (m_row_height - height) / 2, text.text);
+}
+
 void PlaylistWidget::draw (QPainter & cr)
 {
     int active_entry = m_playlist.get_position ();
     int left = 3, right = 3;
     int width;
-    QRect rect;
 
     cr.setFont (* m_font);
 
@@ -145,9 +193,12 @@ void PlaylistWidget::draw (QPainter & cr)
 
     if (m_offset)
     {
+        auto & text = get_text (m_title_text);
+
         cr.setPen (QColor (skin.colors[SKIN_PLEDIT_NORMAL]));
-        cr.drawText (left, 0, m_width - left - right, m_row_height,
-         Qt::AlignCenter, (const char *) m_title_text);
+        cr.setClipRect (left, 0, m_width - left - right, m_row_height);
+        show_text (cr, text, left + (m_width - left - right - text.width) / 2, 0);
+        cr.setClipping (false);
     }
 
     /* selection highlight */
@@ -170,13 +221,12 @@ void PlaylistWidget::draw (QPainter & cr)
             char buf[16];
             snprintf (buf, sizeof buf, "%d.", 1 + i);
 
+            auto & text = get_text (String (buf));
+            width = aud::max (width, text.width);
+
             cr.setPen (QColor (skin.colors[(i == active_entry) ?
              SKIN_PLEDIT_CURRENT : SKIN_PLEDIT_NORMAL]));
-            cr.drawText (left, m_offset + m_row_height * (i - m_first),
-             m_width - left - right, m_row_height,
-             Qt::AlignLeft | Qt::AlignVCenter, buf, & rect);
-
-            width = aud::max (width, rect.width ());
+            show_text (cr, text, left, m_offset + m_row_height * (i - m_first));
         }
 
         left += width + 4;
@@ -193,14 +243,12 @@ void PlaylistWidget::draw (QPainter & cr)
         if (len < 0)
             continue;
 
+        auto & text = get_text (String (str_format_time (len)));
+        width = aud::max (width, text.width);
+
         cr.setPen (QColor (skin.colors[(i == active_entry) ?
          SKIN_PLEDIT_CURRENT : SKIN_PLEDIT_NORMAL]));
-        cr.drawText (left, m_offset + m_row_height * (i - m_first),
-         m_width - left - right, m_row_height,
-         Qt::AlignRight | Qt::AlignVCenter,
-         (const char *) str_format_time (len), & rect);
-
-        width = aud::max (width, rect.width ());
+        show_text (cr, text, m_width - right - text.width, m_offset + m_row_height * (i - m_first));
     }
 
     right += width + 6;
@@ -220,13 +268,13 @@ void PlaylistWidget::draw (QPainter & cr)
             char buf[16];
             snprintf (buf, sizeof buf, "(#%d)", 1 + pos);
 
+            auto & text = get_text (String (buf));
+            width = aud::max (width, text.width);
+
             cr.setPen (QColor (skin.colors[(i == active_entry) ?
              SKIN_PLEDIT_CURRENT : SKIN_PLEDIT_NORMAL]));
-            cr.drawText (left, m_offset + m_row_height * (i - m_first),
-             m_width - left - right, m_row_height,
-             Qt::AlignRight | Qt::AlignVCenter, buf, & rect);
-
-            width = aud::max (width, rect.width ());
+            show_text (cr, text, m_width - right - text.width, m_offset +
+             m_row_height * (i - m_first));
         }
 
         right += width + 6;
@@ -234,18 +282,22 @@ void PlaylistWidget::draw (QPainter & cr)
 
     /* titles */
 
+    cr.setClipRect (left, 0, m_width - left - right, m_height);
+
     for (int i = m_first; i < m_first + m_rows && i < m_length; i ++)
     {
         Tuple tuple = m_playlist.entry_tuple (i, Playlist::NoWait);
         String title = tuple.get_str (Tuple::FormattedTitle);
 
+        auto & text = get_text (title);
+
         cr.setPen (QColor (skin.colors[(i == active_entry) ?
          SKIN_PLEDIT_CURRENT : SKIN_PLEDIT_NORMAL]));
-        cr.drawText (left, m_offset + m_row_height * (i - m_first),
-         m_width - left - right, m_row_height,
-         Qt::AlignLeft | Qt::AlignVCenter, (const char *) title);
+        show_text (cr, text, left, m_offset + m_row_height * (i - m_first));
     }
 
+    cr.setClipping (false);
+
     /* focus rectangle */
 
     int focus = m_playlist.get_focus ();
@@ -293,6 +345,7 @@ void PlaylistWidget::resize (int width, int height)
 void PlaylistWidget::set_font (const char * font)
 {
     m_font.capture (new QFont (audqt::qfont_from_string (font)));
+    m_texts.clear ();
     m_metrics.capture (new QFontMetrics (* m_font, this));
     m_row_height = m_metrics->height ();
     refresh ();
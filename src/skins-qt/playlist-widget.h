@@ -28,8 +28,11 @@
 #ifndef SKINS_UI_SKINNED_PLAYLIST_H
 #define SKINS_UI_SKINNED_PLAYLIST_H
 
+#include <QStaticText>
+
 #include <libaudcore/hook.h>
 #include <libaudcore/mainloop.h>
+#include <libaudcore/multihash.h>
 #include <libaudcore/playlist.h>
 
 #include "widget.h"
@@ -38,6 +41,14 @@ class PlaylistSlider;
 class QFont;
 class QFontMetrics;
 
+/* text laid out by Qt, reused across redraws */
+struct TextLayout
+{
+    QStaticText text;
+    int width;  /* in pixels */
+    unsigned used;
+};
+
 class PlaylistWidget : public Widget
 {
 public:
@@ -65,6 +76,9 @@ private:
     void update_title ();
     void calc_layout ();
 
+    const TextLayout & get_text (const String & text);
+    void show_text (QPainter & cr, const TextLayout & text, int x, int y);
+
     int calc_position (int y) const;
     int adjust_position (bool relative, int position) const;
 
@@ -90,6 +104,9 @@ private:
     SmartPtr<QFontMetrics> m_metrics;
     String m_title_text;
 
+    SimpleHash<String, TextLayout> m_texts;
+    unsigned m_text_counter = 0;
+
     Playlist m_playlist;
     int m_length = 0;
     int m_width = 0, m_height = 0, m_row_height = 1, m_offset = 0, m_rows = 0, m_first = 0;
@@ -29,6 +29,7 @@
 #include <sys/stat.h>
 
 #include <glib.h>
+#include <glib/gstdio.h>
 #include <QPainter>
 
 #include <libaudcore/audstrings.h>
@@ -93,26 +94,26 @@ static const uint32_t default_vis_colors[24] = {
 
 Skin skin;
 
-static bool skin_load_pixmap_id (SkinPixmapId id, const char * path)
+static bool skin_load_pixmap_id (SkinPixmapId id, SkinFiles & files)
 {
-    StringBuf filename = skin_pixmap_locate (path, skin_pixmap_id_map[id].name,
+    const Index<char> * data = files.read_pixmap (skin_pixmap_id_map[id].name,
      skin_pixmap_id_map[id].alt_name);
 
-    if (! filename)
+    if (! data)
     {
         AUDERR ("Skin does not contain a \"%s\" pixmap.\n", skin_pixmap_id_map[id].name);
         return false;
     }
 
     QImage & image = skin.pixmaps[id];
-    image.load ((const char *) filename);
+    image.loadFromData ((const uchar *) data->begin (), data->len ());
 
     if (! image.isNull () && image.format () != QImage::Format_RGB32)
         image = image.convertToFormat (QImage::Format_RGB32);
 
     if (image.isNull ())
     {
-        AUDERR ("Error loading pixmap: %s\n", (const char *) filename);
+        AUDERR ("Error loading pixmap: %s\n", skin_pixmap_id_map[id].name);
         return false;
     }
 
@@ -159,15 +160,16 @@ static void skin_get_eq_spline_colors (const QImage & image)
         skin.eq_spline_colors[i] = image.pixel (115, i + 294);
 }
 
-static void skin_load_viscolor (const char * path)
+static void skin_load_viscolor (SkinFiles & files)
 {
     memcpy (skin.vis_colors, default_vis_colors, sizeof skin.vis_colors);
 
-    VFSFile file = open_local_file_nocase (path, "viscolor.txt");
-    if (! file)
+    const Index<char> * data = files.read ("viscolor.txt");
+    if (! data)
         return;
 
-    Index<char> buffer = file.read_all ();
+    Index<char> buffer;
+    buffer.insert (data->begin (), 0, data->len ());
     buffer.append (0);  /* null-terminated */
 
     char * string = buffer.begin ();
@@ -203,13 +205,11 @@ static void skin_numbers_generate_dash (QImage & image)
     image = std::move (temp);
 }
 
-static bool skin_load_pixmaps (const char * path)
+static bool skin_load_pixmaps (SkinFiles & files)
 {
-    AUDDBG ("Loading pixmaps in %s\n", path);
-
     /* eq_ex.bmp was added after Winamp 2.0 so some skins do not include it */
     for (int i = 0; i < SKIN_PIXMAP_COUNT; i ++)
-        if (! skin_load_pixmap_id ((SkinPixmapId) i, path) && i != SKIN_EQ_EX)
+        if (! skin_load_pixmap_id ((SkinPixmapId) i, files) && i != SKIN_EQ_EX)
             return false;
 
     skin_get_textcolors (skin.pixmaps[SKIN_TEXT]);
@@ -219,44 +219,271 @@ static bool skin_load_pixmaps (const char * path)
     return true;
 }
 
-static bool skin_load_data (const char * path)
+/*
+ * Decoded skins are cached, so that loading a skin again skips reading the
+ * archive and decoding the bitmaps.  A cache file records the stamp of the
+ * skin and is rebuilt when it changes.
+ */
+
+#define SKIN_CACHE_MAGIC "AUDSKINC"
+#define SKIN_CACHE_VERSION 1
+#define SKIN_CACHE_SUFFIX ".qt"
+#define SKIN_CACHE_MAX 16
+#define SKIN_PIXMAP_MAX 4096
+
+struct SkinCacheHeader {
+    char magic[8];
+    uint32_t version, hints_size;
+    int64_t mtime, size;
+    uint32_t path_len;
+};
+
+class CacheReader
 {
-    AUDDBG ("Attempt to load skin \"%s\"\n", path);
+public:
+    CacheReader (const Index<char> & buf) :
+        m_data (buf.begin ()),
+        m_left (buf.len ()) {}
+
+    bool get (void * data, int64_t len)
+    {
+        if (len < 0 || len > m_left)
+            return false;
+
+        memcpy (data, m_data, len);
+        m_data += len;
+        m_left -= len;
+        return true;
+    }
+
+private:
+    const char * m_data;
+    int64_t m_left;
+};
+
+static void cache_put (Index<char> & buf, const void * data, int64_t len)
+{
+    buf.insert ((const char *) data, -1, len);
+}
+
+static StringBuf skin_cache_path (const char * path)
+{
+    CharPtr hash (g_compute_checksum_for_string (G_CHECKSUM_MD5, path, -1));
+    return filename_build ({skins_get_skin_cache_dir (),
+     str_concat ({hash, SKIN_CACHE_SUFFIX})});
+}
+
+static bool skin_read_cache (CacheReader & reader, const char * path,
+ const SkinStamp & stamp, Skin & loaded)
+{
+    SkinCacheHeader header;
+    if (! reader.get (& header, sizeof header) ||
+     memcmp (header.magic, SKIN_CACHE_MAGIC, sizeof header.magic) ||
+     header.version != SKIN_CACHE_VERSION || header.hints_size != sizeof (SkinHints) ||
+     header.mtime != stamp.mtime || header.size != stamp.size ||
+     header.path_len != strlen (path))
+        return false;
+
+    StringBuf cached_path (header.path_len);
+    if (! reader.get (cached_path, header.path_len) || strcmp (cached_path, path))
+        return false;
 
-    if (! g_file_test (path, G_FILE_TEST_EXISTS))
+    if (! reader.get (& loaded.hints, sizeof loaded.hints) ||
+     ! reader.get (loaded.colors, sizeof loaded.colors) ||
+     ! reader.get (loaded.eq_spline_colors, sizeof loaded.eq_spline_colors) ||
+     ! reader.get (loaded.vis_colors, sizeof loaded.vis_colors))
         return false;
 
-    StringBuf archive_path;
-    if (file_is_archive (path))
+    for (auto & mask : loaded.masks)
     {
-        AUDDBG ("Attempt to load archive\n");
-        archive_path = archive_decompress (path);
+        uint32_t count;
+        if (! reader.get (& count, sizeof count))
+            return false;
 
-        if (! archive_path)
+        for (uint32_t i = 0; i < count; i ++)
         {
-            AUDDBG ("Unable to extract skin archive (%s)\n", path);
+            int32_t rect[4];
+            if (! reader.get (rect, sizeof rect))
+                return false;
+
+            mask.append (rect[0], rect[1], rect[2], rect[3]);
+        }
+    }
+
+    for (auto & pixmap : loaded.pixmaps)
+    {
+        int32_t size[2];
+        if (! reader.get (size, sizeof size))
             return false;
+
+        /* a missing optional pixmap */
+        if (! size[0])
+            continue;
+
+        if (size[0] < 0 || size[0] > SKIN_PIXMAP_MAX || size[1] <= 0 || size[1] > SKIN_PIXMAP_MAX)
+            return false;
+
+        pixmap = QImage (size[0], size[1], QImage::Format_RGB32);
+
+        for (int y = 0; y < size[1]; y ++)
+        {
+            if (! reader.get (pixmap.scanLine (y), 4 * size[0]))
+                return false;
+        }
+    }
+
+    return true;
+}
+
+static bool skin_load_cache (const char * cache_path, const char * path,
+ const SkinStamp & stamp)
+{
+    gchar * data;
+    gsize len;
+
+    if (! g_file_get_contents (cache_path, & data, & len, nullptr))
+        return false;
+
+    Index<char> buf;
+    buf.insert (data, 0, len);
+    g_free (data);
+
+    CacheReader reader (buf);
+    Skin loaded;
+
+    if (! skin_read_cache (reader, path, stamp, loaded))
+        return false;
+
+    skin = std::move (loaded);
+
+    /* the least recently used files are pruned first */
+    g_utime (cache_path, nullptr);
+    return true;
+}
+
+static void skin_prune_cache ()
+{
+    struct CacheFile {
+        String path;
+        int64_t mtime;
+    };
+
+    const char * cache_dir = skins_get_skin_cache_dir ();
+    GDir * dir = g_dir_open (cache_dir, 0, nullptr);
+    if (! dir)
+        return;
+
+    Index<CacheFile> files;
+    const char * name;
+
+    while ((name = g_dir_read_name (dir)))
+    {
+        StringBuf path = filename_build ({cache_dir, name});
+        GStatBuf info;
+
+        if (g_stat (path, & info) == 0)
+            files.append (String (path), (int64_t) info.st_mtime);
+    }
+
+    g_dir_close (dir);
+
+    files.sort ([] (const CacheFile & a, const CacheFile & b)
+        { return (a.mtime > b.mtime) - (a.mtime < b.mtime); });
+
+    for (int i = 0; i < files.len () - SKIN_CACHE_MAX; i ++)
+        g_unlink (files[i].path);
+}
+
+static void skin_save_cache (const char * cache_path, const char * path,
+ const SkinStamp & stamp)
+{
+    Index<char> buf;
+
+    SkinCacheHeader header {};
+    memcpy (header.magic, SKIN_CACHE_MAGIC, sizeof header.magic);
+    header.version = SKIN_CACHE_VERSION;
+    header.hints_size = sizeof (SkinHints);
+    header.mtime = stamp.mtime;
+    header.size = stamp.size;
+    header.path_len = strlen (path);
+
+    cache_put (buf, & header, sizeof header);
+    cache_put (buf, path, header.path_len);
+    cache_put (buf, & skin.hints, sizeof skin.hints);
+    cache_put (buf, skin.colors, sizeof skin.colors);
+    cache_put (buf, skin.eq_spline_colors, sizeof skin.eq_spline_colors);
+    cache_put (buf, skin.vis_colors, sizeof skin.vis_colors);
+
+    for (auto & mask : skin.masks)
+    {
+        uint32_t count = mask.len ();
+        cache_put (buf, & count, sizeof count);
+
+        for (auto & r : mask)
+        {
+            int32_t rect[4] = {r.x (), r.y (), r.width (), r.height ()};
+            cache_put (buf, rect, sizeof rect);
         }
+    }
+
+    for (auto & pixmap : skin.pixmaps)
+    {
+        int32_t size[2] = {pixmap.width (), pixmap.height ()};
+        cache_put (buf, size, sizeof size);
 
-        path = archive_path;
+        for (int y = 0; y < size[1]; y ++)
+            cache_put (buf, pixmap.constScanLine (y), 4 * size[0]);
     }
 
-    bool success = skin_load_pixmaps (path);
+    make_directory (skins_get_skin_cache_dir ());
 
-    if (success)
+    GError * error = nullptr;
+    if (! g_file_set_contents (cache_path, buf.begin (), buf.len (), & error))
     {
-        skin_load_hints (path);
-        skin_load_pl_colors (path);
-        skin_load_viscolor (path);
-        skin_load_masks (path);
+        AUDWARN ("Failed to write %s: %s\n", cache_path, error->message);
+        g_error_free (error);
+        return;
     }
-    else
+
+    skin_prune_cache ();
+}
+
+static bool skin_load_data (const char * path)
+{
+    AUDDBG ("Attempt to load skin \"%s\"\n", path);
+
+    SkinStamp stamp;
+    if (! skin_get_stamp (path, stamp))
+        return false;
+
+    StringBuf cache_path = skin_cache_path (path);
+
+    if (skin_load_cache (cache_path, path, stamp))
+    {
+        AUDDBG ("Loaded skin from %s\n", (const char *) cache_path);
+        return true;
+    }
+
+    SkinFiles files;
+    if (! files.open (path))
+    {
+        AUDDBG ("Unable to read skin (%s)\n", path);
+        return false;
+    }
+
+    if (! skin_load_pixmaps (files))
+    {
         AUDDBG ("Skin loading failed\n");
+        return false;
+    }
 
-    if (archive_path)
-        del_directory (archive_path);
+    skin_load_hints (files);
+    skin_load_pl_colors (files);
+    skin_load_viscolor (files);
+    skin_load_masks (files);
 
-    return success;
+    skin_save_cache (cache_path, path, stamp);
+    return true;
 }
 
 bool skin_load (const char * path)
@@ -26,6 +26,7 @@
 #ifndef UTIL_H
 #define UTIL_H
 
+#include <libaudcore/multihash.h>
 #include <libaudcore/vfs.h>
 
 typedef void (* DirForeachFunc) (const char * path, const char * basename);
@@ -33,20 +34,54 @@ typedef void (* DirForeachFunc) (const char * path, const char * basename);
 StringBuf find_file_case_path (const char * folder, const char * basename);
 
 VFSFile open_local_file_nocase (const char * folder, const char * basename);
-StringBuf skin_pixmap_locate (const char * folder, const char * basename,
- const char * altname = nullptr);
 
 char * text_parse_line (char * text);
 
 void make_directory (const char * path);
-void del_directory (const char * path);
 
 bool dir_foreach (const char * path, DirForeachFunc func);
 
 Index<int> string_to_int_array (const char *str);
 
+typedef SimpleHash<String, Index<char>> SkinFileHash;
+typedef bool (* ArchiveFilter) (const char * name);
+
+/* Size and modification time of a skin; for a directory, the total size
+ * and the newest time of the files in it. */
+struct SkinStamp {
+    int64_t mtime, size;
+};
+
+bool skin_get_stamp (const char * path, SkinStamp & stamp);
+
 bool file_is_archive (const char * filename);
 StringBuf archive_basename (const char * str);
-StringBuf archive_decompress (const char * path);
+
+/* Reads the files in an archive into memory, keyed by their names in lower
+ * case and without directories.  If a filter is given, only the files it
+ * accepts are decompressed. */
+bool archive_read (const char * filename, SkinFileHash & files,
+ ArchiveFilter filter = nullptr);
+
+/* The files of a skin, which is either a directory or an archive.  Names
+ * are looked up ignoring case. */
+class SkinFiles
+{
+public:
+    /* the filter only applies to archives */
+    bool open (const char * path, ArchiveFilter filter = nullptr);
+
+    /* nullptr if the skin has no such file */
+    const Index<char> * read (const char * name);
+    const Index<char> * read_pixmap (const char * basename,
+     const char * altname = nullptr);
+
+    /* for the parsers, which read from a VFSFile */
+    VFSFile open_file (const char * name);
+
+private:
+    String m_folder;
+    SkinFileHash m_files;
+};
 
 #endif
@@ -35,60 +35,6 @@
 
 Index<SkinNode> skinlist;
 
-#if 0
-static AudguiPixbuf skin_get_preview (const char * path)
-{
-    AudguiPixbuf preview;
-
-    StringBuf archive_path;
-    if (file_is_archive (path))
-    {
-        archive_path = archive_decompress (path);
-        if (! archive_path)
-            return preview;
-
-        path = archive_path;
-    }
-
-    StringBuf preview_path = skin_pixmap_locate (path, "main");
-    if (preview_path)
-        preview.capture (gdk_pixbuf_new_from_file (preview_path, nullptr));
-
-    if (archive_path)
-        del_directory (archive_path);
-
-    return preview;
-}
-
-static AudguiPixbuf skin_get_thumbnail (const char * path)
-{
-    StringBuf base = filename_get_base (path);
-    base.insert (-1, ".png");
-
-    StringBuf thumbname = filename_build ({skins_get_skin_thumb_dir (), base});
-    AudguiPixbuf thumb;
-
-    if (g_file_test (thumbname, G_FILE_TEST_EXISTS))
-        thumb.capture (gdk_pixbuf_new_from_file (thumbname, nullptr));
-
-    if (! thumb)
-    {
-        thumb = skin_get_preview (path);
-
-        if (thumb)
-        {
-            make_directory (skins_get_skin_thumb_dir ());
-            gdk_pixbuf_save (thumb.get (), thumbname, "png", nullptr, nullptr);
-        }
-    }
-
-    if (thumb)
-        audgui_pixbuf_scale_within (thumb, audgui_get_dpi () * 3 / 2);
-
-    return thumb;
-}
-#endif
-
 static void scan_skindir_func (const char * path, const char * basename)
 {
     if (g_file_test (path, G_FILE_TEST_IS_REGULAR))
@@ -26,6 +26,7 @@
 
 #include <string.h>
 #include <libaudcore/objects.h>
+#include <libaudcore/runtime.h>
 
 #include "skins_cfg.h"
 #include "skin.h"
@@ -88,6 +89,12 @@ void SkinnedVis::draw (QPainter & cr)
     uint32_t rgb[76 * 16];
     uint32_t * set;
 
+    if (m_frame_queued)
+    {
+        m_frame_queued = false;
+        m_frames_painted ++;
+    }
+
     if (config.vis_type != VIS_VOICEPRINT)
     {
         for (set = rgb; set < rgb + 76 * 16; set += 76 * 2)
@@ -142,16 +149,6 @@ void SkinnedVis::draw (QPainter & cr)
     }
     case VIS_VOICEPRINT:
     {
-        if (m_voiceprint_advance)
-        {
-            m_voiceprint_advance = false;
-            memmove (m_voiceprint_data, m_voiceprint_data + 1, sizeof
-             m_voiceprint_data - 1);
-
-            for (int y = 0; y < 16; y ++)
-                m_voiceprint_data[76 * y + 75] = m_data[y];
-        }
-
         unsigned char * get = m_voiceprint_data;
         uint32_t * colors = (config.voiceprint_mode == VOICEPRINT_NORMAL) ?
          m_voice_color : (config.voiceprint_mode == VOICEPRINT_FIRE) ?
@@ -242,8 +239,12 @@ SkinnedVis::SkinnedVis ()
 
 void SkinnedVis::clear ()
 {
+    if (m_frames_painted || m_frames_skipped)
+        AUDDBG ("Visualizer: %d frames painted, %d skipped.\n", m_frames_painted, m_frames_skipped);
+
+    m_frames_painted = m_frames_skipped = 0;
+
     m_active = false;
-    m_voiceprint_advance = false;
 
     memset (m_data, 0, sizeof m_data);
     memset (m_peak, 0, sizeof m_peak);
@@ -302,10 +303,12 @@ void SkinnedVis::render (const unsigned char * data)
     }
     else if (config.vis_type == VIS_VOICEPRINT)
     {
-        for (int i = 0; i < 16; i ++)
-            m_data[i] = data[15 - i];
+        /* scroll by one column per update, however often it is painted */
+        memmove (m_voiceprint_data, m_voiceprint_data + 1, sizeof
+         m_voiceprint_data - 1);
 
-        m_voiceprint_advance = true;
+        for (int y = 0; y < 16; y ++)
+            m_voiceprint_data[76 * y + 75] = data[15 - y];
     }
     else
     {
@@ -314,5 +317,19 @@ void SkinnedVis::render (const unsigned char * data)
     }
 
     m_active = true;
-    draw_now ();
+    queue_frame ();
+}
+
+void SkinnedVis::queue_frame ()
+{
+    /* updates arriving before the pending paint are painted together with
+     * it; nothing is queued while the widget is off screen (shaded) */
+    if (m_frame_queued || ! isVisible ())
+    {
+        m_frames_skipped ++;
+        return;
+    }
+
+    m_frame_queued = true;
+    queue_draw ();
 }
@@ -23,6 +23,8 @@
 #include "plugin.h"
 #include "skins_cfg.h"
 
+#include <QWindow>
+
 void Window::apply_shape ()
 {
     QRegion * mask = m_is_shaded ? m_sshape.get () : m_shape.get ();
@@ -149,6 +151,13 @@ void Window::set_shaded (bool shaded)
     apply_shape ();
 }
 
+/* Where the platform tells us, a covered window is not exposed. */
+bool Window::is_visible ()
+{
+    QWindow * window = windowHandle ();
+    return isVisible () && ! isMinimized () && window && window->isExposed ();
+}
+
 void Window::put_widget (bool shaded, Widget * widget, int x, int y)
 {
     widget->setParent (shaded ? m_shaded : m_normal);
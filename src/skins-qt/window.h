@@ -43,6 +43,7 @@ public:
     void set_shapes (QRegion * shape, QRegion * sshape);
     bool is_shaded () { return m_is_shaded; }
     void set_shaded (bool shaded);
+    bool is_visible ();
     void put_widget (bool shaded, Widget * widget, int x, int y);
     void move_widget (bool shaded, Widget * widget, int x, int y);
 
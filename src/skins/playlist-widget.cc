@@ -130,11 +130,68 @@ void PlaylistWidget::cancel_all ()
     popup_hide ();
 }
 
+/* Laying out text is the costliest part of drawing, so the layouts of
+ * the most recently drawn strings are kept until the font changes. */
+#define TEXT_CACHE_MAX 512
+
+const TextLayout & PlaylistWidget::get_text (const String & text, int width,
+ PangoAlignment align)
+{
+    TextKey key = {text ? text : String (""), width, align};
+    TextLayout * cached = m_texts.lookup (key);
+
+    if (! cached)
+    {
+        /* drop the least recently used layout */
+        if (m_texts.n_items () >= TEXT_CACHE_MAX)
+        {
+            const TextKey * oldest = nullptr;
+            unsigned oldest_used = 0;
+
+            m_texts.iterate ([&] (const TextKey & k, TextLayout & l)
+            {
+                if (! oldest || l.used < oldest_used)
+                {
+                    oldest = & k;
+                    oldest_used = l.used;
+                }
+            });
+
+            TextKey old_key = * oldest;
+            m_texts.remove (old_key);
+        }
+
+        PangoLayout * layout = gtk_widget_create_pango_layout (gtk_dr (), key.text);
+        pango_layout_set_font_description (layout, m_font.get ());
+
+        if (width >= 0)
+        {
+            pango_layout_set_width (layout, PANGO_SCALE * width);
+            pango_layout_set_alignment (layout, align);
+            pango_layout_set_ellipsize (layout, (align == PANGO_ALIGN_CENTER) ?
+             PANGO_ELLIPSIZE_MIDDLE : PANGO_ELLIPSIZE_END);
+        }
+
+        PangoRectangle rect;
+        pango_layout_get_pixel_extents (layout, nullptr, & rect);
+
+        cached = m_texts.add (key, {SmartPtr<PangoLayout, unref_layout> (layout), rect.width, 0});
+    }
+
+    cached->used = ++ m_text_counter;
+    return * cached;
+}
+
+void PlaylistWidget::show_text (cairo_t * cr, const TextLayout & text, int x, int y)
+{
+    cairo_move_to (cr, x, y);
+    pango_cairo_show_layout (cr, text.layout.get ());
+}
+
 void PlaylistWidget::draw (cairo_t * cr)
 {
     int active_entry = m_playlist.get_position ();
     int left = 3, right = 3;
-    PangoLayout * layout;
     int width;
 
     /* background */
@@ -146,16 +203,10 @@ void PlaylistWidget::draw (cairo_t * cr)
 
     if (m_offset)
     {
-        layout = gtk_widget_create_pango_layout (gtk_dr (), m_title_text);
-        pango_layout_set_font_description (layout, m_font.get ());
-        pango_layout_set_width (layout, PANGO_SCALE * (m_width - left - right));
-        pango_layout_set_alignment (layout, PANGO_ALIGN_CENTER);
-        pango_layout_set_ellipsize (layout, PANGO_ELLIPSIZE_MIDDLE);
+        auto & text = get_text (m_title_text, m_width - left - right, PANGO_ALIGN_CENTER);
 
-        cairo_move_to (cr, left, 0);
         set_cairo_color (cr, skin.colors[SKIN_PLEDIT_NORMAL]);
-        pango_cairo_show_layout (cr, layout);
-        g_object_unref (layout);
+        show_text (cr, text, left, 0);
     }
 
     /* selection highlight */
@@ -181,18 +232,12 @@ void PlaylistWidget::draw (cairo_t * cr)
             char buf[16];
             snprintf (buf, sizeof buf, "%d.", 1 + i);
 
-            layout = gtk_widget_create_pango_layout (gtk_dr (), buf);
-            pango_layout_set_font_description (layout, m_font.get ());
-
-            PangoRectangle rect;
-            pango_layout_get_pixel_extents (layout, nullptr, & rect);
-            width = aud::max (width, rect.width);
+            auto & text = get_text (String (buf));
+            width = aud::max (width, text.width);
 
-            cairo_move_to (cr, left, m_offset + m_row_height * (i - m_first));
             set_cairo_color (cr, skin.colors[(i == active_entry) ?
              SKIN_PLEDIT_CURRENT : SKIN_PLEDIT_NORMAL]);
-            pango_cairo_show_layout (cr, layout);
-            g_object_unref (layout);
+            show_text (cr, text, left, m_offset + m_row_height * (i - m_first));
         }
 
         left += width + 4;
@@ -209,18 +254,12 @@ void PlaylistWidget::draw (cairo_t * cr)
         if (len < 0)
             continue;
 
-        layout = gtk_widget_create_pango_layout (gtk_dr (), str_format_time (len));
-        pango_layout_set_font_description (layout, m_font.get ());
-
-        PangoRectangle rect;
-        pango_layout_get_pixel_extents (layout, nullptr, & rect);
-        width = aud::max (width, rect.width);
+        auto & text = get_text (String (str_format_time (len)));
+        width = aud::max (width, text.width);
 
-        cairo_move_to (cr, m_width - right - rect.width, m_offset + m_row_height * (i - m_first));
         set_cairo_color (cr, skin.colors[(i == active_entry) ?
          SKIN_PLEDIT_CURRENT : SKIN_PLEDIT_NORMAL]);
-        pango_cairo_show_layout (cr, layout);
-        g_object_unref (layout);
+        show_text (cr, text, m_width - right - text.width, m_offset + m_row_height * (i - m_first));
     }
 
     right += width + 6;
@@ -240,19 +279,13 @@ void PlaylistWidget::draw (cairo_t * cr)
             char buf[16];
             snprintf (buf, sizeof buf, "(#%d)", 1 + pos);
 
-            layout = gtk_widget_create_pango_layout (gtk_dr (), buf);
-            pango_layout_set_font_description (layout, m_font.get ());
+            auto & text = get_text (String (buf));
+            width = aud::max (width, text.width);
 
-            PangoRectangle rect;
-            pango_layout_get_pixel_extents (layout, nullptr, & rect);
-            width = aud::max (width, rect.width);
-
-            cairo_move_to (cr, m_width - right - rect.width, m_offset +
-             m_row_height * (i - m_first));
             set_cairo_color (cr, skin.colors[(i == active_entry) ?
              SKIN_PLEDIT_CURRENT : SKIN_PLEDIT_NORMAL]);
-            pango_cairo_show_layout (cr, layout);
-            g_object_unref (layout);
+            show_text (cr, text, m_width - right - text.width, m_offset +
+             m_row_height * (i - m_first));
         }
 
         right += width + 6;
@@ -265,16 +298,11 @@ void PlaylistWidget::draw (cairo_t * cr)
         Tuple tuple = m_playlist.entry_tuple (i, Playlist::NoWait);
         String title = tuple.get_str (Tuple::FormattedTitle);
 
-        layout = gtk_widget_create_pango_layout (gtk_dr (), title);
-        pango_layout_set_font_description (layout, m_font.get ());
-        pango_layout_set_width (layout, PANGO_SCALE * (m_width - left - right));
-        pango_layout_set_ellipsize (layout, PANGO_ELLIPSIZE_END);
+        auto & text = get_text (title, m_width - left - right);
 
-        cairo_move_to (cr, left, m_offset + m_row_height * (i - m_first));
         set_cairo_color (cr, skin.colors[(i == active_entry) ?
          SKIN_PLEDIT_CURRENT : SKIN_PLEDIT_NORMAL]);
-        pango_cairo_show_layout (cr, layout);
-        g_object_unref (layout);
+        show_text (cr, text, left, m_offset + m_row_height * (i - m_first));
     }
 
     /* focus rectangle */
@@ -326,6 +354,7 @@ void PlaylistWidget::resize (int width, int height)
 void PlaylistWidget::set_font (const char * font)
 {
     m_font.capture (pango_font_description_from_string (font));
+    m_texts.clear ();
 
     PangoLayout * layout = gtk_widget_create_pango_layout (gtk_dr (), "A");
     pango_layout_set_font_description (layout, m_font.get ());
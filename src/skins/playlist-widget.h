@@ -30,6 +30,7 @@
 
 #include <libaudcore/hook.h>
 #include <libaudcore/mainloop.h>
+#include <libaudcore/multihash.h>
 #include <libaudcore/playlist.h>
 
 #include "widget.h"
@@ -38,6 +39,29 @@ class PlaylistSlider;
 
 typedef SmartPtr<PangoFontDescription, pango_font_description_free> PangoFontDescPtr;
 
+static inline void unref_layout (PangoLayout * layout)
+    { g_object_unref (layout); }
+
+/* text shaped by Pango, reused across redraws */
+struct TextKey
+{
+    String text;
+    int width;  /* ellipsized to fit, or -1 */
+    PangoAlignment align;
+
+    bool operator== (const TextKey & b) const
+        { return text == b.text && width == b.width && align == b.align; }
+    unsigned hash () const
+        { return text.hash () + 31 * (unsigned) width + (unsigned) align; }
+};
+
+struct TextLayout
+{
+    SmartPtr<PangoLayout, unref_layout> layout;
+    int width;  /* in pixels */
+    unsigned used;
+};
+
 class PlaylistWidget : public Widget
 {
 public:
@@ -65,6 +89,10 @@ private:
     void update_title ();
     void calc_layout ();
 
+    const TextLayout & get_text (const String & text, int width = -1,
+     PangoAlignment align = PANGO_ALIGN_LEFT);
+    void show_text (cairo_t * cr, const TextLayout & text, int x, int y);
+
     int calc_position (int y) const;
     int adjust_position (bool relative, int position) const;
 
@@ -89,6 +117,9 @@ private:
     PangoFontDescPtr m_font;
     String m_title_text;
 
+    SimpleHash<TextKey, TextLayout> m_texts;
+    unsigned m_text_counter = 0;
+
     Playlist m_playlist;
     int m_length = 0;
     int m_width = 0, m_height = 0, m_row_height = 1, m_offset = 0, m_rows = 0, m_first = 0;
@@ -95,6 +95,7 @@ EXPORT SkinnedUI aud_plugin_instance;
 
 static String user_skin_dir;
 static String skin_thumb_dir;
+static String skin_cache_dir;
 
 const char * skins_get_user_skin_dir ()
 {
@@ -112,6 +113,14 @@ const char * skins_get_skin_thumb_dir ()
     return skin_thumb_dir;
 }
 
+const char * skins_get_skin_cache_dir ()
+{
+    if (! skin_cache_dir)
+        skin_cache_dir = String (filename_build ({g_get_user_cache_dir (), "audacious", "skins"}));
+
+    return skin_cache_dir;
+}
+
 static bool load_initial_skin ()
 {
     String path = aud_get_str ("skins", "skin");
@@ -199,6 +208,7 @@ void SkinnedUI::cleanup ()
 
     user_skin_dir = String ();
     skin_thumb_dir = String ();
+    skin_cache_dir = String ();
 }
 
 void skins_restart ()
@@ -23,6 +23,7 @@
 
 const char * skins_get_user_skin_dir ();
 const char * skins_get_skin_thumb_dir ();
+const char * skins_get_skin_cache_dir ();
 
 void skins_restart ();
 void skins_close ();
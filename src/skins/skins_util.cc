@@ -24,12 +24,15 @@
  */
 
 #include <errno.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#include <mutex>
 
 #include <glib/gstdio.h>
+#include <zlib.h>
 
 #include <libaudcore/audstrings.h>
 #include <libaudcore/i18n.h>
@@ -46,9 +49,13 @@
 #define DIRMODE (S_IRWXU)
 #endif
 
+/* also called from the skin preview threads */
 StringBuf find_file_case_path (const char * folder, const char * basename)
 {
     static SimpleHash<String, Index<String>> cache;
+    static std::mutex mutex;
+
+    std::lock_guard<std::mutex> lock (mutex);
 
     String key (folder);
     Index<String> * list = cache.lookup (key);
@@ -83,20 +90,6 @@ VFSFile open_local_file_nocase (const char * folder, const char * basename)
     return path ? VFSFile (path, "r") : VFSFile ();
 }
 
-StringBuf skin_pixmap_locate (const char * folder, const char * basename, const char * altname)
-{
-    static const char * const exts[] = {".bmp", ".png", ".xpm"};
-
-    for (const char * ext : exts)
-    {
-        StringBuf name = find_file_case_path (folder, str_concat ({basename, ext}));
-        if (name)
-            return name.settle ();
-    }
-
-    return altname ? skin_pixmap_locate (folder, altname) : StringBuf ();
-}
-
 char * text_parse_line (char * text)
 {
     char * newline = strchr (text, '\n');
@@ -116,8 +109,6 @@ enum ArchiveType {
     ARCHIVE_TBZ2
 };
 
-typedef StringBuf (* ArchiveExtractFunc) (const char *, const char *);
-
 struct ArchiveExtensionType {
     ArchiveType type;
     const char *ext;
@@ -133,69 +124,6 @@ static ArchiveExtensionType archive_extensions[] = {
     {ARCHIVE_TBZ2, ".bz2"}
 };
 
-static StringBuf archive_extract_tar (const char * archive, const char * dest);
-static StringBuf archive_extract_zip (const char * archive, const char * dest);
-static StringBuf archive_extract_tgz (const char * archive, const char * dest);
-static StringBuf archive_extract_tbz2 (const char * archive, const char * dest);
-
-static ArchiveExtractFunc archive_extract_funcs[] = {
-    nullptr,
-    archive_extract_tar,
-    archive_extract_tgz,
-    archive_extract_zip,
-    archive_extract_tbz2
-};
-
-/* FIXME: these functions can be generalised into a function using a
- * command lookup table */
-
-static const char * get_tar_command ()
-{
-    static const char * command = nullptr;
-
-    if (! command)
-    {
-        if (! (command = getenv("TARCMD")))
-            command = "tar";
-    }
-
-    return command;
-}
-
-static const char * get_unzip_command ()
-{
-    static const char * command = nullptr;
-
-    if (! command)
-    {
-        if (! (command = getenv("UNZIPCMD")))
-            command = "unzip";
-    }
-
-    return command;
-}
-
-static StringBuf archive_extract_tar (const char * archive, const char * dest)
-{
-    return str_printf ("%s >/dev/null xf \"%s\" -C %s", get_tar_command (), archive, dest);
-}
-
-static StringBuf archive_extract_zip (const char * archive, const char * dest)
-{
-    return str_printf ("%s >/dev/null -o -j \"%s\" -d %s", get_unzip_command (), archive, dest);
-}
-
-static StringBuf archive_extract_tgz (const char * archive, const char * dest)
-{
-    return str_printf ("%s >/dev/null xzf \"%s\" -C %s", get_tar_command (), archive, dest);
-}
-
-static StringBuf archive_extract_tbz2 (const char * archive, const char * dest)
-{
-    return str_printf ("bzip2 -dc \"%s\" | %s >/dev/null xf - -C %s", archive,
-     get_tar_command (), dest);
-}
-
 static ArchiveType archive_get_type (const char * filename)
 {
     for (auto & ext : archive_extensions)
@@ -253,49 +181,316 @@ static StringBuf escape_shell_chars (const char * string)
     return escaped;
 }
 
-/**
- * Decompresses the archive "filename" to a temporary directory,
- * returns the path to the temp dir, or nullptr if failed
- */
-StringBuf archive_decompress (const char * filename)
+static unsigned get16 (const unsigned char * p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t get32 (const unsigned char * p)
+{
+    return get16 (p) | ((uint32_t) get16 (p + 2) << 16);
+}
+
+/* Directories are dropped, as "unzip -j" used to do, so that a skin packed
+ * inside a folder loads the same as one that is not. */
+static String member_name (const char * path, int len)
+{
+    const char * base = path;
+
+    for (int i = 0; i < len; i ++)
+    {
+        if (path[i] == '/' || path[i] == '\\')
+            base = path + i + 1;
+    }
+
+    StringBuf name = str_copy (base, path + len - base);
+
+    for (char * c = name; * c; c ++)
+        * c = g_ascii_tolower (* c);
+
+    return String (name);
+}
+
+static bool inflate_data (const void * data, int64_t len, int window_bits,
+ Index<char> & out)
+{
+    const int chunk = 65536;
+
+    z_stream stream {};
+    if (inflateInit2 (& stream, window_bits) != Z_OK)
+        return false;
+
+    stream.next_in = (Bytef *) data;
+    stream.avail_in = len;
+
+    bool ended = false;
+    int ret;
+
+    do
+    {
+        int pos = out.len ();
+        out.resize (pos + chunk);
+
+        stream.next_out = (Bytef *) & out[pos];
+        stream.avail_out = chunk;
+
+        ret = inflate (& stream, Z_NO_FLUSH);
+        out.resize (pos + chunk - stream.avail_out);
+
+        /* a gzip file may consist of several members */
+        if (ret == Z_STREAM_END && stream.avail_in && window_bits > MAX_WBITS)
+        {
+            ended = true;
+            ret = inflateReset (& stream);
+        }
+    }
+    while (ret == Z_OK);
+
+    inflateEnd (& stream);
+    return ret == Z_STREAM_END || ended;
+}
+
+static bool zip_read (const Index<char> & buf, SkinFileHash & files, ArchiveFilter filter)
+{
+    auto data = (const unsigned char *) buf.begin ();
+    int64_t len = buf.len ();
+
+    /* the end of central directory record is followed by a comment of up
+     * to 64 KiB */
+    int64_t end = len - 22;
+    int64_t min_end = aud::max (len - 22 - 65535, (int64_t) 0);
+
+    while (end >= min_end && get32 (data + end) != 0x06054b50)
+        end --;
+
+    if (end < min_end)
+        return false;
+
+    unsigned n_entries = get16 (data + end + 10);
+    int64_t pos = get32 (data + end + 16);
+
+    for (unsigned i = 0; i < n_entries; i ++)
+    {
+        if (pos + 46 > end || get32 (data + pos) != 0x02014b50 ||
+         pos + 46 + get16 (data + pos + 28) > end)
+            return false;
+
+        unsigned flags = get16 (data + pos + 8);
+        unsigned method = get16 (data + pos + 10);
+        int64_t size = get32 (data + pos + 20);
+        unsigned name_len = get16 (data + pos + 28);
+        int64_t local = get32 (data + pos + 42);
+
+        String name = member_name ((const char *) data + pos + 46, name_len);
+        pos += 46 + name_len + get16 (data + pos + 30) + get16 (data + pos + 32);
+
+        /* skip directories and encrypted files */
+        if (! name[0] || (flags & 1) || (filter && ! filter (name)))
+            continue;
+
+        if (local + 30 > len || get32 (data + local) != 0x04034b50)
+            return false;
+
+        int64_t start = local + 30 + get16 (data + local + 26) + get16 (data + local + 28);
+        if (start + size > len)
+            return false;
+
+        Index<char> contents;
+
+        if (method == 0)
+            contents.insert ((const char *) data + start, 0, size);
+        else if (method != 8 || ! inflate_data (data + start, size, -MAX_WBITS, contents))
+        {
+            AUDWARN ("Unable to decompress %s (method %u)\n", (const char *) name, method);
+            continue;
+        }
+
+        files.add (name, std::move (contents));
+    }
+
+    return true;
+}
+
+static int64_t tar_number (const unsigned char * field, int len)
+{
+    int64_t val = 0;
+
+    for (int i = 0; i < len && field[i]; i ++)
+    {
+        if (field[i] >= '0' && field[i] <= '7')
+            val = val * 8 + (field[i] - '0');
+        else if (field[i] != ' ')
+            break;
+    }
+
+    return val;
+}
+
+static bool tar_read (const Index<char> & buf, SkinFileHash & files, ArchiveFilter filter)
+{
+    auto data = (const unsigned char *) buf.begin ();
+    int64_t len = buf.len ();
+    int64_t pos = 0;
+    String long_name;
+
+    /* the archive ends with an empty header */
+    while (pos + 512 <= len && data[pos])
+    {
+        const char * header = (const char *) data + pos;
+        int64_t size = tar_number (data + pos + 124, 12);
+        char type = header[156];
+
+        pos += 512;
+        if (size > len - pos)
+            return false;
+
+        const char * contents = (const char *) data + pos;
+        pos += (size + 511) & ~(int64_t) 511;
+
+        /* GNU extension: the name of the next member */
+        if (type == 'L')
+        {
+            long_name = member_name (contents, strnlen (contents, size));
+            continue;
+        }
+
+        String name = long_name ? long_name : member_name (header, strnlen (header, 100));
+        long_name = String ();
+
+        if ((type != '0' && type != 0) || ! name[0] || (filter && ! filter (name)))
+            continue;
+
+        Index<char> file;
+        file.insert (contents, 0, size);
+        files.add (name, std::move (file));
+    }
+
+    return true;
+}
+
+static Index<char> read_command_output (const char * cmd)
+{
+    Index<char> out;
+
+    FILE * pipe = popen (cmd, "r");
+    if (! pipe)
+        return out;
+
+    int64_t got;
+    do
+    {
+        int pos = out.len ();
+        out.resize (pos + 65536);
+        got = fread (& out[pos], 1, 65536, pipe);
+        out.resize (pos + got);
+    }
+    while (got > 0);
+
+    if (pclose (pipe) != 0)
+        out.clear ();
+
+    return out;
+}
+
+bool archive_read (const char * filename, SkinFileHash & files, ArchiveFilter filter)
 {
     ArchiveType type = archive_get_type (filename);
-    if (type == ARCHIVE_UNKNOWN)
-        return StringBuf ();
+    Index<char> buf;
+
+    if (type == ARCHIVE_TBZ2)
+    {
+        /* there is no bzip2 decoder at hand; the command line tool only
+         * decompresses, and the tar file is read here */
+        StringBuf escaped_filename = escape_shell_chars (filename);
+        StringBuf cmd = str_printf ("bzip2 -dc \"%s\"", (const char *) escaped_filename);
 
-    StringBuf tmpdir = filename_build ({g_get_tmp_dir (), "audacious.XXXXXX"});
-    if (! g_mkdtemp (tmpdir))
+        AUDDBG ("Executing \"%s\"\n", (const char *) cmd);
+        buf = read_command_output (cmd);
+    }
+    else if (type != ARCHIVE_UNKNOWN)
     {
-        AUDWARN ("Error creating %s: %s\n", (const char *) tmpdir, strerror (errno));
-        return StringBuf ();
+        VFSFile file (filename, "r");
+        if (file)
+            buf = file.read_all ();
     }
 
-    StringBuf escaped_filename = escape_shell_chars (filename);
-    StringBuf cmd = archive_extract_funcs[type] (escaped_filename, tmpdir);
+    if (! buf.len ())
+        return false;
 
-    AUDDBG ("Executing \"%s\"\n", (const char *) cmd);
-    int ret = system (cmd);
-    if (ret != 0)
+    if (type == ARCHIVE_TGZ)
     {
-        AUDDBG ("Command \"%s\" returned error %d\n", (const char *) cmd, ret);
-        return StringBuf ();
+        Index<char> tar;
+        if (! inflate_data (buf.begin (), buf.len (), 16 + MAX_WBITS, tar))
+        {
+            AUDWARN ("Unable to decompress %s\n", filename);
+            return false;
+        }
+
+        buf = std::move (tar);
     }
 
-    return tmpdir;
+    bool success = (type == ARCHIVE_ZIP) ? zip_read (buf, files, filter) :
+     tar_read (buf, files, filter);
+
+    if (! success)
+        AUDWARN ("Corrupt archive: %s\n", filename);
+
+    return success;
 }
 
-static void del_directory_func (const char * path, const char *)
+bool SkinFiles::open (const char * path, ArchiveFilter filter)
 {
-    if (g_file_test (path, G_FILE_TEST_IS_DIR))
-        del_directory (path);
-    else
-        g_unlink (path);
+    if (file_is_archive (path))
+        return archive_read (path, m_files, filter);
+
+    m_folder = String (path);
+    return true;
 }
 
-void del_directory (const char * path)
+const Index<char> * SkinFiles::read (const char * name)
 {
-    dir_foreach (path, del_directory_func);
-    g_rmdir (path);
+    String key = member_name (name, strlen (name));
+    Index<char> * data = m_files.lookup (key);
+
+    if (data || ! m_folder)
+        return data;
+
+    VFSFile file = open_local_file_nocase (m_folder, name);
+    if (! file)
+        return nullptr;
+
+    return m_files.add (key, file.read_all ());
+}
+
+const Index<char> * SkinFiles::read_pixmap (const char * basename, const char * altname)
+{
+    static const char * const exts[] = {".bmp", ".png", ".xpm"};
+
+    for (const char * ext : exts)
+    {
+        const Index<char> * data = read (str_concat ({basename, ext}));
+        if (data)
+            return data;
+    }
+
+    return altname ? read_pixmap (altname) : nullptr;
+}
+
+VFSFile SkinFiles::open_file (const char * name)
+{
+    if (m_folder)
+        return open_local_file_nocase (m_folder, name);
+
+    const Index<char> * data = read (name);
+    if (! data)
+        return VFSFile ();
+
+    VFSFile file = VFSFile::tmpfile ();
+    if (! file || file.fwrite (data->begin (), 1, data->len ()) != data->len () ||
+     file.fseek (0, VFS_SEEK_SET) < 0)
+        return VFSFile ();
+
+    return file;
 }
 
 Index<int> string_to_int_array (const char * str)
@@ -340,6 +535,36 @@ bool dir_foreach (const char * path, DirForeachFunc func)
     return true;
 }
 
+bool skin_get_stamp (const char * path, SkinStamp & stamp)
+{
+    GStatBuf info;
+    if (g_stat (path, & info) < 0)
+        return false;
+
+    stamp = {(int64_t) info.st_mtime, (int64_t) info.st_size};
+
+    if (! S_ISDIR (info.st_mode))
+        return true;
+
+    /* editing a file does not touch the directory itself */
+    GDir * dir = g_dir_open (path, 0, nullptr);
+    if (! dir)
+        return false;
+
+    const char * name;
+    while ((name = g_dir_read_name (dir)))
+    {
+        if (g_stat (filename_build ({path, name}), & info) == 0)
+        {
+            stamp.mtime = aud::max (stamp.mtime, (int64_t) info.st_mtime);
+            stamp.size += info.st_size;
+        }
+    }
+
+    g_dir_close (dir);
+    return true;
+}
+
 void make_directory (const char * path)
 {
     if (g_mkdir_with_parents (path, DIRMODE) != 0)
@@ -21,11 +21,15 @@
  * using our public API to be a derived work.
  */
 
+#include <inttypes.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
+#include <thread>
 
 #include <libaudcore/audstrings.h>
 #include <libaudcore/i18n.h>
+#include <libaudcore/mainloop.h>
 #include <libaudcore/runtime.h>
 #include <libaudgui/libaudgui-gtk.h>
 
@@ -33,6 +37,7 @@
 #include "skin.h"
 #include "skinselector.h"
 #include "skins_util.h"
+#include "surface.h"
 #include "view.h"
 
 enum SkinViewCols {
@@ -44,62 +49,263 @@ enum SkinViewCols {
 
 struct SkinNode {
     String name, desc, path;
+    bool preview_requested;
 };
 
 static Index<SkinNode> skinlist;
 
 static void skin_view_on_cursor_changed (GtkTreeView * treeview);
 
+/*
+ * Previews are made on worker threads, and only for the rows that are on
+ * screen (and the page below them), so that opening the settings does not
+ * wait for every skin to be read.  Only the main bitmap is extracted from
+ * an archive.  The unscaled previews are cached as PNG files named after a
+ * hash of the skin path; the size and modification time of the skin are
+ * saved in the file and checked when it is loaded.
+ */
+
+#define PREVIEW_MAX_THREADS 4
+
+/* size of main.bmp */
+#define PREVIEW_WIDTH 275
+#define PREVIEW_HEIGHT 116
+
+struct PreviewJob
+{
+    int row;
+    unsigned serial;
+    String path, thumbname;
+    int size;
+    AudguiPixbuf thumb;
+};
+
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+static pthread_t threads[PREVIEW_MAX_THREADS];
+static int n_threads;
+static bool threads_quit;
+
+static Index<SmartPtr<PreviewJob>> pending, finished;
+static QueuedFunc deliver_func;
+
+/* the current list; results from an earlier list are dropped */
+static GtkTreeView * preview_view;
+static unsigned preview_serial;
+
+static bool is_main_pixmap (const char * name)
+{
+    return ! strcmp (name, "main.bmp") || ! strcmp (name, "main.png") ||
+     ! strcmp (name, "main.xpm");
+}
+
 static AudguiPixbuf skin_get_preview (const char * path)
 {
     AudguiPixbuf preview;
 
-    StringBuf archive_path;
-    if (file_is_archive (path))
+    SkinFiles files;
+    const Index<char> * data = files.open (path, is_main_pixmap) ?
+     files.read_pixmap ("main") : nullptr;
+
+    if (data)
+        preview.capture (pixbuf_new_from_data (* data));
+
+    return preview;
+}
+
+static bool thumb_is_current (GdkPixbuf * thumb, const SkinStamp & stamp)
+{
+    const char * mtime = gdk_pixbuf_get_option (thumb, "tEXt::Thumb::MTime");
+    const char * size = gdk_pixbuf_get_option (thumb, "tEXt::Thumb::Size");
+
+    return mtime && size && g_ascii_strtoll (mtime, nullptr, 10) == stamp.mtime &&
+     g_ascii_strtoll (size, nullptr, 10) == stamp.size;
+}
+
+static void preview_process (PreviewJob & job)
+{
+    /* for a directory, this looks at every file in it */
+    SkinStamp stamp;
+    if (! skin_get_stamp (job.path, stamp))
+        return;
+
+    if (g_file_test (job.thumbname, G_FILE_TEST_EXISTS))
     {
-        archive_path = archive_decompress (path);
-        if (! archive_path)
-            return preview;
+        job.thumb.capture (gdk_pixbuf_new_from_file (job.thumbname, nullptr));
 
-        path = archive_path;
+        if (job.thumb && ! thumb_is_current (job.thumb.get (), stamp))
+            job.thumb.clear ();
     }
 
-    StringBuf preview_path = skin_pixmap_locate (path, "main");
-    if (preview_path)
-        preview.capture (gdk_pixbuf_new_from_file (preview_path, nullptr));
+    if (! job.thumb)
+    {
+        job.thumb = skin_get_preview (job.path);
 
-    if (archive_path)
-        del_directory (archive_path);
+        if (job.thumb)
+        {
+            StringBuf mtime = str_printf ("%" PRId64, stamp.mtime);
+            StringBuf size = str_printf ("%" PRId64, stamp.size);
 
-    return preview;
+            gdk_pixbuf_save (job.thumb.get (), job.thumbname, "png", nullptr,
+             "tEXt::Thumb::MTime", (const char *) mtime,
+             "tEXt::Thumb::Size", (const char *) size, nullptr);
+        }
+    }
+
+    if (job.thumb)
+        audgui_pixbuf_scale_within (job.thumb, job.size);
 }
 
-static AudguiPixbuf skin_get_thumbnail (const char * path)
+static void preview_deliver (void *)
 {
-    StringBuf base = filename_get_base (path);
-    base.insert (-1, ".png");
+    pthread_mutex_lock (& mutex);
+    Index<SmartPtr<PreviewJob>> jobs = std::move (finished);
+    pthread_mutex_unlock (& mutex);
 
-    StringBuf thumbname = filename_build ({skins_get_skin_thumb_dir (), base});
-    AudguiPixbuf thumb;
+    if (! preview_view)
+        return;
 
-    if (g_file_test (thumbname, G_FILE_TEST_EXISTS))
-        thumb.capture (gdk_pixbuf_new_from_file (thumbname, nullptr));
+    GtkTreeModel * model = gtk_tree_view_get_model (preview_view);
 
-    if (! thumb)
+    for (auto & job : jobs)
     {
-        thumb = skin_get_preview (path);
+        GtkTreeIter iter;
+        if (job->serial != preview_serial || ! job->thumb ||
+         ! gtk_tree_model_iter_nth_child (model, & iter, nullptr, job->row))
+            continue;
+
+        gtk_list_store_set ((GtkListStore *) model, & iter,
+         SKIN_VIEW_COL_PREVIEW, job->thumb.get (), -1);
+    }
+}
+
+static void * preview_worker (void *)
+{
+    pthread_mutex_lock (& mutex);
+
+    while (! threads_quit)
+    {
+        if (! pending.len ())
+        {
+            pthread_cond_wait (& cond, & mutex);
+            continue;
+        }
 
-        if (thumb)
+        SmartPtr<PreviewJob> job = std::move (pending[0]);
+        pending.remove (0, 1);
+
+        pthread_mutex_unlock (& mutex);
+        preview_process (* job);
+        pthread_mutex_lock (& mutex);
+
+        finished.append (std::move (job));
+        deliver_func.queue (preview_deliver, nullptr);
+    }
+
+    pthread_mutex_unlock (& mutex);
+    return nullptr;
+}
+
+/* called with the mutex locked */
+static void preview_start_threads ()
+{
+    if (n_threads)
+        return;
+
+    int want = aud::clamp ((int) std::thread::hardware_concurrency (), 1,
+     PREVIEW_MAX_THREADS);
+
+    threads_quit = false;
+
+    while (n_threads < want &&
+     pthread_create (& threads[n_threads], nullptr, preview_worker, nullptr) == 0)
+        n_threads ++;
+}
+
+static void preview_cleanup ()
+{
+    pthread_mutex_lock (& mutex);
+
+    int was_running = n_threads;
+    threads_quit = true;
+    n_threads = 0;
+    pthread_cond_broadcast (& cond);
+
+    pthread_mutex_unlock (& mutex);
+
+    for (int i = 0; i < was_running; i ++)
+        pthread_join (threads[i], nullptr);
+
+    pending.clear ();
+    finished.clear ();
+    deliver_func.stop ();
+
+    preview_view = nullptr;
+}
+
+static void skin_view_request_previews (GtkTreeView * treeview)
+{
+    GtkTreePath * start, * end;
+    if (! gtk_tree_view_get_visible_range (treeview, & start, & end))
+        return;
+
+    int first = gtk_tree_path_get_indices (start)[0];
+    int last = gtk_tree_path_get_indices (end)[0];
+    gtk_tree_path_free (start);
+    gtk_tree_path_free (end);
+
+    /* a page ahead, so that scrolling down finds the previews ready */
+    last = aud::min (last + (last - first + 1), skinlist.len () - 1);
+
+    int size = audgui_get_dpi () * 3 / 2;
+    bool added = false;
+
+    pthread_mutex_lock (& mutex);
+
+    /* rows that were scrolled past before their turn are requested again
+     * when they come back into view */
+    for (int i = pending.len (); i --; )
+    {
+        int row = pending[i]->row;
+        if (row < first || row > last)
         {
-            make_directory (skins_get_skin_thumb_dir ());
-            gdk_pixbuf_save (thumb.get (), thumbname, "png", nullptr, nullptr);
+            skinlist[row].preview_requested = false;
+            pending.remove (i, 1);
         }
     }
 
-    if (thumb)
-        audgui_pixbuf_scale_within (thumb, audgui_get_dpi () * 3 / 2);
+    for (int row = first; row <= last; row ++)
+    {
+        SkinNode & node = skinlist[row];
+
+        if (node.preview_requested)
+            continue;
+
+        node.preview_requested = true;
+
+        CharPtr hash (g_compute_checksum_for_string (G_CHECKSUM_MD5, node.path, -1));
+        StringBuf thumbname = filename_build ({skins_get_skin_thumb_dir (),
+         str_concat ({hash, ".png"})});
+
+        pending.append (SmartPtr<PreviewJob> (new PreviewJob {row, preview_serial,
+         node.path, String (thumbname), size}));
+
+        added = true;
+    }
+
+    if (added)
+    {
+        preview_start_threads ();
+        pthread_cond_broadcast (& cond);
+    }
 
-    return thumb;
+    pthread_mutex_unlock (& mutex);
+}
+
+static gboolean skin_view_expose (GtkWidget * treeview)
+{
+    skin_view_request_previews ((GtkTreeView *) treeview);
+    return false;
 }
 
 static void scan_skindir_func (const char * path, const char * basename)
@@ -144,6 +350,14 @@ void skin_view_update (GtkTreeView * treeview)
     auto store = (GtkListStore *) gtk_tree_view_get_model (treeview);
     gtk_list_store_clear (store);
 
+    pthread_mutex_lock (& mutex);
+    pending.clear ();
+    preview_serial ++;
+    pthread_mutex_unlock (& mutex);
+
+    preview_view = treeview;
+    make_directory (skins_get_skin_thumb_dir ());
+
     skinlist_update ();
 
     String current_path = aud_get_str ("skins", "skin");
@@ -151,14 +365,12 @@ void skin_view_update (GtkTreeView * treeview)
 
     for (const SkinNode & node : skinlist)
     {
-        AudguiPixbuf thumbnail = skin_get_thumbnail (node.path);
         StringBuf formattedname = str_concat ({"<big><b>", node.name,
          "</b></big>\n<i>", node.desc, "</i>"});
 
         GtkTreeIter iter;
         gtk_list_store_append (store, & iter);
         gtk_list_store_set (store, & iter,
-         SKIN_VIEW_COL_PREVIEW, thumbnail.get (),
          SKIN_VIEW_COL_FORMATTEDNAME, (const char *) formattedname,
          SKIN_VIEW_COL_NAME, (const char *) node.name, -1);
 
@@ -212,7 +424,12 @@ void skin_view_realize (GtkTreeView * treeview)
     gtk_tree_view_column_set_spacing (column, 16);
     gtk_tree_view_append_column (treeview, column);
 
+    /* rows keep their height when the previews come in */
+    int size = audgui_get_dpi () * 3 / 2;
+
     GtkCellRenderer * renderer = gtk_cell_renderer_pixbuf_new ();
+    gtk_cell_renderer_set_fixed_size (renderer, size,
+     size * PREVIEW_HEIGHT / PREVIEW_WIDTH);
     gtk_tree_view_column_pack_start (column, renderer, false);
     gtk_tree_view_column_set_attributes (column, renderer, "pixbuf",
      SKIN_VIEW_COL_PREVIEW, nullptr);
@@ -227,4 +444,6 @@ void skin_view_realize (GtkTreeView * treeview)
 
     g_signal_connect (treeview, "cursor-changed",
      (GCallback) skin_view_on_cursor_changed, nullptr);
+    g_signal_connect (treeview, "expose-event", (GCallback) skin_view_expose, nullptr);
+    g_signal_connect (treeview, "destroy", (GCallback) preview_cleanup, nullptr);
 }
@@ -31,17 +31,34 @@ cairo_surface_t * surface_new (int w, int h)
     return cairo_image_surface_create (CAIRO_FORMAT_RGB24, w, h);
 }
 
-cairo_surface_t * surface_new_from_file (const char * name)
+GdkPixbuf * pixbuf_new_from_data (const Index<char> & data)
 {
+    GdkPixbufLoader * loader = gdk_pixbuf_loader_new ();
+
     GError * error = nullptr;
-    AudguiPixbuf p (gdk_pixbuf_new_from_file (name, & error));
+    bool success = gdk_pixbuf_loader_write (loader,
+     (const unsigned char *) data.begin (), data.len (), & error);
+
+    /* the loader must be closed even if writing failed */
+    success = gdk_pixbuf_loader_close (loader, success ? & error : nullptr) && success;
+
+    GdkPixbuf * pixbuf = success ? gdk_pixbuf_loader_get_pixbuf (loader) : nullptr;
 
-    if (error)
+    if (pixbuf)
+        g_object_ref (pixbuf);
+    else if (error)
     {
-        AUDERR ("Error loading %s: %s.\n", name, error->message);
+        AUDERR ("Error loading pixmap: %s.\n", error->message);
         g_error_free (error);
     }
 
+    g_object_unref (loader);
+    return pixbuf;
+}
+
+cairo_surface_t * surface_new_from_data (const Index<char> & data)
+{
+    AudguiPixbuf p (pixbuf_new_from_data (data));
     if (! p)
         return nullptr;
 
@@ -24,9 +24,13 @@
 
 #include <stdint.h>
 #include <cairo.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#include <libaudcore/index.h>
 
 cairo_surface_t * surface_new (int w, int h);
-cairo_surface_t * surface_new_from_file (const char * name);
+GdkPixbuf * pixbuf_new_from_data (const Index<char> & data);
+cairo_surface_t * surface_new_from_data (const Index<char> & data);
 uint32_t surface_get_pixel (cairo_surface_t * s, int x, int y);
 void surface_copy_rect (cairo_surface_t * a, int ax, int ay, int w, int h,
  cairo_surface_t * b, int bx, int by);
@@ -26,6 +26,7 @@
 
 #include <string.h>
 #include <libaudcore/objects.h>
+#include <libaudcore/runtime.h>
 
 #include "skins_cfg.h"
 #include "surface.h"
@@ -47,6 +48,12 @@ void SmallVis::draw (cairo_t * cr)
     uint32_t rgb[38 * 5];
     uint32_t * set;
 
+    if (m_frame_queued)
+    {
+        m_frame_queued = false;
+        m_frames_painted ++;
+    }
+
     RGB_SEEK (0, 0);
     for (int x = 0; x < 38 * 5; x ++)
         RGB_SET_INDEX (0);
@@ -190,6 +197,11 @@ SmallVis::SmallVis ()
 
 void SmallVis::clear ()
 {
+    if (m_frames_painted || m_frames_skipped)
+        AUDDBG ("Small visualizer: %d frames painted, %d skipped.\n", m_frames_painted, m_frames_skipped);
+
+    m_frames_painted = m_frames_skipped = 0;
+
     m_active = false;
     memset (m_data, 0, sizeof m_data);
     queue_draw ();
@@ -209,5 +221,19 @@ void SmallVis::render (const unsigned char * data)
     }
 
     m_active = true;
-    draw_now ();
+    queue_frame ();
+}
+
+void SmallVis::queue_frame ()
+{
+    /* updates arriving before the pending paint are painted together with
+     * it; nothing is queued while the widget is off screen (shaded) */
+    if (m_frame_queued || ! gtk_widget_is_drawable (gtk_dr ()))
+    {
+        m_frames_skipped ++;
+        return;
+    }
+
+    m_frame_queued = true;
+    queue_draw ();
 }
@@ -50,6 +50,22 @@ public:
     void render_freq (const float * freq);
 };
 
+/* while the main window is minimized or covered, the data is dropped
+ * without being painted */
+static void show_data (bool shaded, const unsigned char * data)
+{
+    bool visible = mainwin->is_visible ();
+
+    if (shaded && visible)
+        mainwin_svis->render (data);
+    else if (shaded)
+        mainwin_svis->skip_frame ();
+    else if (visible)
+        mainwin_vis->render (data);
+    else
+        mainwin_vis->skip_frame ();
+}
+
 void VisCallbacks::clear ()
 {
     mainwin_vis->clear ();
@@ -71,10 +87,7 @@ void VisCallbacks::render_mono_pcm (const float * pcm)
         data[i] = aud::clamp (val, 0, 16);
     }
 
-    if (aud_get_bool ("skins", "player_shaded"))
-        mainwin_svis->render (data);
-    else
-        mainwin_vis->render (data);
+    show_data (aud_get_bool ("skins", "player_shaded"), data);
 }
 
 /* calculate peak dB level, where 1 is 0 dB */
@@ -110,7 +123,7 @@ void VisCallbacks::render_multi_pcm (const float * pcm, int channels)
     else
         data[1] = data[0];
 
-    mainwin_svis->render (data);
+    show_data (true, data);
 }
 
 /* convert linear frequency graph to logarithmic one */
@@ -165,10 +178,7 @@ void VisCallbacks::render_freq (const float * freq)
     else
         return;
 
-    if (shaded)
-        mainwin_svis->render (data);
-    else
-        mainwin_vis->render (data);
+    show_data (shaded, data);
 }
 
 void start_stop_visual (bool exiting)
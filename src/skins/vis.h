@@ -59,8 +59,10 @@ public:
     void set_colors ();
     void clear ();
     void render (const unsigned char * data);
+    void skip_frame () { m_frames_skipped ++; }
 
 private:
+    void queue_frame ();
     void draw (cairo_t * cr);
 
     uint32_t m_voice_color[256];
@@ -68,9 +70,12 @@ private:
     uint32_t m_voice_color_ice[256];
     uint32_t m_pattern_fill[76 * 2];
 
-    bool m_active, m_voiceprint_advance;
+    bool m_active;
     float m_data[75], m_peak[75], m_peak_speed[75];
     unsigned char m_voiceprint_data[76 * 16];
+
+    bool m_frame_queued = false;
+    int m_frames_painted = 0, m_frames_skipped = 0;
 };
 
 class SmallVis : public Widget
@@ -79,12 +84,17 @@ public:
     SmallVis ();
     void clear ();
     void render (const unsigned char * data);
+    void skip_frame () { m_frames_skipped ++; }
 
 private:
+    void queue_frame ();
     void draw (cairo_t * cr);
 
     bool m_active;
     int m_data[75];
+
+    bool m_frame_queued = false;
+    int m_frames_painted = 0, m_frames_skipped = 0;
 };
 
 #endif
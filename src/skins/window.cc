@@ -69,6 +69,12 @@ bool Window::motion (GdkEventMotion * event)
     return true;
 }
 
+gboolean Window::visibility_cb (GtkWidget * widget, GdkEventVisibility * event, Window * me)
+{
+    me->m_is_obscured = (event->state == GDK_VISIBILITY_FULLY_OBSCURED);
+    return false;
+}
+
 bool Window::close ()
 {
     skins_close ();
@@ -105,7 +111,8 @@ Window::Window (int id, int * x, int * y, int w, int h, bool shaded) :
 
     gtk_widget_set_app_paintable (window, true);
     gtk_widget_add_events (window, GDK_BUTTON_PRESS_MASK |
-     GDK_BUTTON_RELEASE_MASK | GDK_POINTER_MOTION_MASK | GDK_SCROLL_MASK);
+     GDK_BUTTON_RELEASE_MASK | GDK_POINTER_MOTION_MASK | GDK_SCROLL_MASK |
+     GDK_VISIBILITY_NOTIFY_MASK);
     gtk_window_add_accel_group ((GtkWindow *) window, menu_get_accel_group ());
 
     /* We set None as the background pixmap in order to avoid flickering.
@@ -114,6 +121,8 @@ Window::Window (int id, int * x, int * y, int w, int h, bool shaded) :
     gtk_widget_set_style (window, style);
     g_object_unref (style);
 
+    g_signal_connect (window, "visibility-notify-event", (GCallback) visibility_cb, this);
+
     set_input (window);
     set_drawable (window);
     set_scale (config.scale);
@@ -171,6 +180,16 @@ void Window::set_shaded (bool shaded)
     apply_shape ();
 }
 
+/* Covered windows are only reported by the X server if no compositing
+ * manager is running; otherwise only a minimized window counts as hidden. */
+bool Window::is_visible ()
+{
+    GdkWindow * window = gtk_widget_get_window (gtk ());
+
+    return window && ! m_is_obscured && ! (gdk_window_get_state (window) &
+     (GDK_WINDOW_STATE_ICONIFIED | GDK_WINDOW_STATE_WITHDRAWN));
+}
+
 void Window::put_widget (bool shaded, Widget * widget, int x, int y)
 {
     GtkWidget * fixed = shaded ? m_shaded : m_normal;
@@ -43,6 +43,7 @@ public:
     void set_shapes (GdkRegion * shape, GdkRegion * sshape);
     bool is_shaded () { return m_is_shaded; }
     void set_shaded (bool shaded);
+    bool is_visible ();
     void put_widget (bool shaded, Widget * widget, int x, int y);
     void move_widget (bool shaded, Widget * widget, int x, int y);
 
@@ -64,9 +65,12 @@ protected:
 private:
     void apply_shape ();
 
+    static gboolean visibility_cb (GtkWidget * widget, GdkEventVisibility * event, Window * me);
+
     const int m_id;
     bool m_is_shaded = false;
     bool m_is_moving = false;
+    bool m_is_obscured = false;
     GtkWidget * m_normal = nullptr, * m_shaded = nullptr;
     SmartPtr<GdkRegion, gdk_region_destroy> m_shape, m_sshape;
 };
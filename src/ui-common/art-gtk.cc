@@ -0,0 +1,106 @@
+/*
+ * art-gtk.cc
+ * Album art decoded on a worker thread
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#include "art-gtk.h"
+
+#include <glib/gstdio.h>
+
+#include <libaudcore/runtime.h>
+
+String art_hash (const Index<char> & data)
+{
+    CharPtr hash (g_compute_checksum_for_data (G_CHECKSUM_SHA1,
+     (const unsigned char *) data.begin (), data.len ()));
+
+    return String (hash);
+}
+
+/* asks the loader to scale while decoding; JPEG in particular can skip
+ * most of the work this way */
+static void size_prepared_cb (GdkPixbufLoader * loader, int width, int height, int * size)
+{
+    if (width <= * size && height <= * size)
+        return;
+
+    if (width > height)
+    {
+        height = aud::max (1, aud::rescale (height, width, * size));
+        width = * size;
+    }
+    else
+    {
+        width = aud::max (1, aud::rescale (width, height, * size));
+        height = * size;
+    }
+
+    gdk_pixbuf_loader_set_size (loader, width, height);
+}
+
+ArtImage * art_image_decode (const Index<char> & data, int size)
+{
+    GdkPixbufLoader * loader = gdk_pixbuf_loader_new ();
+    g_signal_connect (loader, "size-prepared", (GCallback) size_prepared_cb, & size);
+
+    GError * error = nullptr;
+    bool success = gdk_pixbuf_loader_write (loader,
+     (const unsigned char *) data.begin (), data.len (), & error);
+
+    /* the loader must be closed even if writing failed */
+    success = gdk_pixbuf_loader_close (loader, success ? & error : nullptr) && success;
+
+    ArtImage * image = nullptr;
+    GdkPixbuf * pixbuf = success ? gdk_pixbuf_loader_get_pixbuf (loader) : nullptr;
+
+    if (pixbuf)
+    {
+        image = new ArtImage {AudguiPixbuf ((GdkPixbuf *) g_object_ref (pixbuf))};
+
+        /* in case the loader ignored the requested size */
+        audgui_pixbuf_scale_within (image->pixbuf, size);
+    }
+    else if (error)
+    {
+        AUDWARN ("Error loading album art: %s\n", error->message);
+        g_error_free (error);
+    }
+
+    g_object_unref (loader);
+    return image;
+}
+
+ArtImage * art_image_load (const char * path)
+{
+    GdkPixbuf * pixbuf = gdk_pixbuf_new_from_file (path, nullptr);
+    return pixbuf ? new ArtImage {AudguiPixbuf (pixbuf)} : nullptr;
+}
+
+bool art_image_save (ArtImage * image, const char * path)
+{
+    CharPtr dir (g_path_get_dirname (path));
+
+    if (g_mkdir_with_parents (dir, 0755) < 0)
+        return false;
+
+    return gdk_pixbuf_save (image->pixbuf.get (), path, "png", nullptr, nullptr);
+}
+
+void art_image_free (ArtImage * image)
+{
+    delete image;
+}
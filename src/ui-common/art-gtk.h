@@ -0,0 +1,32 @@
+/*
+ * art-gtk.h
+ * Album art decoded on a worker thread
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#ifndef UI_COMMON_ART_GTK_H
+#define UI_COMMON_ART_GTK_H
+
+#include <libaudgui/libaudgui-gtk.h>
+
+#include "art.h"
+
+struct ArtImage
+{
+    AudguiPixbuf pixbuf;
+};
+
+#endif
@@ -0,0 +1,85 @@
+/*
+ * art-qt.cc
+ * Album art decoded on a worker thread
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#include "art-qt.h"
+
+#include <QBuffer>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFileInfo>
+#include <QImageReader>
+
+#include <libaudcore/runtime.h>
+
+String art_hash (const Index<char> & data)
+{
+    QByteArray bytes = QByteArray::fromRawData (data.begin (), data.len ());
+    QByteArray hash = QCryptographicHash::hash (bytes, QCryptographicHash::Sha1);
+
+    return String (hash.toHex ().constData ());
+}
+
+ArtImage * art_image_decode (const Index<char> & data, int size)
+{
+    QByteArray bytes = QByteArray::fromRawData (data.begin (), data.len ());
+    QBuffer buffer (& bytes);
+    QImageReader reader (& buffer);
+
+    /* asks the reader to scale while decoding; JPEG in particular can skip
+     * most of the work this way */
+    QSize full = reader.size ();
+    if (full.isValid () && (full.width () > size || full.height () > size))
+        reader.setScaledSize (full.scaled (size, size, Qt::KeepAspectRatio));
+
+    QImage image = reader.read ();
+
+    if (image.isNull ())
+    {
+        AUDWARN ("Error loading album art: %s\n",
+         reader.errorString ().toUtf8 ().constData ());
+        return nullptr;
+    }
+
+    /* in case the reader ignored the requested size */
+    if (image.width () > size || image.height () > size)
+        image = image.scaled (size, size, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+
+    return new ArtImage {image};
+}
+
+ArtImage * art_image_load (const char * path)
+{
+    QImage image (QString::fromUtf8 (path));
+    return image.isNull () ? nullptr : new ArtImage {image};
+}
+
+bool art_image_save (ArtImage * image, const char * path)
+{
+    QString file = QString::fromUtf8 (path);
+
+    if (! QDir ().mkpath (QFileInfo (file).path ()))
+        return false;
+
+    return image->image.save (file, "PNG");
+}
+
+void art_image_free (ArtImage * image)
+{
+    delete image;
+}
@@ -0,0 +1,334 @@
+/*
+ * art.cc
+ * Album art decoded on a worker thread
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#include "art.h"
+
+#include <dirent.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <utime.h>
+
+#include <libaudcore/audstrings.h>
+#include <libaudcore/drct.h>
+#include <libaudcore/hook.h>
+#include <libaudcore/mainloop.h>
+#include <libaudcore/playlist.h>
+#include <libaudcore/probe.h>
+#include <libaudcore/runtime.h>
+#include <libaudcore/vfs.h>
+
+/* Decoded thumbnails are saved as PNG files in the user directory, named
+ * after a hash of the embedded image and the size they were scaled to.
+ * Songs from the same album thus share their thumbnails.  A thumbnail is
+ * touched when used, and the least recently used ones are removed once
+ * the folder grows beyond ART_CACHE_SIZE. */
+
+#define ART_CACHE_SIZE (32 << 20)
+
+struct ArtJob
+{
+    String file;
+    int size;
+    AudArtPtr art;
+    ArtFunc func;  /* nullptr when prefetching or cancelled */
+    void * owner;
+    SmartPtr<ArtImage, art_image_free> image;
+};
+
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+static pthread_t thread;
+static bool thread_running, thread_quit;
+
+static Index<SmartPtr<ArtJob>> pending, finished;
+static ArtJob * working;
+static QueuedFunc deliver_func;
+
+static String cache_dir;
+static String prefetch_file, waiting_file;
+static int prefetch_size, waiting_size;
+
+static void prune_cache ()
+{
+    struct CacheFile {
+        String path;
+        int64_t mtime, size;
+    };
+
+    DIR * dir = opendir (cache_dir);
+    if (! dir)
+        return;
+
+    Index<CacheFile> files;
+    int64_t total = 0;
+    struct dirent * entry;
+
+    while ((entry = readdir (dir)))
+    {
+        /* leave files being written alone */
+        if (! str_has_suffix_nocase (entry->d_name, ".png"))
+            continue;
+
+        StringBuf path = filename_build ({cache_dir, entry->d_name});
+        struct stat info;
+
+        if (stat (path, & info) == 0 && S_ISREG (info.st_mode))
+        {
+            files.append (String (path), (int64_t) info.st_mtime, (int64_t) info.st_size);
+            total += info.st_size;
+        }
+    }
+
+    closedir (dir);
+
+    files.sort ([] (const CacheFile & a, const CacheFile & b)
+        { return (a.mtime > b.mtime) - (a.mtime < b.mtime); });
+
+    for (int i = 0; i < files.len () && total > ART_CACHE_SIZE; i ++)
+    {
+        if (remove (files[i].path) == 0)
+            total -= files[i].size;
+    }
+}
+
+static void process (ArtJob & job)
+{
+    const Index<char> * data = aud_art_data (job.art.get ());
+    if (! data)
+        return;
+
+    StringBuf name = str_printf ("%s-%d.png", (const char *) art_hash (* data), job.size);
+    StringBuf path = filename_build ({cache_dir, name});
+
+    if (VFSFile::test_file (filename_to_uri (path), VFS_EXISTS))
+    {
+        utime (path, nullptr);
+
+        /* a prefetch only needs to fill the cache */
+        if (! job.owner)
+            return;
+
+        job.image.capture (art_image_load (path));
+        if (job.image)
+            return;
+    }
+
+    job.image.capture (art_image_decode (* data, job.size));
+
+    /* write under a temporary name, so that a half-written file is never
+     * picked up by another instance */
+    if (job.image)
+    {
+        StringBuf temp = str_concat ({path, ".tmp"});
+
+        if (! art_image_save (job.image.get (), temp) || rename (temp, path) < 0)
+        {
+            AUDWARN ("Failed to cache album art as %s\n", (const char *) path);
+            remove (temp);
+        }
+        else
+            prune_cache ();
+    }
+}
+
+static void deliver (void *)
+{
+    pthread_mutex_lock (& mutex);
+    Index<SmartPtr<ArtJob>> jobs = std::move (finished);
+    pthread_mutex_unlock (& mutex);
+
+    for (auto & job : jobs)
+        job->func (job->image.get (), job->owner);
+}
+
+static void * worker (void *)
+{
+    pthread_mutex_lock (& mutex);
+
+    while (! thread_quit)
+    {
+        if (! pending.len ())
+        {
+            pthread_cond_wait (& cond, & mutex);
+            continue;
+        }
+
+        SmartPtr<ArtJob> job = std::move (pending[0]);
+        pending.remove (0, 1);
+        working = job.get ();
+
+        pthread_mutex_unlock (& mutex);
+        process (* job);
+        pthread_mutex_lock (& mutex);
+
+        working = nullptr;
+
+        if (job->func)
+        {
+            finished.append (std::move (job));
+            deliver_func.queue (deliver, nullptr);
+        }
+    }
+
+    pthread_mutex_unlock (& mutex);
+    return nullptr;
+}
+
+static void add_job (const String & file, int size, AudArtPtr && art,
+ ArtFunc func, void * owner)
+{
+    if (! cache_dir)
+        cache_dir = String (filename_build ({aud_get_path (AudPath::UserDir), "thumbnails"}));
+
+    auto job = new ArtJob {file, size, std::move (art), func, owner};
+
+    pthread_mutex_lock (& mutex);
+
+    pending.append (SmartPtr<ArtJob> (job));
+
+    if (! thread_running)
+    {
+        thread_quit = false;
+        pthread_create (& thread, nullptr, worker, nullptr);
+        thread_running = true;
+    }
+    else
+        pthread_cond_signal (& cond);
+
+    pthread_mutex_unlock (& mutex);
+}
+
+void art_request_current (int size, ArtFunc func, void * owner)
+{
+    art_cancel (owner);
+
+    String file = aud_drct_get_filename ();
+    AudArtPtr art = file ? aud_art_request (file, AUD_ART_DATA) : AudArtPtr ();
+
+    /* nothing to decode, so answer right away */
+    if (! art || ! aud_art_data (art.get ()))
+    {
+        func (nullptr, owner);
+        return;
+    }
+
+    add_job (file, size, std::move (art), func, owner);
+}
+
+static void art_ready (void * data, void *)
+{
+    if (! waiting_file || strcmp ((const char *) data, waiting_file))
+        return;
+
+    hook_dissociate ("art ready", art_ready);
+
+    String file = std::move (waiting_file);
+    AudArtPtr art = aud_art_request (file, AUD_ART_DATA);
+
+    if (art && aud_art_data (art.get ()))
+        add_job (file, waiting_size, std::move (art), nullptr, nullptr);
+}
+
+void art_prefetch_next (int size)
+{
+    auto list = Playlist::playing_playlist ();
+    int entry = list.queue_get_entry (0);
+
+    /* with shuffle on, only the queue tells us what comes next */
+    if (entry < 0 && ! aud_get_bool (nullptr, "shuffle"))
+    {
+        entry = list.get_position ();
+        if (entry >= 0)
+            entry ++;
+    }
+
+    if (entry < 0 || entry >= list.n_entries ())
+        return;
+
+    String file = list.entry_filename (entry);
+    if (file == prefetch_file && size == prefetch_size)
+        return;
+
+    prefetch_file = file;
+    prefetch_size = size;
+
+    bool queued;
+    AudArtPtr art = aud_art_request (file, AUD_ART_DATA, & queued);
+
+    if (art && aud_art_data (art.get ()))
+        add_job (file, size, std::move (art), nullptr, nullptr);
+    else if (queued)
+    {
+        if (! waiting_file)
+            hook_associate ("art ready", art_ready, nullptr);
+
+        waiting_file = file;
+        waiting_size = size;
+    }
+}
+
+static void remove_owned (Index<SmartPtr<ArtJob>> & jobs, void * owner)
+{
+    for (int i = jobs.len (); i --; )
+    {
+        if (jobs[i]->func && jobs[i]->owner == owner)
+            jobs.remove (i, 1);
+    }
+}
+
+void art_cancel (void * owner)
+{
+    pthread_mutex_lock (& mutex);
+
+    remove_owned (pending, owner);
+    remove_owned (finished, owner);
+
+    if (working && working->owner == owner)
+        working->func = nullptr;
+
+    pthread_mutex_unlock (& mutex);
+}
+
+void art_cleanup ()
+{
+    pthread_mutex_lock (& mutex);
+
+    bool was_running = thread_running;
+    thread_quit = true;
+    thread_running = false;
+    pthread_cond_signal (& cond);
+
+    pthread_mutex_unlock (& mutex);
+
+    if (was_running)
+        pthread_join (thread, nullptr);
+
+    pending.clear ();
+    finished.clear ();
+    deliver_func.stop ();
+
+    if (waiting_file)
+        hook_dissociate ("art ready", art_ready);
+
+    cache_dir = String ();
+    prefetch_file = String ();
+    waiting_file = String ();
+}
@@ -0,0 +1,53 @@
+/*
+ * art.h
+ * Album art decoded on a worker thread
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#ifndef UI_COMMON_ART_H
+#define UI_COMMON_ART_H
+
+#include <libaudcore/index.h>
+#include <libaudcore/objects.h>
+
+// defined in art-gtk.h or art-qt.h
+struct ArtImage;
+
+// image is nullptr if the song has no (readable) album art
+typedef void (* ArtFunc) (ArtImage * image, void * owner);
+
+// Decodes the art of the current song, scaled to fit within size x size,
+// and passes it to func on the main thread.  A second request from the
+// same owner replaces the first.
+void art_request_current (int size, ArtFunc func, void * owner);
+
+// Decodes the art of the song that will play next, so that it is in the
+// thumbnail cache by the time it is requested.
+void art_prefetch_next (int size);
+
+void art_cancel (void * owner);
+
+// stops the worker thread; call before the plugin is unloaded
+void art_cleanup ();
+
+// toolkit-specific parts, called from the worker thread
+String art_hash (const Index<char> & data);
+ArtImage * art_image_decode (const Index<char> & data, int size);
+ArtImage * art_image_load (const char * path);
+bool art_image_save (ArtImage * image, const char * path);
+void art_image_free (ArtImage * image);
+
+#endif
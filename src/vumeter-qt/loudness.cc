@@ -0,0 +1,297 @@
+/*
+ * loudness.cc
+ * Loudness measurement for the VU meter
+ * Copyright (c) 2026 Audacious Team
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "loudness.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <libaudcore/objects.h>
+
+static float energy_to_lufs(float energy)
+{
+    return (energy > 0) ? -0.691f + 10 * log10f(energy) : -HUGE_VALF;
+}
+
+LoudnessMeter::LoudnessMeter()
+{
+    /* windowed sinc, 48 taps, cut off at the original Nyquist frequency */
+    constexpr int taps = oversample * phase_taps;
+    float h[taps];
+
+    for (int n = 0; n < taps; n++)
+    {
+        double t = (n - (taps - 1) / 2.0) / oversample;
+        double window = 0.5 - 0.5 * cos(2 * M_PI * (n + 0.5) / taps);
+        h[n] = sin(M_PI * t) / (M_PI * t) * window;
+    }
+
+    /* each phase is stored reversed, so that it lines up with the input,
+     * and scaled to unity gain */
+    for (int p = 0; p < oversample; p++)
+    {
+        float sum = 0;
+
+        for (int j = 0; j < phase_taps; j++)
+        {
+            m_interp[p][j] = h[oversample * (phase_taps - 1 - j) + p];
+            sum += m_interp[p][j];
+        }
+
+        for (int j = 0; j < phase_taps; j++)
+            m_interp[p][j] /= sum;
+    }
+
+    reset();
+}
+
+void LoudnessMeter::reset()
+{
+    memset(m_state, 0, sizeof m_state);
+    memset(m_hist_count, 0, sizeof m_hist_count);
+    memset(m_hist_energy, 0, sizeof m_hist_energy);
+
+    m_blocks.clear();
+    m_last_gate = -1;
+
+    m_momentary = m_short_term = m_integrated = -HUGE_VALF;
+
+    for (float & peak : m_true_peak)
+        peak = -HUGE_VALF;
+}
+
+/* K-weighting filter coefficients for any sample rate, derived from the
+ * analog prototypes of the 48 kHz filters given in BS.1770 */
+void LoudnessMeter::set_rate(int rate)
+{
+    double f0 = 1681.974450955533;
+    double G = 3.999843853973347;
+    double Q = 0.7071752369554196;
+
+    double K = tan(M_PI * f0 / rate);
+    double Vh = pow(10, G / 20);
+    double Vb = pow(Vh, 0.4996667741545416);
+    double a0 = 1 + K / Q + K * K;
+
+    m_shelf.b0 = (Vh + Vb * K / Q + K * K) / a0;
+    m_shelf.b1 = 2 * (K * K - Vh) / a0;
+    m_shelf.b2 = (Vh - Vb * K / Q + K * K) / a0;
+    m_shelf.a1 = 2 * (K * K - 1) / a0;
+    m_shelf.a2 = (1 - K / Q + K * K) / a0;
+
+    f0 = 38.13547087602444;
+    Q = 0.5003270373238773;
+
+    K = tan(M_PI * f0 / rate);
+    a0 = 1 + K / Q + K * K;
+
+    m_highpass.b0 = 1;
+    m_highpass.b1 = -2;
+    m_highpass.b2 = 1;
+    m_highpass.a1 = 2 * (K * K - 1) / a0;
+    m_highpass.a2 = (1 - K / Q + K * K) / a0;
+
+    memset(m_state, 0, sizeof m_state);
+    m_rate = rate;
+}
+
+/* Returns the weighted mean square of the filtered block.  The channels
+ * run through the inner loop, with the same coefficients and separate
+ * state, so that the compiler can process several of them at once. */
+float LoudnessMeter::filter_block(const float * pcm, int frames, int stride,
+                                  int channels)
+{
+    const Biquad s = m_shelf, h = m_highpass;
+    float sum[max_channels] = {};
+
+    for (int f = 0; f < frames; f++)
+    {
+        const float * in = pcm + f * stride;
+
+        for (int c = 0; c < channels; c++)
+        {
+            float x = in[c];
+            float y = s.b0 * x + m_state[0][c];
+            m_state[0][c] = s.b1 * x - s.a1 * y + m_state[1][c];
+            m_state[1][c] = s.b2 * x - s.a2 * y;
+
+            float z = h.b0 * y + m_state[2][c];
+            m_state[2][c] = h.b1 * y - h.a1 * z + m_state[3][c];
+            m_state[3][c] = h.b2 * y - h.a2 * z;
+
+            sum[c] += z * z;
+        }
+    }
+
+    /* in 5.1 (L, R, C, LFE, Ls, Rs), the LFE channel is left out and the
+     * surround channels are weighted +1.5 dB */
+    float energy = 0;
+
+    for (int c = 0; c < channels; c++)
+    {
+        float weight = 1;
+
+        if (channels == 6 && c == 3)
+            weight = 0;
+        else if (channels == 6 && c > 3)
+            weight = 1.41f;
+
+        energy += weight * sum[c] / frames;
+    }
+
+    return energy;
+}
+
+void LoudnessMeter::measure_true_peak(const float * pcm, int frames,
+                                      int stride, int channels)
+{
+    for (int c = 0; c < channels; c++)
+    {
+        float peak = 0;
+
+        for (int start = 0; start < frames; start += aud::n_elems(m_channel))
+        {
+            int n = aud::min(frames - start, (int)aud::n_elems(m_channel));
+
+            for (int i = 0; i < n; i++)
+            {
+                m_channel[i] = pcm[(start + i) * stride + c];
+                peak = fmaxf(peak, fabsf(m_channel[i]));
+            }
+
+            /* the points in between the samples, leaving out the first
+             * few, whose history belongs to the previous block */
+            for (int m = phase_taps - 1; m < n; m++)
+            {
+                const float * x = m_channel + m - (phase_taps - 1);
+
+                for (int p = 0; p < oversample; p++)
+                {
+                    float y = 0;
+                    for (int j = 0; j < phase_taps; j++)
+                        y += x[j] * m_interp[p][j];
+
+                    peak = fmaxf(peak, fabsf(y));
+                }
+            }
+        }
+
+        m_true_peak[c] = (peak > 0) ? 20 * log10f(peak) : -HUGE_VALF;
+    }
+}
+
+float LoudnessMeter::window_energy(qint64 time, qint64 length) const
+{
+    float sum = 0;
+    int count = 0;
+
+    for (const Block & block : m_blocks)
+    {
+        if (block.time > time - length)
+        {
+            sum += block.energy;
+            count++;
+        }
+    }
+
+    return count ? sum / count : 0;
+}
+
+void LoudnessMeter::add_gating_block(float energy)
+{
+    float lufs = energy_to_lufs(energy);
+
+    /* absolute gate */
+    if (lufs < -70)
+        return;
+
+    int bin = aud::min((int)((lufs + 70) * 10), hist_bins - 1);
+
+    m_hist_count[bin]++;
+    m_hist_energy[bin] += energy;
+}
+
+/* The gating blocks are kept in a histogram of 0.1 LU bins, so that the
+ * relative gate does not need the whole history of blocks. */
+void LoudnessMeter::update_integrated()
+{
+    double sum = 0;
+    int count = 0;
+
+    for (int i = 0; i < hist_bins; i++)
+    {
+        sum += m_hist_energy[i];
+        count += m_hist_count[i];
+    }
+
+    if (!count)
+        return;
+
+    float gate = energy_to_lufs(sum / count) - 10;
+    int first = aud::clamp((int)ceilf((gate + 70) * 10), 0, hist_bins);
+
+    sum = 0;
+    count = 0;
+
+    for (int i = first; i < hist_bins; i++)
+    {
+        sum += m_hist_energy[i];
+        count += m_hist_count[i];
+    }
+
+    m_integrated = count ? energy_to_lufs(sum / count) : -HUGE_VALF;
+}
+
+void LoudnessMeter::process(const float * pcm, int frames, int channels,
+                            int rate, qint64 time)
+{
+    int stride = channels;
+    channels = aud::min(channels, (int)max_channels);
+
+    if (frames <= 0 || channels <= 0 || rate <= 0)
+        return;
+
+    if (rate != m_rate)
+        set_rate(rate);
+
+    float energy = filter_block(pcm, frames, stride, channels);
+    measure_true_peak(pcm, frames, stride, channels);
+
+    /* only the short-term window needs to be kept */
+    int old = 0;
+    while (old < m_blocks.len() && m_blocks[old].time <= time - 3000)
+        old++;
+
+    m_blocks.remove(0, old);
+    m_blocks.append(Block{time, energy});
+
+    m_momentary = energy_to_lufs(window_energy(time, 400));
+    m_short_term = energy_to_lufs(window_energy(time, 3000));
+
+    /* gating blocks of 400 ms, overlapping by 75% */
+    if (m_last_gate < 0 || time - m_last_gate >= 100)
+    {
+        m_last_gate = time;
+        add_gating_block(window_energy(time, 400));
+        update_integrated();
+    }
+}
@@ -0,0 +1,101 @@
+/*
+ * loudness.h
+ * Loudness measurement for the VU meter
+ * Copyright (c) 2026 Audacious Team
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __VUMETER_QT_LOUDNESS_H
+#define __VUMETER_QT_LOUDNESS_H
+
+#include <QtGlobal>
+
+#include <libaudcore/index.h>
+
+/*
+ * Loudness as specified by ITU-R BS.1770 and EBU R128: K-weighted mean
+ * square over 400 ms (momentary) and 3 s (short-term) windows, and the
+ * gated integrated loudness since the last reset.  Also measures the true
+ * peak of each block by 4x oversampling.
+ *
+ * The visualization feed delivers short blocks of audio with gaps in
+ * between, so the windows are measured in wall-clock time and every block
+ * stands for the audio around it.
+ */
+class LoudnessMeter
+{
+public:
+    static constexpr int max_channels = 20;
+
+    LoudnessMeter();
+
+    void reset();
+    void process(const float * pcm, int frames, int channels, int rate,
+                 qint64 time);
+
+    /* in LUFS; -HUGE_VALF if there is nothing to measure */
+    float momentary() const { return m_momentary; }
+    float short_term() const { return m_short_term; }
+    float integrated() const { return m_integrated; }
+
+    /* of the last block, in dBTP */
+    float true_peak(int channel) const { return m_true_peak[channel]; }
+
+private:
+    static constexpr int oversample = 4;
+    static constexpr int phase_taps = 12;
+    static constexpr int hist_bins = 800; /* 0.1 LU steps from -70 LUFS */
+
+    struct Biquad
+    {
+        float b0, b1, b2, a1, a2;
+    };
+
+    struct Block
+    {
+        qint64 time;
+        float energy; /* weighted sum over the channels */
+    };
+
+    void set_rate(int rate);
+    float filter_block(const float * pcm, int frames, int stride,
+                       int channels);
+    void measure_true_peak(const float * pcm, int frames, int stride,
+                           int channels);
+    float window_energy(qint64 time, qint64 length) const;
+    void add_gating_block(float energy);
+    void update_integrated();
+
+    int m_rate = 0;
+    Biquad m_shelf, m_highpass;
+    float m_state[4][max_channels]; /* two delay elements per filter */
+
+    float m_interp[oversample][phase_taps];
+    float m_channel[512];
+
+    Index<Block> m_blocks;
+    qint64 m_last_gate = -1;
+
+    int m_hist_count[hist_bins];
+    double m_hist_energy[hist_bins];
+
+    float m_momentary, m_short_term, m_integrated;
+    float m_true_peak[max_channels];
+};
+
+#endif
@@ -46,6 +46,9 @@ const PreferencesWidget VUMeterQt::widgets[] = {
     WidgetCheck (N_("Display legend"),
         WidgetBool ("vumeter", "display_legend", toggle_display_legend)
     ),
+    WidgetCheck (N_("EBU R128 loudness and true peak"),
+        WidgetBool ("vumeter", "loudness", toggle_loudness)
+    ),
 };
 
 const PluginPreferences VUMeterQt::prefs = {{widgets}};
@@ -54,6 +57,7 @@ const char * const VUMeterQt::prefs_defaults[] = {
     "peak_hold_time", "1.6",
     "falloff", "13.3",
     "display_legend", "TRUE",
+    "loudness", "FALSE",
     nullptr
 };
 
@@ -100,3 +104,11 @@ void VUMeterQt::toggle_display_legend()
         spect_widget->toggle_display_legend();
     }
 }
+
+void VUMeterQt::toggle_loudness()
+{
+    if (spect_widget)
+    {
+        spect_widget->toggle_loudness();
+    }
+}
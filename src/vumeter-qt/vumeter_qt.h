@@ -50,6 +50,7 @@ public:
     void render_multi_pcm (const float * pcm, int channels);
 
     static void toggle_display_legend();
+    static void toggle_loudness();
 };
 
 #endif
@@ -21,6 +21,7 @@
 #include "vumeter_qt_widget.h"
 
 #include <math.h>
+#include <libaudcore/drct.h>
 #include <libaudcore/runtime.h>
 
 const QColor VUMeterQtWidget::backgroundColor = QColor(16, 16, 16, 255);
@@ -102,11 +103,22 @@ void VUMeterQtWidget::render_multi_pcm (const float * pcm, int channels)
         }
     }
 
+    if (loudness_mode)
+    {
+        int bitrate, samplerate, file_channels;
+        aud_drct_get_info(bitrate, samplerate, file_channels);
+
+        loudness.process(pcm, 512, channels, samplerate, loudness_clock.elapsed());
+        loudness_db[0] = get_db_on_range(loudness.momentary());
+        loudness_db[1] = get_db_on_range(loudness.short_term());
+        loudness_db[2] = get_db_on_range(loudness.integrated());
+    }
+
     for (int i = 0; i < nchannels; i++)
     {
         float n = peaks[i];
 
-        float db = 20 * log10f(n);
+        float db = loudness_mode ? loudness.true_peak(i) : 20 * log10f(n);
         db = get_db_on_range(db);
 
         if (db > channels_db_level[i])
@@ -141,7 +153,8 @@ void VUMeterQtWidget::redraw_timer_expired()
         }
     }
 
-    update();
+    /* the legend is cached, only the bars and their labels change */
+    update(QRectF(legend_width, 0, vumeter_width, height()).toAlignedRect());
 }
 
 void VUMeterQtWidget::reset()
@@ -152,6 +165,12 @@ void VUMeterQtWidget::reset()
         channels_db_level[i] = -db_range;
         channels_peaks[i] = -db_range;
     }
+
+    loudness.reset();
+    for (int i = 0; i < loudness_bars; i++)
+    {
+        loudness_db[i] = -db_range;
+    }
 }
 
 void VUMeterQtWidget::draw_background(QPainter & p)
@@ -245,7 +264,8 @@ void VUMeterQtWidget::draw_vu_legend_db(QPainter &p, float db, const char *text)
 
 void VUMeterQtWidget::draw_visualizer_peaks(QPainter &p)
 {
-    float bar_width = get_bar_width(nchannels);
+    int bars = get_bars();
+    float bar_width = get_bar_width(bars);
     float font_size_width = bar_width / 3.0f;
     float font_size_height = vumeter_top_padding * 0.50f;
 
@@ -258,9 +278,10 @@ void VUMeterQtWidget::draw_visualizer_peaks(QPainter &p)
     p.setPen(pen);
 
     QFontMetricsF fm(p.font());
-    for (int i = 0; i < nchannels; i++)
+    for (int i = 0; i < bars; i++)
     {
-        QString text = format_db(channels_peaks[i]);
+        float db = (i < nchannels) ? channels_peaks[i] : loudness_db[i - nchannels];
+        QString text = format_db(db);
         QSizeF text_size = fm.size(0, text);
         p.drawText(
             QPointF(
@@ -272,11 +293,14 @@ void VUMeterQtWidget::draw_visualizer_peaks(QPainter &p)
     }
 }
 
-void VUMeterQtWidget::draw_visualizer(QPainter & p)
+void VUMeterQtWidget::draw_bar_backgrounds(QPainter & p)
 {
-    for (int i = 0; i < nchannels; i++)
+    static const char * const labels[loudness_bars] = {"M", "S", "I"};
+
+    int bars = get_bars();
+    for (int i = 0; i < bars; i++)
     {
-        float bar_width = get_bar_width(nchannels);
+        float bar_width = get_bar_width(bars);
         float x = legend_width + (bar_width * i);
         if (i > 0)
         {
@@ -289,22 +313,61 @@ void VUMeterQtWidget::draw_visualizer(QPainter & p)
             background_vumeter_pattern
         );
 
-        p.fillRect (
-            QRectF(x, get_y_from_db(channels_db_level[i]),
-                bar_width, (get_height_from_db(channels_db_level[i]))),
-            vumeter_pattern
-        );
-
-        if (channels_peaks[i] > -db_range)
+        if (i >= nchannels && must_draw_vu_legend)
         {
-            p.fillRect (
-                QRectF(x, get_y_from_db(channels_peaks[i]), bar_width, 1),
-                vumeter_pattern
+            QFont font = p.font();
+            font.setPointSizeF(fminf(bar_width / 3.0f, vumeter_top_padding * 0.50f));
+            p.setFont(font);
+            p.setPen(text_color);
+
+            QFontMetricsF fm(p.font());
+            const char * text = labels[i - nchannels];
+            QSizeF text_size = fm.size(0, text);
+            p.drawText(
+                QPointF(
+                    x + bar_width/2.0f - text_size.width()/2.0f,
+                    vumeter_top_padding + vumeter_height - text_size.height()/2.0f
+                ),
+                text
             );
         }
     }
 }
 
+/* copies a slice of the cached gradient */
+void VUMeterQtWidget::draw_bar(QPainter & p, float x, float bar_width, float top, float height)
+{
+    qreal dpr = bar_pixmap.devicePixelRatio();
+    p.drawPixmap (
+        QRectF(x, top, bar_width, height),
+        bar_pixmap,
+        QRectF(0, (top - vumeter_top_padding) * dpr, bar_width * dpr, height * dpr)
+    );
+}
+
+void VUMeterQtWidget::draw_visualizer(QPainter & p)
+{
+    int bars = get_bars();
+    for (int i = 0; i < bars; i++)
+    {
+        float bar_width = get_bar_width(bars);
+        float x = legend_width + (bar_width * i);
+        if (i > 0)
+        {
+             x += 1;
+             bar_width -= 1;
+        }
+
+        float db = (i < nchannels) ? channels_db_level[i] : loudness_db[i - nchannels];
+        draw_bar(p, x, bar_width, get_y_from_db(db), get_height_from_db(db));
+
+        if (i < nchannels && channels_peaks[i] > -db_range)
+        {
+            draw_bar(p, x, bar_width, get_y_from_db(channels_peaks[i]), 1);
+        }
+    }
+}
+
 QString VUMeterQtWidget::format_db(const float val)
 {
     if (val > -10)
@@ -326,6 +389,11 @@ float VUMeterQtWidget::get_bar_width(int channels)
     return vumeter_width / channels;
 }
 
+int VUMeterQtWidget::get_bars()
+{
+    return nchannels + (loudness_mode ? loudness_bars : 0);
+}
+
 void VUMeterQtWidget::update_sizes()
 {
     if (height() > 200 && width() > 60 && aud_get_bool("vumeter", "display_legend"))
@@ -348,13 +416,54 @@ void VUMeterQtWidget::update_sizes()
     }
     vumeter_pattern = get_vumeter_pattern();
     background_vumeter_pattern = get_vumeter_pattern(30);
+    static_layer = QPixmap();
+}
+
+void VUMeterQtWidget::update_static_layer()
+{
+    int bars = get_bars();
+    qreal dpr = devicePixelRatioF();
+
+    static_layer = QPixmap();
+    bar_pixmap = QPixmap();
+    static_layer_bars = bars;
+
+    if (width() <= 0 || height() <= 0 || bars <= 0)
+    {
+        return;
+    }
+
+    static_layer = QPixmap(size() * dpr);
+    static_layer.setDevicePixelRatio(dpr);
+
+    QPainter p(&static_layer);
+    draw_background(p);
+    if (must_draw_vu_legend)
+    {
+        draw_vu_legend(p);
+    }
+    draw_bar_backgrounds(p);
+
+    /* the gradient of a full bar, to be copied in slices */
+    QSizeF bar_size(ceilf(get_bar_width(bars)), ceilf(vumeter_height));
+    bar_pixmap = QPixmap((bar_size * dpr).toSize());
+    bar_pixmap.setDevicePixelRatio(dpr);
+
+    QPainter bp(&bar_pixmap);
+    bp.translate(0, -vumeter_top_padding);
+    bp.fillRect(
+        QRectF(QPointF(0, vumeter_top_padding), bar_size),
+        vumeter_pattern
+    );
 }
 
 VUMeterQtWidget::VUMeterQtWidget (QWidget * parent)
     : QWidget (parent),
-    redraw_timer(new QTimer(this))
+    redraw_timer(new QTimer(this)),
+    loudness_mode(aud_get_bool("vumeter", "loudness"))
 {
     reset();
+    loudness_clock.start();
     connect(redraw_timer, &QTimer::timeout, this, &VUMeterQtWidget::redraw_timer_expired);
     redraw_timer->start(redraw_interval);
     redraw_elapsed_timer.start();
@@ -380,12 +489,16 @@ void VUMeterQtWidget::resizeEvent (QResizeEvent *)
 
 void VUMeterQtWidget::paintEvent (QPaintEvent *)
 {
+    if (static_layer.isNull() || static_layer_bars != get_bars())
+    {
+        update_static_layer();
+    }
+
     QPainter p(this);
 
-    draw_background(p);
+    p.drawPixmap(0, 0, static_layer);
     if (must_draw_vu_legend)
     {
-        draw_vu_legend(p);
         draw_visualizer_peaks(p);
     }
     draw_visualizer(p);
@@ -396,3 +509,11 @@ void VUMeterQtWidget::toggle_display_legend()
     update_sizes();
     update();
 }
+
+void VUMeterQtWidget::toggle_loudness()
+{
+    loudness_mode = aud_get_bool("vumeter", "loudness");
+    reset();
+    update_sizes();
+    update();
+}
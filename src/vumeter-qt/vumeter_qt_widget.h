@@ -28,12 +28,16 @@
 #include <QString>
 #include <QTimer>
 #include <QElapsedTimer>
+#include <QPixmap>
+
+#include "loudness.h"
 
 class VUMeterQtWidget : public QWidget
 {
 private:
     static constexpr int max_channels = 20;
     static constexpr int db_range = 96;
+    static constexpr int loudness_bars = 3; /* momentary, short-term, integrated */
 
     static const QColor backgroundColor;
     static const QColor text_color;
@@ -56,6 +60,16 @@ private:
     QTimer *redraw_timer;
     QElapsedTimer redraw_elapsed_timer;
 
+    bool loudness_mode;
+    LoudnessMeter loudness;
+    float loudness_db[loudness_bars];
+    QElapsedTimer loudness_clock;
+
+    /* the parts that only change with the size or the number of bars */
+    QPixmap static_layer;
+    QPixmap bar_pixmap;
+    int static_layer_bars = 0;
+
     void draw_background (QPainter &p);
     void draw_visualizer (QPainter &p);
     void draw_vu_legend(QPainter &p);
@@ -66,7 +80,11 @@ private:
     void draw_vu_legend_db(QPainter &p, float db, const char *text);
     void draw_vu_legend_line(QPainter &p, float db, float line_width_factor = 1.0f);
     void draw_visualizer_peaks(QPainter &p);
+    void draw_bar_backgrounds(QPainter &p);
+    void draw_bar(QPainter &p, float x, float bar_width, float top, float height);
     void update_sizes();
+    void update_static_layer();
+    int get_bars();
 
     static QString format_db(const float val);
     static float get_db_on_range(float db);
@@ -81,6 +99,7 @@ public:
     void reset ();
     void render_multi_pcm (const float * pcm, int channels);
     void toggle_display_legend();
+    void toggle_loudness();
 
 protected:
     void resizeEvent (QResizeEvent *);
@@ -290,6 +290,27 @@ u32 rom_mask = 0;
 u32 DMASrc[2][4] = {{0, 0, 0, 0}, {0, 0, 0, 0}};
 u32 DMADst[2][4] = {{0, 0, 0, 0}, {0, 0, 0, 0}};
 
+/* when set, DMA transfers from main RAM into the display and geometry
+ * FIFOs are dropped; those engines are not emulated and their FIFOs are
+ * write-only, so nothing a sound driver can observe depends on the data.
+ * The HBlank/VBlank schedule is left alone, since sound drivers time
+ * their sequencers from it. */
+static BOOL skip_video_dma = false;
+
+void MMU_SetSkipVideoDMA(BOOL enable)
+{
+	skip_video_dma = enable;
+}
+
+static BOOL MMU_isVideoPort(u32 proc, u32 adr)
+{
+	if (proc != ARMCPU_ARM9)
+		return false;
+
+	/* DISP_MMEM_FIFO, GXFIFO and the geometry command ports */
+	return adr == 0x04000068 || (adr >= 0x04000400 && adr < 0x04000600);
+}
+
 void MMU_clearMem()
 {
 	int i;
@@ -335,6 +356,8 @@ void MMU_clearMem()
 
 	memset(MMU.dscard,        0, sizeof(nds_dscard) * 2);
 
+	armcpu_flush_decode_cache();
+
 	MainScreen.offset = 192;
 	SubScreen.offset  = 0;
 
@@ -1261,6 +1284,7 @@ void FASTCALL MMU_write8(u32 proc, u32 adr, u8 val)
 	}
 
 	MMU.MMU_MEM[proc][(adr>>20)&0xFF][adr&MMU.MMU_MASK[proc][(adr>>20)&0xFF]]=val;
+	armcpu_code_written(&MMU.MMU_MEM[proc][(adr>>20)&0xFF][adr&MMU.MMU_MASK[proc][(adr>>20)&0xFF]], 1);
 }
 
 u16 partie = 1;
@@ -1885,6 +1909,7 @@ void FASTCALL MMU_write16(u32 proc, u32 adr, u16 val)
 		}
 	}
 	T1WriteWord(MMU.MMU_MEM[proc][(adr>>20)&0xFF], adr&MMU.MMU_MASK[proc][(adr>>20)&0xFF], val);
+	armcpu_code_written(&MMU.MMU_MEM[proc][(adr>>20)&0xFF][adr&MMU.MMU_MASK[proc][(adr>>20)&0xFF]], 2);
 }
 
 
@@ -2924,6 +2949,7 @@ void FASTCALL MMU_write32(u32 proc, u32 adr, u32 val)
 		}
 	}
 	T1WriteLong(MMU.MMU_MEM[proc][(adr>>20)&0xFF], adr&MMU.MMU_MASK[proc][(adr>>20)&0xFF], val);
+	armcpu_code_written(&MMU.MMU_MEM[proc][(adr>>20)&0xFF][adr&MMU.MMU_MASK[proc][(adr>>20)&0xFF]], 4);
 }
 
 
@@ -2973,6 +2999,21 @@ void FASTCALL MMU_doDMA(u32 proc, u32 num)
 	if(!(MMU.DMACrt[proc][num]&(1<<25)))
 		MMU.DMAStartTime[proc][num] = 0;
 
+	// skip the copy but keep the bus timing above, so completion
+	// interrupts still fire on the same cycle
+	if (skip_video_dma && (src >> 24) == 0x02 && MMU_isVideoPort(proc, dst))
+	{
+		int sz = ((MMU.DMACrt[proc][num]>>26)&1)? 4 : 2;
+		u32 last = dst;
+		switch((MMU.DMACrt[proc][num]>>21) & 0x3) {
+			case 0 :
+			case 3 :  last = dst + (taille - 1) * sz; break;
+			case 1 :  last = dst - (taille - 1) * sz; break;
+		}
+		if (MMU_isVideoPort(proc, last))
+			return;
+	}
+
 	// transfer
 	{
 		u32 i=0;
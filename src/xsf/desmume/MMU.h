@@ -99,6 +99,14 @@ typedef struct {
 
 extern MMU_struct MMU;
 
+extern u16 SPI_CNT;
+extern u16 SPI_CMD;
+extern u16 AUX_SPI_CNT;
+extern u16 AUX_SPI_CMD;
+extern u32 DMASrc[2][4];
+extern u32 DMADst[2][4];
+extern u16 partie;
+
 
 struct armcpu_memory_iface {
   /** the 32 bit instruction prefetch */
@@ -169,6 +177,7 @@ void FASTCALL MMU_write32(u32 proc, u32 adr, u32 val);
 #endif
 
 void FASTCALL MMU_doDMA(u32 proc, u32 num);
+void MMU_SetSkipVideoDMA(BOOL enable);
 
 
 /*
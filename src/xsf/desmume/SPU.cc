@@ -73,6 +73,7 @@ typedef struct
 } SPU_struct;
 
 static SPU_struct spu = { 0, 0, 0 };
+static u32 spu_samplerate = 44100;
 
 static SoundInterface_struct *SNDCore=nullptr;
 extern SoundInterface_struct *SNDCoreList[];
@@ -134,6 +135,18 @@ int SPU_Init(int coreid, int buffersize)
 	SPU_Reset();
 	return SPU_ChangeSoundCore(coreid, buffersize);
 }
+void SPU_SetSampleRate(u32 rate)
+{
+	spu_samplerate = rate;
+}
+u32 SPU_GetStateSize(void)
+{
+	return sizeof(spu.ch);
+}
+void *SPU_GetState(void)
+{
+	return spu.ch;
+}
 void SPU_Pause(int pause)
 {
 	if(pause)
@@ -214,7 +227,7 @@ void SPU_KeyOn(int channel)
 
 static INLINE void adjust_channel_timer(SChannel *ch)
 {
-	ch->inc = (((double)33512000) / (44100 * 2)) / (double)(0x10000 - ch->timer);
+	ch->inc = (((double)33512000) / (spu_samplerate * 2)) / (double)(0x10000 - ch->timer);
 }
 
 static int check_valid(u32 addr, u32 size)
@@ -42,6 +42,9 @@ extern SoundInterface_struct SNDDummy;
 
 int SPU_ChangeSoundCore(int coreid, int buffersize);
 int SPU_Init(int coreid, int buffersize);
+void SPU_SetSampleRate(u32 rate);
+u32 SPU_GetStateSize(void);
+void *SPU_GetState(void);
 void SPU_Pause(int pause);
 void SPU_SetVolume(int volume);
 void SPU_Reset(void);
@@ -23,8 +23,10 @@
 #include "thumb_instructions.h"
 #include "cp15.h"
 #include "bios.h"
+#include "mem.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 const unsigned char arm_cond_table[16*16] = {
     /* N=0, Z=0, C=0, V=0 */
@@ -317,6 +319,84 @@ u32 armcpu_switchMode(armcpu_t *armcpu, u8 mode)
 	return oldmode;
 }
 
+armcpu_decode_page_t armcpu_decode_pages[ARMCPU_DECODE_PAGES];
+
+void armcpu_invalidate_code(const u8 *mem, u32 size)
+{
+	uintptr_t adr = ((uintptr_t)mem - 2) & ~(uintptr_t)1;
+	uintptr_t end = (uintptr_t)mem + size;
+
+	for (; adr < end; adr += 2)
+	{
+		armcpu_decode_page_t *page = &armcpu_decode_pages[(adr >> ARMCPU_DECODE_PAGE_SHIFT) & (ARMCPU_DECODE_PAGES - 1)];
+
+		if (page->tag == adr >> ARMCPU_DECODE_PAGE_SHIFT)
+			page->entries[(adr >> 1) & (ARMCPU_DECODE_PAGE_ENTRIES - 1)].handler = nullptr;
+	}
+}
+
+/* must be called whenever emulated memory is changed behind the MMU */
+void armcpu_flush_decode_cache(void)
+{
+	int i;
+
+	for (i = 0; i < ARMCPU_DECODE_PAGES; i++)
+		armcpu_decode_pages[i].tag = 0;
+}
+
+#ifndef GDB_STUB
+/* host address of an instruction, or nullptr if it has to be fetched
+ * through the MMU (i/o, cartridge space, DTCM) */
+static INLINE u8 *armcpu_code_ptr(armcpu_t *armcpu, u32 adr)
+{
+#ifdef MMU_ENABLE_ACL
+	return nullptr;
+#else
+	u32 region = (adr >> 20) & 0xFF;
+
+	/* TCM/BIOS, WRAM, main memory, shared WRAM, VRAM and high BIOS */
+	if (!((0x804F >> (region >> 4)) & 1))
+		return nullptr;
+	if (armcpu->proc_ID == ARMCPU_ARM9 && (adr & ~0x3FFF) == MMU.DTCMRegion)
+		return nullptr;
+
+	return MMU.MMU_MEM[armcpu->proc_ID][region] + (adr & MMU.MMU_MASK[armcpu->proc_ID][region]);
+#endif
+}
+
+static INLINE const armcpu_decoded_t *armcpu_decode(u8 *mem, u32 thumb)
+{
+	uintptr_t adr = (uintptr_t)mem;
+	armcpu_decode_page_t *page = &armcpu_decode_pages[(adr >> ARMCPU_DECODE_PAGE_SHIFT) & (ARMCPU_DECODE_PAGES - 1)];
+	armcpu_decoded_t *d;
+
+	if (page->tag != adr >> ARMCPU_DECODE_PAGE_SHIFT)
+	{
+		memset(page->entries, 0, sizeof(page->entries));
+		page->tag = adr >> ARMCPU_DECODE_PAGE_SHIFT;
+	}
+
+	d = &page->entries[(adr >> 1) & (ARMCPU_DECODE_PAGE_ENTRIES - 1)];
+
+	if (!d->handler || d->thumb != thumb)
+	{
+		if (thumb)
+		{
+			d->instruction = T1ReadWord(mem, 0);
+			d->handler = thumb_instructions_set[d->instruction>>6];
+		}
+		else
+		{
+			d->instruction = T1ReadLong(mem, 0);
+			d->handler = arm_instructions_set[INSTRUCTION_INDEX(d->instruction)];
+		}
+		d->thumb = thumb;
+	}
+
+	return d;
+}
+#endif
+
 u32 armcpu_prefetch(armcpu_t *armcpu)
 {
 #ifdef GDB_STUB
@@ -337,7 +417,19 @@ u32 armcpu_prefetch(armcpu_t *armcpu)
 			armcpu->R[15] = armcpu->next_instruction + 4;
 		}
 #else
-		armcpu->instruction = MMU_read32_acl(armcpu->proc_ID, armcpu->next_instruction,CP15_ACCESS_EXECUTE);
+		u8 *mem = armcpu_code_ptr(armcpu, armcpu->next_instruction);
+
+		if (mem)
+		{
+			const armcpu_decoded_t *d = armcpu_decode(mem, 0);
+			armcpu->instruction = d->instruction;
+			armcpu->handler = d->handler;
+		}
+		else
+		{
+			armcpu->instruction = MMU_read32_acl(armcpu->proc_ID, armcpu->next_instruction,CP15_ACCESS_EXECUTE);
+			armcpu->handler = arm_instructions_set[INSTRUCTION_INDEX(armcpu->instruction)];
+		}
 
 		armcpu->instruct_adr = armcpu->next_instruction;
 		armcpu->next_instruction += 4;
@@ -359,7 +451,21 @@ u32 armcpu_prefetch(armcpu_t *armcpu)
 		armcpu->R[15] = armcpu->next_instruction + 2;
 	}
 #else
-	armcpu->instruction = MMU_read16_acl(armcpu->proc_ID, armcpu->next_instruction,CP15_ACCESS_EXECUTE);
+	{
+		u8 *mem = armcpu_code_ptr(armcpu, armcpu->next_instruction);
+
+		if (mem)
+		{
+			const armcpu_decoded_t *d = armcpu_decode(mem, 1);
+			armcpu->instruction = d->instruction;
+			armcpu->handler = d->handler;
+		}
+		else
+		{
+			armcpu->instruction = MMU_read16_acl(armcpu->proc_ID, armcpu->next_instruction,CP15_ACCESS_EXECUTE);
+			armcpu->handler = thumb_instructions_set[armcpu->instruction>>6];
+		}
+	}
 
 	armcpu->instruct_adr = armcpu->next_instruction;
 	armcpu->next_instruction += 2;
@@ -458,7 +564,11 @@ u32 armcpu_exec(armcpu_t *armcpu)
 /*        if((TEST_COND(CONDITION(armcpu->instruction), armcpu->CPSR)) || ((CONDITION(armcpu->instruction)==0xF)&&(CODE(armcpu->instruction)==0x5)))*/
         if((TEST_COND(CONDITION(armcpu->instruction), CODE(armcpu->instruction), armcpu->CPSR)))
 		{
+#ifdef GDB_STUB
 			c += arm_instructions_set[INSTRUCTION_INDEX(armcpu->instruction)](armcpu);
+#else
+			c += armcpu->handler(armcpu);
+#endif
 		}
 #ifdef GDB_STUB
         if ( armcpu->post_ex_fn != nullptr) {
@@ -472,7 +582,11 @@ u32 armcpu_exec(armcpu_t *armcpu)
 		return c;
 	}
 
+#ifdef GDB_STUB
 	c += thumb_instructions_set[armcpu->instruction>>6](armcpu);
+#else
+	c += armcpu->handler(armcpu);
+#endif
 
 #ifdef GDB_STUB
     if ( armcpu->post_ex_fn != nullptr) {
@@ -22,6 +22,8 @@
 #ifndef ARM_CPU
 #define ARM_CPU
 
+#include <stdint.h>
+
 #include "types.h"
 #include "bits.h"
 #include "MMU.h"
@@ -168,6 +170,9 @@ struct armcpu_ctrl_iface {
 
 typedef void* armcp_t;
 
+struct armcpu_t;
+typedef u32 (FASTCALL* armcpu_opcode_fn)(struct armcpu_t * cpu);
+
 typedef struct armcpu_t
 {
         u32 proc_ID;
@@ -197,6 +202,9 @@ typedef struct armcpu_t
 
         u32 (* *swi_tab)(struct armcpu_t * cpu);
 
+	/* handler for the prefetched instruction */
+	armcpu_opcode_fn handler;
+
 #ifdef GDB_STUB
   /** there is a pending irq for the cpu */
   int irq_flag;
@@ -237,6 +245,45 @@ armcpu_flagIrq( armcpu_t *armcpu);
 extern armcpu_t NDS_ARM7;
 extern armcpu_t NDS_ARM9;
 
+/*
+ * Decoded instruction cache.  Fetched opcodes and their handlers are kept
+ * per page of host memory, so mirrors and the main memory shared by both
+ * cpus stay coherent.  Every MMU store calls armcpu_code_written(), which
+ * drops the entries it overlaps when the page is cached.
+ */
+#define ARMCPU_DECODE_PAGE_SHIFT 10
+#define ARMCPU_DECODE_PAGE_ENTRIES (1 << (ARMCPU_DECODE_PAGE_SHIFT - 1))
+#define ARMCPU_DECODE_PAGES 128
+
+typedef struct
+{
+	u32 instruction;
+	u32 thumb;
+	armcpu_opcode_fn handler; /* nullptr if not decoded */
+} armcpu_decoded_t;
+
+typedef struct
+{
+	uintptr_t tag; /* host address >> ARMCPU_DECODE_PAGE_SHIFT, 0 if unused */
+	armcpu_decoded_t entries[ARMCPU_DECODE_PAGE_ENTRIES];
+} armcpu_decode_page_t;
+
+extern armcpu_decode_page_t armcpu_decode_pages[ARMCPU_DECODE_PAGES];
+
+void armcpu_invalidate_code(const u8 *mem, u32 size);
+void armcpu_flush_decode_cache(void);
+
+static INLINE void armcpu_code_written(const u8 *mem, u32 size)
+{
+	/* an ARM opcode starting in the halfword before mem overlaps it too */
+	uintptr_t first = ((uintptr_t)mem - 2) >> ARMCPU_DECODE_PAGE_SHIFT;
+	uintptr_t last = ((uintptr_t)mem + size - 1) >> ARMCPU_DECODE_PAGE_SHIFT;
+
+	if (armcpu_decode_pages[first & (ARMCPU_DECODE_PAGES - 1)].tag == first ||
+	    armcpu_decode_pages[last & (ARMCPU_DECODE_PAGES - 1)].tag == last)
+		armcpu_invalidate_code(mem, size);
+}
+
 static INLINE void NDS_makeARM9Int(u32 num)
 {
         /* flag the interrupt request source */
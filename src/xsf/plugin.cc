@@ -73,6 +73,8 @@ static String dirpath;
 const char* const XSFPlugin::defaults[] =
 {
 	"ignore_length", "FALSE",
+	"sample_rate", "44100",
+	"snapshot_interval", "10",
 	nullptr
 };
 
@@ -126,12 +128,48 @@ static int xsf_get_length(const Index<char> &buf)
 	return length;
 }
 
+/* Emulator state snapshots taken every few seconds of playback, so that a
+ * seek only has to emulate forward from the nearest earlier one instead of
+ * restarting the song. */
+struct Snapshot {
+	int64_t pos;       /* in samples */
+	Index<char> data;  /* compressed state from xsf_save_state() */
+};
+
+/* returns the latest snapshot at or before <pos>, or -1 */
+static int find_snapshot(const Index<Snapshot> &snapshots, int64_t pos)
+{
+	int found = -1;
+
+	for (int i = 0; i < snapshots.len() && snapshots[i].pos <= pos; i++)
+		found = i;
+
+	return found;
+}
+
+static void take_snapshot(Index<Snapshot> &snapshots, int64_t pos, int64_t interval)
+{
+	if (!interval || (snapshots.len() && pos < snapshots[snapshots.len() - 1].pos + interval))
+		return;
+
+	Index<char> data;
+	if (!xsf_save_state(data))
+		return;
+
+	Snapshot &snap = snapshots.append();
+	snap.pos = pos;
+	snap.data = std::move(data);
+}
+
 bool XSFPlugin::play(const char *filename, VFSFile &file)
 {
 	int length = -1;
-	int16_t samples[44100*2];
-	int seglen = 44100 / 60;
-	float pos = 0.0;
+	int rate = aud::clamp(aud_get_int(CFG_ID, "sample_rate"), 8000, 192000);
+	int seglen = rate / 60;
+	int64_t pos = 0; /* in samples */
+	int64_t interval = (int64_t)aud::max(aud_get_int(CFG_ID, "snapshot_interval"), 0) * rate;
+	Index<int16_t> samples;
+	Index<Snapshot> snapshots;
 	bool error = false;
 
 	const char * slash = strrchr (filename, '/');
@@ -150,14 +188,16 @@ bool XSFPlugin::play(const char *filename, VFSFile &file)
 
 	length = xsf_get_length(buf);
 
-	if (xsf_start(buf.begin(), buf.len()) != AO_SUCCESS)
+	if (xsf_start(buf.begin(), buf.len(), rate) != AO_SUCCESS)
 	{
 		error = true;
 		goto ERR_NO_CLOSE;
 	}
 
-	set_stream_bitrate(44100*2*2*8);
-	open_audio(FMT_S16_NE, 44100, 2);
+	samples.resize(seglen * 2);
+
+	set_stream_bitrate(rate*2*2*8);
+	open_audio(FMT_S16_NE, rate, 2);
 
 	while (! check_stop ())
 	{
@@ -165,42 +205,43 @@ bool XSFPlugin::play(const char *filename, VFSFile &file)
 
 		if (seek_value >= 0)
 		{
-			if (seek_value > pos)
+			int64_t target = (int64_t)seek_value * rate / 1000;
+			int snap = find_snapshot(snapshots, target);
+
+			if (snap >= 0 && (target < pos || snapshots[snap].pos > pos) &&
+			 xsf_load_state(snapshots[snap].data))
 			{
-				while (pos < seek_value)
-				{
-					xsf_gen(samples, seglen);
-					pos += 16.666;
-				}
+				pos = snapshots[snap].pos;
 			}
-			else if (seek_value < pos)
+			else if (target < pos)
 			{
 				xsf_term();
+				snapshots.clear();
 
-				if (xsf_start(buf.begin(), buf.len()) == AO_SUCCESS)
-				{
-					pos = 0.0;
-					while (pos < seek_value)
-					{
-						xsf_gen(samples, seglen);
-						pos += 16.666; /* each segment is 16.666ms */
-					}
-				}
-			   	else
+				if (xsf_start(buf.begin(), buf.len(), rate) != AO_SUCCESS)
 				{
 					error = true;
 					goto CLEANUP;
 				}
+
+				pos = 0;
+			}
+
+			while (pos < target)
+			{
+				take_snapshot(snapshots, pos, interval);
+				xsf_gen(samples.begin(), seglen);
+				pos += seglen;
 			}
 		}
 
-		xsf_gen(samples, seglen);
-		pos += 16.666;
+		take_snapshot(snapshots, pos, interval);
+		xsf_gen(samples.begin(), seglen);
+		pos += seglen;
 
-		write_audio(samples, seglen * 4);
+		write_audio(samples.begin(), seglen * 4);
 
-		bool ignore_length = aud_get_bool(CFG_ID, "ignore_length");
-		if (pos >= length && !ignore_length)
+		if (length >= 0 && pos * 1000 / rate >= length)
 			goto CLEANUP;
 	}
 
@@ -230,6 +271,10 @@ const char *const XSFPlugin::exts[] = { "2sf", "mini2sf", nullptr };
 const PreferencesWidget XSFPlugin::widgets[] = {
 	WidgetLabel(N_("<b>XSF Configuration</b>")),
 	WidgetCheck(N_("Ignore length from file"), WidgetBool(CFG_ID, "ignore_length")),
+	WidgetSpin(N_("Sample rate:"), WidgetInt(CFG_ID, "sample_rate"),
+		{8000, 192000, 50, N_("Hz")}),
+	WidgetSpin(N_("Seek snapshot interval:"), WidgetInt(CFG_ID, "snapshot_interval"),
+		{0, 60, 1, N_("seconds (0 = disabled)")}),
 };
 
 const PluginPreferences XSFPlugin::prefs = {{widgets}};
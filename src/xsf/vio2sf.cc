@@ -390,20 +390,7 @@ void gdb_stub_fix(armcpu_t *armcpu)
 {
 	/* armcpu->R[15] = armcpu->instruct_adr; */
 	armcpu->next_instruction = armcpu->instruct_adr;
-	if(armcpu->CPSR.bits.T == 0)
-	{
-		armcpu->instruction = MMU_read32_acl(armcpu->proc_ID, armcpu->next_instruction,CP15_ACCESS_EXECUTE);
-		armcpu->instruct_adr = armcpu->next_instruction;
-		armcpu->next_instruction += 4;
-		armcpu->R[15] = armcpu->next_instruction + 4;
-	}
-	else
-	{
-		armcpu->instruction = MMU_read16_acl(armcpu->proc_ID, armcpu->next_instruction,CP15_ACCESS_EXECUTE);
-		armcpu->instruct_adr = armcpu->next_instruction;
-		armcpu->next_instruction += 2;
-		armcpu->R[15] = armcpu->next_instruction + 2;
-	}
+	armcpu_prefetch(armcpu);
 }
 
 static void load_setstate(void)
@@ -526,6 +513,7 @@ static void load_setstate(void)
 
 #ifdef GDB_STUB
 #else
+	armcpu_flush_decode_cache();
 	gdb_stub_fix(&NDS_ARM9);
 	gdb_stub_fix(&NDS_ARM7);
 #endif
@@ -539,11 +527,12 @@ static struct
 	unsigned used;
 	u32 bufferbytes;
 	u32 cycles;
+	u32 rate;
 	int xfs_load;
 	int sync_type;
 	int arm7_clockdown_level;
 	int arm9_clockdown_level;
-} sndifwork = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+} sndifwork = { 0, 0, 0, 0, 0, 0, 44100, 0, 0, 0, 0};
 
 static void SNDIFDeInit(void)
 {
@@ -615,7 +604,12 @@ static struct armcpu_ctrl_iface *arm9_ctrl_iface = 0;
 static struct armcpu_ctrl_iface *arm7_ctrl_iface = 0;
 #endif
 
-int xsf_start(void *pfile, unsigned bytes)
+#define HBASE_CYCLES 33509300.322234
+#define VBASE_CYCLES (((double)HBASE_CYCLES) / 100)
+#define HSAMPLES ((u32)((sndifwork.rate * 6.0 * (99 + 256)) / HBASE_CYCLES))
+#define VSAMPLES ((u32)((sndifwork.rate * 6.0 * (99 + 256) * 263) / HBASE_CYCLES))
+
+int xsf_start(void *pfile, unsigned bytes, unsigned rate)
 {
 	int frames = xsf_tagget_int("_frames", (unsigned char *) pfile, bytes, -1);
 	int clockdown = xsf_tagget_int("_clockdown", (unsigned char *) pfile, bytes, 0);
@@ -623,6 +617,7 @@ int xsf_start(void *pfile, unsigned bytes)
 	sndifwork.arm9_clockdown_level = xsf_tagget_int("_vio2sf_arm9_clockdown_level", (unsigned char *) pfile, bytes, clockdown);
 	sndifwork.arm7_clockdown_level = xsf_tagget_int("_vio2sf_arm7_clockdown_level", (unsigned char *) pfile, bytes, clockdown);
 
+	sndifwork.rate = rate;
 	sndifwork.xfs_load = 0;
 	printf("load_psf... ");
 	if (!load_psf(pfile, bytes))
@@ -636,7 +631,10 @@ int xsf_start(void *pfile, unsigned bytes)
 #endif
 		return false;
 
-	SPU_ChangeSoundCore(VIO2SFSNDIFID, 737);
+	/* room for one vsync frame worth of samples */
+	SPU_SetSampleRate(rate);
+	SPU_ChangeSoundCore(VIO2SFSNDIFID, VSAMPLES + 1);
+	MMU_SetSkipVideoDMA(true);
 
 	execute = false;
 
@@ -775,17 +773,11 @@ int xsf_gen(void *pbuffer, unsigned samples)
 		}
 		if (remainbytes == 0)
 		{
-
-#define HBASE_CYCLES 33509300.322234
-#define VBASE_CYCLES (((double)HBASE_CYCLES) / 100)
-#define HSAMPLES ((u32)((44100.0 * 6 * (99 + 256)) / HBASE_CYCLES))
-#define VSAMPLES ((u32)((44100.0 * 6 * (99 + 256) * 263) / HBASE_CYCLES))
-
 			int numsamples;
 			if (sndifwork.sync_type == 1)
 			{
 				/* vsync */
-				sndifwork.cycles += (441 * 6 * (99 + 256) * 263);
+				sndifwork.cycles += (u32)((u64)sndifwork.rate * 6 * (99 + 256) * 263 / 100);
 				if (sndifwork.cycles >= (u32)(VBASE_CYCLES * (VSAMPLES + 1)))
 				{
 					numsamples = (VSAMPLES + 1);
@@ -801,7 +793,7 @@ int xsf_gen(void *pbuffer, unsigned samples)
 			else
 			{
 				/* hsync */
-				sndifwork.cycles += (44100 * 6 * (99 + 256));
+				sndifwork.cycles += (sndifwork.rate * 6 * (99 + 256));
 				if (sndifwork.cycles >= (u32)(HBASE_CYCLES * (HSAMPLES + 1)))
 				{
 					numsamples = (HSAMPLES + 1);
@@ -820,6 +812,152 @@ int xsf_gen(void *pbuffer, unsigned samples)
 	return ptr - (unsigned char *)pbuffer;
 }
 
+/* Seek snapshots.  The emulator state is deflated region by region straight
+ * into the snapshot buffer; pointers are stored as-is, so a snapshot is only
+ * valid until xsf_term(). */
+
+#define STATE_CHUNK 65536
+
+typedef struct
+{
+	z_stream z;
+	Index<char> *out; /* null when loading */
+	bool ok;
+} state_io_t;
+
+static void state_io(state_io_t *io, void *data, unsigned len)
+{
+	if (!io->ok)
+		return;
+
+	if (io->out)
+	{
+		io->z.next_in = (Bytef *) data;
+		io->z.avail_in = len;
+
+		do
+		{
+			int pos = io->out->len();
+			io->out->insert(-1, STATE_CHUNK);
+			io->z.next_out = (Bytef *) io->out->begin() + pos;
+			io->z.avail_out = STATE_CHUNK;
+
+			if (deflate(&io->z, Z_NO_FLUSH) == Z_STREAM_ERROR)
+				io->ok = false;
+
+			io->out->remove(io->out->len() - io->z.avail_out, -1);
+		}
+		while (io->ok && io->z.avail_out == 0);
+	}
+	else
+	{
+		io->z.next_out = (Bytef *) data;
+		io->z.avail_out = len;
+
+		int ret = inflate(&io->z, Z_SYNC_FLUSH);
+		if ((ret != Z_OK && ret != Z_STREAM_END) || io->z.avail_out)
+			io->ok = false;
+	}
+}
+
+#define STATE_IO(io, var) state_io(io, &(var), sizeof(var))
+
+/* everything the sound driver can observe; GPU state is left out */
+static void state_regions(state_io_t *io)
+{
+	STATE_IO(io, NDS_ARM7);
+	STATE_IO(io, NDS_ARM9);
+	state_io(io, NDS_ARM9.coproc[15], sizeof(armcp15_t));
+	STATE_IO(io, nds);
+
+	STATE_IO(io, MMU);
+	STATE_IO(io, SPI_CNT);
+	STATE_IO(io, SPI_CMD);
+	STATE_IO(io, AUX_SPI_CNT);
+	STATE_IO(io, AUX_SPI_CMD);
+	STATE_IO(io, DMASrc);
+	STATE_IO(io, DMADst);
+	STATE_IO(io, partie);
+
+	/* same regions as a DeSmuME save state */
+	STATE_IO(io, ARM9Mem.ARM9_ITCM);
+	STATE_IO(io, ARM9Mem.ARM9_DTCM);
+	STATE_IO(io, ARM9Mem.ARM9_WRAM);
+	STATE_IO(io, ARM9Mem.MAIN_MEM);
+	state_io(io, ARM9Mem.ARM9_REG, 0x10000);
+	STATE_IO(io, ARM9Mem.ARM9_VMEM);
+	STATE_IO(io, ARM9Mem.ARM9_OAM);
+	STATE_IO(io, ARM9Mem.ARM9_ABG);
+	STATE_IO(io, ARM9Mem.ARM9_BBG);
+	STATE_IO(io, ARM9Mem.ARM9_AOBJ);
+	STATE_IO(io, ARM9Mem.ARM9_BOBJ);
+	STATE_IO(io, ARM9Mem.ARM9_LCD);
+	STATE_IO(io, ARM9Mem.ExtPal);
+	STATE_IO(io, ARM9Mem.ObjExtPal);
+	STATE_IO(io, ARM9Mem.texPalSlot);
+	STATE_IO(io, ARM9Mem.textureSlotAddr);
+
+	state_io(io, SPU_GetState(), SPU_GetStateSize());
+
+	STATE_IO(io, sndifwork.filled);
+	STATE_IO(io, sndifwork.used);
+	STATE_IO(io, sndifwork.cycles);
+	state_io(io, sndifwork.pcmbuftop, sndifwork.bufferbytes);
+}
+
+bool xsf_save_state(Index<char> &state)
+{
+	state_io_t io;
+	memset(&io.z, 0, sizeof io.z);
+	io.out = &state;
+	io.ok = (deflateInit(&io.z, Z_BEST_SPEED) == Z_OK);
+
+	if (!io.ok)
+		return false;
+
+	state_regions(&io);
+
+	if (io.ok)
+	{
+		int ret;
+
+		do
+		{
+			int pos = state.len();
+			state.insert(-1, STATE_CHUNK);
+			io.z.next_out = (Bytef *) state.begin() + pos;
+			io.z.avail_out = STATE_CHUNK;
+			ret = deflate(&io.z, Z_FINISH);
+			state.remove(state.len() - io.z.avail_out, -1);
+		}
+		while (ret == Z_OK);
+
+		io.ok = (ret == Z_STREAM_END);
+	}
+
+	deflateEnd(&io.z);
+	return io.ok;
+}
+
+bool xsf_load_state(const Index<char> &state)
+{
+	state_io_t io;
+	memset(&io.z, 0, sizeof io.z);
+	io.z.next_in = (Bytef *) state.begin();
+	io.z.avail_in = state.len();
+	io.out = nullptr;
+	io.ok = (inflateInit(&io.z) == Z_OK);
+
+	if (!io.ok)
+		return false;
+
+	state_regions(&io);
+	armcpu_flush_decode_cache();
+
+	inflateEnd(&io.z);
+	return io.ok;
+}
+
 void xsf_term(void)
 {
 	MMU_unsetRom();
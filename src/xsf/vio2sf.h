@@ -1,6 +1,8 @@
 #include <libaudcore/index.h>
 
-int xsf_start(void *pfile, unsigned bytes);
+int xsf_start(void *pfile, unsigned bytes, unsigned rate);
 int xsf_gen(void *pbuffer, unsigned samples);
 Index<char> xsf_get_lib(char *pfilename);
+bool xsf_save_state(Index<char> &state);
+bool xsf_load_state(const Index<char> &state);
 void xsf_term(void);
@@ -26,7 +26,7 @@
 #include <libxml/tree.h>
 #include <libxml/parser.h>
 #include <libxml/xmlreader.h>
-#include <libxml/xmlsave.h>
+#include <libxml/xmlwriter.h>
 #include <libxml/xpath.h>
 #include <libxml/xpathInternals.h>
 #include <libxml/uri.h>
@@ -187,18 +187,6 @@ static void xspf_add_file (xmlNode * track, const char * filename,
 }
 
 
-static void xspf_find_track (xmlNode * tracklist, const char * filename,
- const char * base, Index<PlaylistAddItem> & items)
-{
-    xmlNode *nptr;
-
-    for (nptr = tracklist->children; nptr != nullptr; nptr = nptr->next) {
-        if (nptr->type == XML_ELEMENT_NODE &&
-         ! xmlStrcmp (nptr->name, (xmlChar *) "track"))
-            xspf_add_file (nptr, filename, base, items);
-    }
-}
-
 static int read_cb (void * file, char * buf, int len)
 {
     return ((VFSFile *) file)->fread (buf, 1, len);
@@ -214,45 +202,80 @@ static int close_cb (void * file)
     return 0;
 }
 
+/* The playlist is read as a stream; only one <track> at a time is expanded
+ * into a tree, which the reader frees again as it moves on. */
 bool XSPFLoader::load (const char * filename, VFSFile & file, String & title,
  Index<PlaylistAddItem> & items)
 {
-    xmlDoc * doc = xmlReadIO (read_cb, close_cb, & file, filename, nullptr, XML_PARSE_RECOVER);
-    if (! doc)
+    xmlTextReader * reader = xmlReaderForIO (read_cb, close_cb, & file,
+     filename, nullptr, XML_PARSE_RECOVER);
+    if (! reader)
         return false;
 
-    xmlNode *nptr, *nptr2;
+    bool found = false, in_playlist = false, in_tracklist = false;
+    char * base = nullptr;
 
-    // find trackList
-    for (nptr = doc->children; nptr != nullptr; nptr = nptr->next) {
-        if (nptr->type == XML_ELEMENT_NODE &&
-            !xmlStrcmp(nptr->name, (xmlChar *)"playlist")) {
-            char * base;
+    int ret = xmlTextReaderRead (reader);
 
-            base = (char *)xmlNodeGetBase(doc, nptr);
+    while (ret == 1)
+    {
+        if (xmlTextReaderNodeType (reader) != XML_READER_TYPE_ELEMENT)
+        {
+            ret = xmlTextReaderRead (reader);
+            continue;
+        }
 
-            for (nptr2 = nptr->children; nptr2; nptr2 = nptr2->next)
+        const xmlChar * name = xmlTextReaderConstLocalName (reader);
+
+        switch (xmlTextReaderDepth (reader))
+        {
+        case 0:
+            in_playlist = ! xmlStrcmp (name, (xmlChar *) "playlist");
+
+            if (in_playlist && ! found)
             {
-                if (nptr2->type != XML_ELEMENT_NODE)
-                    continue;
+                base = (char *) xmlTextReaderBaseUri (reader);
+                found = true;
+            }
 
-                if (! xmlStrcmp (nptr2->name, (xmlChar *) "title"))
-                {
-                    xmlChar * xml_title = xmlNodeGetContent (nptr2);
-                    if (xml_title && xml_title[0])
-                        title = String ((char *) xml_title);
-                    xmlFree (xml_title);
-                }
-                else if (! xmlStrcmp (nptr2->name, (xmlChar *) "trackList"))
-                    xspf_find_track (nptr2, filename, base, items);
+            break;
+
+        case 1:
+            in_tracklist = in_playlist && ! xmlStrcmp (name, (xmlChar *) "trackList");
+
+            if (in_playlist && ! xmlStrcmp (name, (xmlChar *) "title"))
+            {
+                xmlChar * xml_title = xmlTextReaderReadString (reader);
+                if (xml_title && xml_title[0])
+                    title = String ((char *) xml_title);
+                xmlFree (xml_title);
             }
 
-            xmlFree (base);
+            break;
+
+        case 2:
+            if (in_tracklist && ! xmlStrcmp (name, (xmlChar *) "track"))
+            {
+                xmlNode * track = xmlTextReaderExpand (reader);
+                if (track)
+                    xspf_add_file (track, filename, base, items);
+
+                /* skip the rest of the track */
+                ret = xmlTextReaderNext (reader);
+                continue;
+            }
+
+            break;
         }
+
+        ret = xmlTextReaderRead (reader);
     }
 
-    xmlFreeDoc(doc);
-    return true;
+    xmlFree (base);
+    xmlFreeTextReader (reader);
+
+    /* like the old DOM parser, accept what could be recovered */
+    return ret == 0 || found;
 }
 
 
@@ -321,91 +344,94 @@ static bool is_valid_string (const char * s, CharPtr & subst)
 }
 
 
-static void xspf_add_node (xmlNodePtr node, bool isMeta, const char * xspfName, const char * strVal)
+static bool xspf_write_node (xmlTextWriter * writer, bool isMeta,
+ const char * xspfName, const char * strVal)
 {
-    xmlNodePtr tmp;
     CharPtr subst;
 
-    if (isMeta) {
-        tmp = xmlNewNode(nullptr, (xmlChar *) "meta");
-        xmlSetProp(tmp, (xmlChar *) "rel", (xmlChar *) xspfName);
-    } else
-        tmp = xmlNewNode(nullptr, (xmlChar *) xspfName);
+    if (! is_valid_string (strVal, subst))
+        strVal = subst.get ();
 
-    if (is_valid_string (strVal, subst))
-        xmlAddChild (tmp, xmlNewText ((xmlChar *) strVal));
-    else
-        xmlAddChild (tmp, xmlNewText ((xmlChar *) subst.get ()));
+    if (! isMeta)
+        return xmlTextWriterWriteElement (writer, (xmlChar *) xspfName,
+         (xmlChar *) strVal) >= 0;
 
-    xmlAddChild(node, tmp);
+    return xmlTextWriterStartElement (writer, (xmlChar *) "meta") >= 0 &&
+     xmlTextWriterWriteAttribute (writer, (xmlChar *) "rel", (xmlChar *) xspfName) >= 0 &&
+     xmlTextWriterWriteString (writer, (xmlChar *) strVal) >= 0 &&
+     xmlTextWriterEndElement (writer) >= 0;
 }
 
 
+/* The playlist is written out as it is generated, without building the
+ * whole document in memory first. */
 bool XSPFLoader::save (const char * filename, VFSFile & file,
  const char * title, const Index<PlaylistAddItem> & items)
 {
-    xmlDocPtr doc;
-    xmlNodePtr rootnode, tracklist;
+    xmlOutputBuffer * out = xmlOutputBufferCreateIO (write_cb, close_cb, & file, nullptr);
+    if (! out)
+        return false;
 
-    doc = xmlNewDoc((xmlChar *)"1.0");
-    doc->charset = XML_CHAR_ENCODING_UTF8;
-    doc->encoding = xmlStrdup((xmlChar *)"UTF-8");
+    /* the writer takes ownership of the output buffer */
+    xmlTextWriter * writer = xmlNewTextWriter (out);
+    if (! writer)
+    {
+        xmlOutputBufferClose (out);
+        return false;
+    }
 
-    rootnode = xmlNewNode(nullptr, (xmlChar *)XSPF_ROOT_NODE_NAME);
-    xmlSetProp(rootnode, (xmlChar *)"version", (xmlChar *)"1");
-    xmlSetProp(rootnode, (xmlChar *)"xmlns", (xmlChar *)XSPF_XMLNS);
+    xmlTextWriterSetIndent (writer, 1);
 
-    /* common */
-    xmlDocSetRootElement(doc, rootnode);
+    bool success = xmlTextWriterStartDocument (writer, "1.0", "UTF-8", nullptr) >= 0 &&
+     xmlTextWriterStartElement (writer, (xmlChar *) XSPF_ROOT_NODE_NAME) >= 0 &&
+     xmlTextWriterWriteAttribute (writer, (xmlChar *) "version", (xmlChar *) "1") >= 0 &&
+     xmlTextWriterWriteAttribute (writer, (xmlChar *) "xmlns", (xmlChar *) XSPF_XMLNS) >= 0;
 
-    if (title)
-        xspf_add_node (rootnode, false, "title", title);
+    if (success && title)
+        success = xspf_write_node (writer, false, "title", title);
 
-    tracklist = xmlNewNode(nullptr, (xmlChar *)"trackList");
-    xmlAddChild(rootnode, tracklist);
+    if (success)
+        success = xmlTextWriterStartElement (writer, (xmlChar *) "trackList") >= 0;
 
     for (auto & item : items)
     {
-        const char * filename = item.filename;
-        const Tuple & tuple = item.tuple;
-        xmlNodePtr track, location;
+        if (! success)
+            break;
 
-        track = xmlNewNode(nullptr, (xmlChar *)"track");
-        location = xmlNewNode(nullptr, (xmlChar *)"location");
+        const Tuple & tuple = item.tuple;
 
-        xmlAddChild(location, xmlNewText((xmlChar *)filename));
-        xmlAddChild(track, location);
-        xmlAddChild(tracklist, track);
+        success = xmlTextWriterStartElement (writer, (xmlChar *) "track") >= 0 &&
+         xmlTextWriterWriteElement (writer, (xmlChar *) "location",
+         (xmlChar *) (const char *) item.filename) >= 0;
 
         for (auto & entry : xspf_entries)
         {
+            if (! success)
+                break;
+
             switch (tuple.get_value_type (entry.tupleField))
             {
             case Tuple::String:
-                xspf_add_node (track, entry.isMeta, entry.xspfName,
+                success = xspf_write_node (writer, entry.isMeta, entry.xspfName,
                  tuple.get_str (entry.tupleField));
                 break;
             case Tuple::Int:
-                xspf_add_node (track, entry.isMeta, entry.xspfName,
+                success = xspf_write_node (writer, entry.isMeta, entry.xspfName,
                  int_to_str (tuple.get_int (entry.tupleField)));
                 break;
             default:
                 break;
             }
         }
-    }
-
-    xmlSaveCtxt * save = xmlSaveToIO (write_cb, close_cb, & file, nullptr, XML_SAVE_FORMAT);
-    if (! save)
-        goto ERR;
 
-    if (xmlSaveDoc (save, doc) < 0 || xmlSaveClose (save) < 0)
-        goto ERR;
+        if (success)
+            success = xmlTextWriterEndElement (writer) >= 0;
+    }
 
-    xmlFreeDoc(doc);
-    return true;
+    /* closes trackList and playlist */
+    if (success)
+        success = xmlTextWriterEndDocument (writer) >= 0;
 
-ERR:
-    xmlFreeDoc (doc);
-    return false;
+    xmlFreeTextWriter (writer);
+    return success;
 }